@@ -0,0 +1,89 @@
+/*
+ * BSD 2-Clause License
+ * 
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * A HistoPyramid (Dyken et al., "High-speed Marching Cubes using HistoPyramids", 2008) is a stack of reductions of the
+ * number of triangles every cell generates. Every element of a level stores the sum of HISTOPYRAMID_FAN_IN
+ * consecutive elements of the level below, the top level consists of a single element storing the number of all
+ * triangles. All levels above the cells are stored in one buffer (the level above the cells first).
+ * The triangles are then generated by one work item each, which finds its cell by walking down the pyramid (see
+ * traverseHistoPyramid in MarchingCubes.cl). This way, the cost of the triangle generation only depends on the size of
+ * the iso surface and not on the size of the grid.
+ */
+
+#define HISTOPYRAMID_FAN_IN 8u
+
+/**
+ * Builds the lowest level of the HistoPyramid from the cell counts computed by classifyCells.
+ * @param cellCounts Per cell: Whether the cell is active (x) and its number of triangle vertices (y).
+ * @param baseLevel The lowest level of the HistoPyramid (number of triangles).
+ * @param numCells The number of cells.
+ * @param baseLevelSize The number of elements in the lowest level.
+ */
+kernel void buildHistoPyramidBase(
+		global const uint2 *cellCounts,
+		global uint *baseLevel,
+		uint numCells, uint baseLevelSize)
+{
+    uint index = get_global_id(0);
+    if (index >= baseLevelSize) return; // Padding
+
+    uint numTriangles = 0u;
+    for (uint i = 0u; i < HISTOPYRAMID_FAN_IN; i++) {
+        uint cellIndex = index * HISTOPYRAMID_FAN_IN + i;
+        if (cellIndex < numCells) {
+            numTriangles += cellCounts[cellIndex].y / 3u;
+        }
+    }
+    baseLevel[index] = numTriangles;
+}
+
+/**
+ * Builds a level of the HistoPyramid by reducing the level below it.
+ * @param pyramid The levels of the HistoPyramid.
+ * @param lowerOffset The offset of the level below in the pyramid buffer.
+ * @param lowerSize The number of elements in the level below.
+ * @param upperOffset The offset of the level to build in the pyramid buffer.
+ * @param upperSize The number of elements in the level to build.
+ */
+kernel void buildHistoPyramidLevel(
+		global uint *pyramid,
+		uint lowerOffset, uint lowerSize, uint upperOffset, uint upperSize)
+{
+    uint index = get_global_id(0);
+    if (index >= upperSize) return; // Padding
+
+    uint numTriangles = 0u;
+    for (uint i = 0u; i < HISTOPYRAMID_FAN_IN; i++) {
+        uint lowerIndex = index * HISTOPYRAMID_FAN_IN + i;
+        if (lowerIndex < lowerSize) {
+            numTriangles += pyramid[lowerOffset + lowerIndex];
+        }
+    }
+    pyramid[upperOffset + index] = numTriangles;
+}
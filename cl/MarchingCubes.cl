@@ -26,6 +26,18 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/**
+ * Kernel specialization (see MarchingCubesImpl::prepareKernelSpecialization): Programs built with -D GRID_NX=<nx>
+ * -D GRID_NY=<ny> replace the grid size arguments of the kernels by compile-time constants, so the compiler can
+ * strength-reduce the index computations. The number of grid points in z direction stays a kernel argument, as it
+ * differs between the slabs and bricks of a grid.
+ */
+#if defined(GRID_NX) && defined(GRID_NY)
+#define SPECIALIZE_GRID_SIZE(nx, ny) nx = GRID_NX; ny = GRID_NY
+#else
+#define SPECIALIZE_GRID_SIZE(nx, ny)
+#endif
+
 /**
  * Marching cubes look-up tables from Paul Borke:
  * http://paulbourke.net/geometry/polygonise/
@@ -360,7 +372,23 @@ struct GridCell {
 };
 
 /**
- * Loads a grid cell from a Cartesian grid. A Cartesian grid with nx^3 points has (nx-1)^3 grid cells.
+ * The offsets of the eight corners of a grid cell from its first corner. The loop over the corners has no branches, so
+ * the compiler can unroll it and fold the offsets into the loads.
+ */
+constant int3 cellCornerOffsets[8] = {
+    (int3)(0, 0, 0), (int3)(1, 0, 0), (int3)(1, 0, 1), (int3)(0, 0, 1),
+    (int3)(0, 1, 0), (int3)(1, 1, 0), (int3)(1, 1, 1), (int3)(0, 1, 1)
+};
+
+/**
+ * The indices of the two grid cell corners every edge connects (in the order used by polygonizeGridCell).
+ */
+constant int edgeCorners[12][2] = {
+    {0, 1}, {1, 2}, {2, 3}, {3, 0}, {4, 5}, {5, 6}, {6, 7}, {7, 4}, {0, 4}, {1, 5}, {2, 6}, {3, 7}
+};
+
+/**
+ * Loads a grid cell from a Cartesian grid. A Cartesian grid with nx*ny*nz points has (nx-1)*(ny-1)*(nz-1) grid cells.
  * The grid cell at index (x,y,z) consists of the eight cells at (x,y,z), (x+1,y,z), ..., (x+1,y+1,z+1).
  * For the order of grid cell indices see: http://paulbourke.net/geometry/polygonise/
  * @param GridCell Where the grid cell data should be stored.
@@ -369,161 +397,977 @@ struct GridCell {
  * @param y The y coordinate of the cell to load.
  * @param z The z coordinate of the cell to load.
  */
-void loadGridCell(struct GridCell *gridCell, global const float4 *cartesianGridCorners, int nx, int x, int y, int z) {
+void loadGridCell(struct GridCell *gridCell, global const float4 *cartesianGridCorners, int nx, int ny,
+        int x, int y, int z) {
+    int offset = x + y*nx + z*nx*ny;
     for (int i = 0; i < 8; i++) {
-        int zprime = z;
-        int yprime = y;
-        int xprime = x;
-        if (i == 1 || i == 2 || i == 5 || i == 6) {
-        	xprime += 1;
-        }
-        if (i == 4 || i == 5 || i == 6 || i == 7) {
-        	yprime += 1;
-        }
-        if (i == 2 || i == 3 || i == 6 || i == 7) {
-        	zprime += 1;
+        int3 corner = cellCornerOffsets[i];
+        gridCell->vf[i] = cartesianGridCorners[offset + corner.x + corner.y*nx + corner.z*nx*ny];
+    }
+}
+
+/**
+ * Loads a grid cell from a Cartesian grid with implicit geometry, i.e., only the scalar values are stored and the
+ * positions of the grid points are reconstructed from the origin and the grid spacing.
+ * @param GridCell Where the grid cell data should be stored.
+ * @param scalarField The scalar values at the grid points.
+ * @param origin The position of the grid point (0,0,0).
+ * @param spacing The distance between two grid points in x, y and z direction.
+ * @param x The x coordinate of the cell to load.
+ * @param y The y coordinate of the cell to load.
+ * @param z The z coordinate of the cell to load.
+ * @param offsetZ The z coordinate of the first grid point layer of the scalar field in the whole grid (for bricks).
+ */
+void loadGridCellImplicit(struct GridCell *gridCell, global const float *scalarField, float3 origin, float3 spacing,
+        int nx, int ny, int x, int y, int z, int offsetZ) {
+    int offset = x + y*nx + z*nx*ny;
+    for (int i = 0; i < 8; i++) {
+        int3 corner = cellCornerOffsets[i];
+        float3 position = origin + convert_float3((int3)(x, y, z + offsetZ) + corner) * spacing;
+        gridCell->vf[i] = (float4)(position, scalarField[offset + corner.x + corner.y*nx + corner.z*nx*ny]);
+    }
+}
+
+/**
+ * The second pass reads the marching cubes case of a cell stored by the first pass (see classifyCells) instead of
+ * computing it again. Then only the corners at the ends of the edges crossing the iso surface are needed, which are
+ * often only four of the eight corners (and at most six for a single triangle).
+ */
+
+/**
+ * Returns a bit mask of the corners of a grid cell at the ends of the edges crossing the iso surface.
+ * @param cubeIndex The marching cubes case of the cell.
+ */
+int getCrossingEdgeCorners(int cubeIndex) {
+    int cornerMask = 0;
+    for (int i = 0; i < 12; i++) {
+        if ((edgeTable[cubeIndex] & (1 << i)) != 0) {
+            cornerMask |= (1 << edgeCorners[i][0]) | (1 << edgeCorners[i][1]);
         }
-        int offset = xprime + yprime*nx + zprime*nx*nx;
-        gridCell->vf[i] = cartesianGridCorners[offset];
     }
+    return cornerMask;
 }
 
 /**
- * In a first pass, this function computes the number of triangle vertices the marching cubes algorithm generates.
- * This is necessary for allocating enough memory.
- * @param cartesianGridCorners The Cartesian grid data storing at each entry the position of a grid corner in xyz and
- * a scalar value in w.
- * @param vertexCounter The global (atomic) counter for the number of generated vertices.
- * @param nx The number of grid points in x, y and z direction.
- * @param isoLevel The iso level of the iso surface to extract.
+ * Same as loadGridCell, but only loads the corners in cornerMask. The other corners are left undefined.
  */
-kernel void computeNumVertices(
-		global const float4 *cartesianGridCorners,
-		global uint *vertexCounter,
-		uint nx, float isoLevel)
-{
-    int x = get_global_id(0);
-    int y = get_global_id(1);
-    int z = get_global_id(2);
-    if (x >= nx-1 || y >= nx-1 || z >= nx-1) return; // Padding
+void loadGridCellCorners(struct GridCell *gridCell, global const float4 *cartesianGridCorners, int nx, int ny,
+        int x, int y, int z, int cornerMask) {
+    int offset = x + y*nx + z*nx*ny;
+    for (int i = 0; i < 8; i++) {
+        if ((cornerMask & (1 << i)) != 0) {
+            int3 corner = cellCornerOffsets[i];
+            gridCell->vf[i] = cartesianGridCorners[offset + corner.x + corner.y*nx + corner.z*nx*ny];
+        }
+    }
+}
 
-    struct GridCell gridCell;
-    loadGridCell(&gridCell, cartesianGridCorners, nx, x, y, z);
+/**
+ * Same as loadGridCellImplicit, but only loads the corners in cornerMask. The other corners are left undefined.
+ */
+void loadGridCellCornersImplicit(struct GridCell *gridCell, global const float *scalarField, float3 origin,
+        float3 spacing, int nx, int ny, int x, int y, int z, int offsetZ, int cornerMask) {
+    int offset = x + y*nx + z*nx*ny;
+    for (int i = 0; i < 8; i++) {
+        if ((cornerMask & (1 << i)) != 0) {
+            int3 corner = cellCornerOffsets[i];
+            float3 position = origin + convert_float3((int3)(x, y, z + offsetZ) + corner) * spacing;
+            gridCell->vf[i] = (float4)(position, scalarField[offset + corner.x + corner.y*nx + corner.z*nx*ny]);
+        }
+    }
+}
 
+/**
+ * Computes the marching cubes case of a grid cell, i.e. a bit mask of the corners with values below the iso level.
+ */
+int computeCubeIndex(struct GridCell *gridCell, float isoLevel) {
     int cubeIndex = 0;
-    if (gridCell.vf[0].w < isoLevel) cubeIndex |= 1;
-    if (gridCell.vf[1].w < isoLevel) cubeIndex |= 2;
-    if (gridCell.vf[2].w < isoLevel) cubeIndex |= 4;
-    if (gridCell.vf[3].w < isoLevel) cubeIndex |= 8;
-    if (gridCell.vf[4].w < isoLevel) cubeIndex |= 16;
-    if (gridCell.vf[5].w < isoLevel) cubeIndex |= 32;
-    if (gridCell.vf[6].w < isoLevel) cubeIndex |= 64;
-    if (gridCell.vf[7].w < isoLevel) cubeIndex |= 128;
-
-    // Cube is entirely inside or outside of the iso-surface
-    if (edgeTable[cubeIndex] == 0)
-        return;
-
-    // Compute the number of triangle vertex points
+    if (gridCell->vf[0].w < isoLevel) cubeIndex |= 1;
+    if (gridCell->vf[1].w < isoLevel) cubeIndex |= 2;
+    if (gridCell->vf[2].w < isoLevel) cubeIndex |= 4;
+    if (gridCell->vf[3].w < isoLevel) cubeIndex |= 8;
+    if (gridCell->vf[4].w < isoLevel) cubeIndex |= 16;
+    if (gridCell->vf[5].w < isoLevel) cubeIndex |= 32;
+    if (gridCell->vf[6].w < isoLevel) cubeIndex |= 64;
+    if (gridCell->vf[7].w < isoLevel) cubeIndex |= 128;
+    return cubeIndex;
+}
+
+/**
+ * Returns the number of triangle vertices the marching cubes algorithm generates for a grid cell.
+ */
+uint getNumTriangleVertices(int cubeIndex) {
     uint numTrianglePoints = 0u;
     for (int i = 0; triTable[cubeIndex][i] != -1; i++) {
         numTrianglePoints++;
     }
-
-    // Add the number of triangle points to the global atomic counter.
-    volatile __global uint *atomicVertexCounter = vertexCounter;
-	atomic_add(atomicVertexCounter, numTrianglePoints);
+    return numTrianglePoints;
 }
 
 /**
  * Polygonizes a grid cell using Marching Cubes.
  * Code ported to OpenCL C by using C code from: http://paulbourke.net/geometry/polygonise/
- * @param cartesianGridCorners The Cartesian grid data storing at each entry the position of a grid corner in xyz and
- * a scalar value in w.
+ * @param gridCell The grid cell to polygonize (only the corners of getCrossingEdgeCorners are needed).
+ * @param cubeIndex The marching cubes case of the cell (see computeCubeIndex).
  * @param triangleVertices The list of generated triangle vertices of the iso surface.
- * @param vertexCounter The global (atomic) counter for the number of generated vertices.
- * @param nx The number of grid points in x, y and z direction.
+ * @param vertexBufferOffset The index of the first triangle vertex of the cell in triangleVertices.
  * @param isoLevel The iso level of the iso surface to extract.
-*/
-kernel void marchingCubes(
-		global const float4 *cartesianGridCorners,
-		global float4 *triangleVertices,
-		global uint *vertexCounter,
-		uint nx, float isoLevel)
-{
-	int x = get_global_id(0);
-	int y = get_global_id(1);
-	int z = get_global_id(2);
-	if (x >= nx-1 || y >= nx-1 || z >= nx-1) return; // Padding
-
-    struct GridCell gridCell;
-    loadGridCell(&gridCell, cartesianGridCorners, nx, x, y, z);
-
-    int cubeIndex = 0;
-	if (gridCell.vf[0].w < isoLevel) cubeIndex |= 1;
-	if (gridCell.vf[1].w < isoLevel) cubeIndex |= 2;
-	if (gridCell.vf[2].w < isoLevel) cubeIndex |= 4;
-	if (gridCell.vf[3].w < isoLevel) cubeIndex |= 8;
-	if (gridCell.vf[4].w < isoLevel) cubeIndex |= 16;
-	if (gridCell.vf[5].w < isoLevel) cubeIndex |= 32;
-	if (gridCell.vf[6].w < isoLevel) cubeIndex |= 64;
-	if (gridCell.vf[7].w < isoLevel) cubeIndex |= 128;
-
+ */
+void polygonizeGridCell(struct GridCell *gridCell, int cubeIndex, global float4 *triangleVertices,
+        uint vertexBufferOffset, float isoLevel) {
 	// Cube is entirely inside or outside of the iso-surface.
 	if (edgeTable[cubeIndex] == 0)
 		return;
 
-	// Find the vertices where the surface intersects the cube.
+    // Find the vertices where the surface intersects the cube.
 	float4 vertexList[12];
     if (edgeTable[cubeIndex] & 1) {
-        vertexList[0] = vertexInterpIso(isoLevel, gridCell.vf[0].xyz, gridCell.vf[1].xyz, gridCell.vf[0].w, gridCell.vf[1].w);
+        vertexList[0] = vertexInterpIso(isoLevel, gridCell->vf[0].xyz, gridCell->vf[1].xyz, gridCell->vf[0].w, gridCell->vf[1].w);
     }
     if (edgeTable[cubeIndex] & 2) {
-        vertexList[1] = vertexInterpIso(isoLevel, gridCell.vf[1].xyz, gridCell.vf[2].xyz, gridCell.vf[1].w, gridCell.vf[2].w);
+        vertexList[1] = vertexInterpIso(isoLevel, gridCell->vf[1].xyz, gridCell->vf[2].xyz, gridCell->vf[1].w, gridCell->vf[2].w);
     }
     if (edgeTable[cubeIndex] & 4) {
-        vertexList[2] = vertexInterpIso(isoLevel, gridCell.vf[2].xyz, gridCell.vf[3].xyz, gridCell.vf[2].w, gridCell.vf[3].w);
+        vertexList[2] = vertexInterpIso(isoLevel, gridCell->vf[2].xyz, gridCell->vf[3].xyz, gridCell->vf[2].w, gridCell->vf[3].w);
     }
     if (edgeTable[cubeIndex] & 8) {
-        vertexList[3] = vertexInterpIso(isoLevel, gridCell.vf[3].xyz, gridCell.vf[0].xyz, gridCell.vf[3].w, gridCell.vf[0].w);
+        vertexList[3] = vertexInterpIso(isoLevel, gridCell->vf[3].xyz, gridCell->vf[0].xyz, gridCell->vf[3].w, gridCell->vf[0].w);
     }
     if (edgeTable[cubeIndex] & 16) {
-        vertexList[4] = vertexInterpIso(isoLevel, gridCell.vf[4].xyz, gridCell.vf[5].xyz, gridCell.vf[4].w, gridCell.vf[5].w);
+        vertexList[4] = vertexInterpIso(isoLevel, gridCell->vf[4].xyz, gridCell->vf[5].xyz, gridCell->vf[4].w, gridCell->vf[5].w);
     }
     if (edgeTable[cubeIndex] & 32) {
-        vertexList[5] = vertexInterpIso(isoLevel, gridCell.vf[5].xyz, gridCell.vf[6].xyz, gridCell.vf[5].w, gridCell.vf[6].w);
+        vertexList[5] = vertexInterpIso(isoLevel, gridCell->vf[5].xyz, gridCell->vf[6].xyz, gridCell->vf[5].w, gridCell->vf[6].w);
     }
     if (edgeTable[cubeIndex] & 64) {
-        vertexList[6] = vertexInterpIso(isoLevel, gridCell.vf[6].xyz, gridCell.vf[7].xyz, gridCell.vf[6].w, gridCell.vf[7].w);
+        vertexList[6] = vertexInterpIso(isoLevel, gridCell->vf[6].xyz, gridCell->vf[7].xyz, gridCell->vf[6].w, gridCell->vf[7].w);
     }
     if (edgeTable[cubeIndex] & 128) {
-        vertexList[7] = vertexInterpIso(isoLevel, gridCell.vf[7].xyz, gridCell.vf[4].xyz, gridCell.vf[7].w, gridCell.vf[4].w);
+        vertexList[7] = vertexInterpIso(isoLevel, gridCell->vf[7].xyz, gridCell->vf[4].xyz, gridCell->vf[7].w, gridCell->vf[4].w);
     }
     if (edgeTable[cubeIndex] & 256) {
-        vertexList[8] = vertexInterpIso(isoLevel, gridCell.vf[0].xyz, gridCell.vf[4].xyz, gridCell.vf[0].w, gridCell.vf[4].w);
+        vertexList[8] = vertexInterpIso(isoLevel, gridCell->vf[0].xyz, gridCell->vf[4].xyz, gridCell->vf[0].w, gridCell->vf[4].w);
     }
     if (edgeTable[cubeIndex] & 512) {
-        vertexList[9] = vertexInterpIso(isoLevel, gridCell.vf[1].xyz, gridCell.vf[5].xyz, gridCell.vf[1].w, gridCell.vf[5].w);
+        vertexList[9] = vertexInterpIso(isoLevel, gridCell->vf[1].xyz, gridCell->vf[5].xyz, gridCell->vf[1].w, gridCell->vf[5].w);
     }
     if (edgeTable[cubeIndex] & 1024) {
-        vertexList[10] = vertexInterpIso(isoLevel, gridCell.vf[2].xyz, gridCell.vf[6].xyz, gridCell.vf[2].w, gridCell.vf[6].w);
+        vertexList[10] = vertexInterpIso(isoLevel, gridCell->vf[2].xyz, gridCell->vf[6].xyz, gridCell->vf[2].w, gridCell->vf[6].w);
     }
     if (edgeTable[cubeIndex] & 2048) {
-        vertexList[11] = vertexInterpIso(isoLevel, gridCell.vf[3].xyz, gridCell.vf[7].xyz, gridCell.vf[3].w, gridCell.vf[7].w);
+        vertexList[11] = vertexInterpIso(isoLevel, gridCell->vf[3].xyz, gridCell->vf[7].xyz, gridCell->vf[3].w, gridCell->vf[7].w);
     }
 
-    // Compute the number of triangle vertex points.
-    uint numTrianglePoints = 0u;
+    // Write to the triangle vertex at the index positions reserved by the prefix sum.
     for (int i = 0; triTable[cubeIndex][i] != -1; i++) {
-        numTrianglePoints++;
+        triangleVertices[vertexBufferOffset + i] = vertexList[triTable[cubeIndex][i]];
+    }
+}
+
+/**
+ * Returns the coordinates of a grid cell given its linear index (x varying fastest).
+ */
+int3 getCellCoordinates(uint cellIndex, uint nx, uint ny) {
+    uint numCellsX = nx - 1;
+    uint numCellsY = ny - 1;
+    return (int3)((int)(cellIndex % numCellsX), (int)((cellIndex / numCellsX) % numCellsY),
+            (int)(cellIndex / (numCellsX * numCellsY)));
+}
+
+/**
+ * Marching cubes with stream compaction works in three passes:
+ * 1. classifyCells writes the number of active cells (0 or 1), the number of triangle vertices and the marching cubes
+ *    case for every cell.
+ * 2. An exclusive prefix sum over these pairs (see Scan.cl) yields the index of every active cell in the list of
+ *    active cells and the offset of its triangle vertices in the vertex buffer. compactActiveCells writes the list.
+ * 3. generateTriangles polygonizes only the active cells.
+ * As the vertex offsets are computed by the prefix sum, no atomic operations are needed and the order of the output
+ * is deterministic.
+ */
+
+/**
+ * In a first pass, this function computes the number of triangle vertices the marching cubes algorithm generates for
+ * every cell.
+ * @param cartesianGridCorners The Cartesian grid data storing at each entry the position of a grid corner in xyz and
+ * a scalar value in w.
+ * @param cellCounts Per cell: Whether the cell is active (x) and its number of triangle vertices (y).
+ * @param cubeIndices Per cell: The marching cubes case, so the second pass doesn't need to compute it again.
+ * @param nx, ny, nz The number of grid points in x, y and z direction.
+ * @param isoLevel The iso level of the iso surface to extract.
+ */
+kernel void classifyCells(
+		global const float4 *cartesianGridCorners,
+		global uint2 *cellCounts,
+		global uchar *cubeIndices,
+		uint nx, uint ny, uint nz, float isoLevel)
+{
+    SPECIALIZE_GRID_SIZE(nx, ny);
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    int z = get_global_id(2);
+    if (x >= nx-1 || y >= ny-1 || z >= nz-1) return; // Padding
+
+    struct GridCell gridCell;
+    loadGridCell(&gridCell, cartesianGridCorners, nx, ny, x, y, z);
+    int cubeIndex = computeCubeIndex(&gridCell, isoLevel);
+    uint numTriangleVertices = getNumTriangleVertices(cubeIndex);
+    uint cellIndex = x + y*(nx-1) + z*(nx-1)*(ny-1);
+    cellCounts[cellIndex] = (uint2)(numTriangleVertices > 0u ? 1u : 0u, numTriangleVertices);
+    cubeIndices[cellIndex] = (uchar)cubeIndex;
+}
+
+/**
+ * Same as classifyCells, but for a Cartesian grid with implicit geometry (see loadGridCellImplicit).
+ * @param scalarField The scalar values at the grid points.
+ * @param cellCounts Per cell: Whether the cell is active (x) and its number of triangle vertices (y).
+ * @param cubeIndices Per cell: The marching cubes case.
+ * @param nx, ny, nz The number of grid points in x, y and z direction.
+ * @param isoLevel The iso level of the iso surface to extract.
+ */
+kernel void classifyCellsImplicit(
+		global const float *scalarField,
+		global uint2 *cellCounts,
+		global uchar *cubeIndices,
+		uint nx, uint ny, uint nz, float isoLevel)
+{
+    SPECIALIZE_GRID_SIZE(nx, ny);
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    int z = get_global_id(2);
+    if (x >= nx-1 || y >= ny-1 || z >= nz-1) return; // Padding
+
+    // The positions aren't needed for the classification.
+    struct GridCell gridCell;
+    loadGridCellImplicit(&gridCell, scalarField, (float3)(0.0f), (float3)(0.0f), nx, ny, x, y, z, 0);
+    int cubeIndex = computeCubeIndex(&gridCell, isoLevel);
+    uint numTriangleVertices = getNumTriangleVertices(cubeIndex);
+    uint cellIndex = x + y*(nx-1) + z*(nx-1)*(ny-1);
+    cellCounts[cellIndex] = (uint2)(numTriangleVertices > 0u ? 1u : 0u, numTriangleVertices);
+    cubeIndices[cellIndex] = (uchar)cubeIndex;
+}
+
+/**
+ * Local-memory tiling: Neighboring work items of the 3D kernels read mostly the same grid points, as every cell reads
+ * its eight corners. The tiled kernels first load the scalar values of the (lx+1)*(ly+1)*(lz+1) grid points used by a
+ * work group of size (lx,ly,lz) cooperatively into local memory and then classify from local memory, which reduces the
+ * global memory reads per work item from up to eleven to about one. This pays off on GPUs. CPU runtimes (e.g. POCL)
+ * emulate local memory in global memory and make the barrier expensive, so the host selects the tiled kernels by
+ * device type (see ComputeDevice::useGridTiling).
+ */
+
+/**
+ * Returns the index of the grid point with the passed local coordinates in the tile of the work group.
+ */
+int getTileIndex(int x, int y, int z) {
+    return x + (y + z*((int)get_local_size(1) + 1)) * ((int)get_local_size(0) + 1);
+}
+
+/**
+ * Returns the index of the grid point with the tile index i in the grid. Grid points outside of the grid are clamped to
+ * the border, as they're only used by padding work items.
+ */
+int getTileGridPointIndex(int i, int nx, int ny, int nz) {
+    int tileSizeX = get_local_size(0) + 1, tileSizeY = get_local_size(1) + 1;
+    int3 tileOrigin = (int3)((int)(get_group_id(0) * get_local_size(0)), (int)(get_group_id(1) * get_local_size(1)),
+            (int)(get_group_id(2) * get_local_size(2)));
+    int3 point = tileOrigin + (int3)(i % tileSizeX, (i / tileSizeX) % tileSizeY, i / (tileSizeX*tileSizeY));
+    point = min(point, (int3)(nx-1, ny-1, nz-1));
+    return point.x + point.y*nx + point.z*nx*ny;
+}
+
+/**
+ * Returns the number of grid points in the tile of the work group.
+ */
+int getTileSize() {
+    return ((int)get_local_size(0) + 1) * ((int)get_local_size(1) + 1) * ((int)get_local_size(2) + 1);
+}
+
+/**
+ * Returns the linear index of the work item in the work group and writes the size of the work group to localSize.
+ */
+int getLocalLinearId(int *localSize) {
+    *localSize = get_local_size(0) * get_local_size(1) * get_local_size(2);
+    return get_local_id(0) + (get_local_id(1) + get_local_id(2) * get_local_size(1)) * get_local_size(0);
+}
+
+/**
+ * Cooperatively loads the scalar values of the tile of the work group from a Cartesian grid into local memory. Must be
+ * called by all work items of the work group (including padding work items) before any of them returns.
+ * @param tile Local memory for (lx+1)*(ly+1)*(lz+1) scalar values.
+ * @param cartesianGridCorners The Cartesian grid with scalar data.
+ * @param nx, ny, nz The number of grid points in x, y and z direction.
+ */
+void loadTile(local float *tile, global const float4 *cartesianGridCorners, int nx, int ny, int nz) {
+    int localSize;
+    int tileSize = getTileSize();
+    for (int i = getLocalLinearId(&localSize); i < tileSize; i += localSize) {
+        tile[i] = cartesianGridCorners[getTileGridPointIndex(i, nx, ny, nz)].w;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+/**
+ * Same as loadTile, but for a Cartesian grid with implicit geometry (see loadGridCellImplicit).
+ */
+void loadTileImplicit(local float *tile, global const float *scalarField, int nx, int ny, int nz) {
+    int localSize;
+    int tileSize = getTileSize();
+    for (int i = getLocalLinearId(&localSize); i < tileSize; i += localSize) {
+        tile[i] = scalarField[getTileGridPointIndex(i, nx, ny, nz)];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+/**
+ * Same as computeCubeIndex, but for the cell at the grid point of the work item in the tile of the work group.
+ */
+int computeCubeIndexTiled(local const float *tile, float isoLevel) {
+    int3 localId = (int3)((int)get_local_id(0), (int)get_local_id(1), (int)get_local_id(2));
+    int cubeIndex = 0;
+    for (int i = 0; i < 8; i++) {
+        int3 corner = localId + cellCornerOffsets[i];
+        if (tile[getTileIndex(corner.x, corner.y, corner.z)] < isoLevel) {
+            cubeIndex |= 1 << i;
+        }
+    }
+    return cubeIndex;
+}
+
+/**
+ * Same as classifyCells, but loads the grid points of the work group into local memory first.
+ * @param tile Local memory for (lx+1)*(ly+1)*(lz+1) scalar values.
+ */
+kernel void classifyCellsTiled(
+		global const float4 *cartesianGridCorners,
+		global uint2 *cellCounts,
+		global uchar *cubeIndices,
+		uint nx, uint ny, uint nz, float isoLevel,
+		local float *tile)
+{
+    SPECIALIZE_GRID_SIZE(nx, ny);
+    loadTile(tile, cartesianGridCorners, nx, ny, nz);
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    int z = get_global_id(2);
+    if (x >= nx-1 || y >= ny-1 || z >= nz-1) return; // Padding
+
+    int cubeIndex = computeCubeIndexTiled(tile, isoLevel);
+    uint numTriangleVertices = getNumTriangleVertices(cubeIndex);
+    uint cellIndex = x + y*(nx-1) + z*(nx-1)*(ny-1);
+    cellCounts[cellIndex] = (uint2)(numTriangleVertices > 0u ? 1u : 0u, numTriangleVertices);
+    cubeIndices[cellIndex] = (uchar)cubeIndex;
+}
+
+/**
+ * Same as classifyCellsImplicit, but loads the grid points of the work group into local memory first.
+ * @param tile Local memory for (lx+1)*(ly+1)*(lz+1) scalar values.
+ */
+kernel void classifyCellsImplicitTiled(
+		global const float *scalarField,
+		global uint2 *cellCounts,
+		global uchar *cubeIndices,
+		uint nx, uint ny, uint nz, float isoLevel,
+		local float *tile)
+{
+    SPECIALIZE_GRID_SIZE(nx, ny);
+    loadTileImplicit(tile, scalarField, nx, ny, nz);
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    int z = get_global_id(2);
+    if (x >= nx-1 || y >= ny-1 || z >= nz-1) return; // Padding
+
+    int cubeIndex = computeCubeIndexTiled(tile, isoLevel);
+    uint numTriangleVertices = getNumTriangleVertices(cubeIndex);
+    uint cellIndex = x + y*(nx-1) + z*(nx-1)*(ny-1);
+    cellCounts[cellIndex] = (uint2)(numTriangleVertices > 0u ? 1u : 0u, numTriangleVertices);
+    cubeIndices[cellIndex] = (uchar)cubeIndex;
+}
+
+/**
+ * Writes the indices of all active cells to a compact list.
+ * @param cellOffsets The exclusive prefix sum of the cell counts computed by classifyCells.
+ * @param activeCells The list of active cells.
+ * @param numCells The total number of cells.
+ * @param numActiveCells The total number of active cells.
+ */
+kernel void compactActiveCells(
+		global const uint2 *cellOffsets,
+		global uint *activeCells,
+		uint numCells, uint numActiveCells)
+{
+    uint cellIndex = get_global_id(0);
+    if (cellIndex >= numCells) return; // Padding
+
+    // A cell is active if the number of active cells before the next cell is larger.
+    uint activeCellIndex = cellOffsets[cellIndex].x;
+    uint nextActiveCellIndex = cellIndex + 1 < numCells ? cellOffsets[cellIndex + 1].x : numActiveCells;
+    if (nextActiveCellIndex > activeCellIndex) {
+        activeCells[activeCellIndex] = cellIndex;
+    }
+}
+
+/**
+ * Polygonizes the active grid cells using Marching Cubes.
+ * @param cartesianGridCorners The Cartesian grid data storing at each entry the position of a grid corner in xyz and
+ * a scalar value in w.
+ * @param activeCells The list of active cells.
+ * @param cellOffsets The exclusive prefix sum of the cell counts computed by classifyCells.
+ * @param cubeIndices The marching cubes cases computed by classifyCells.
+ * @param triangleVertices The list of generated triangle vertices of the iso surface.
+ * @param numActiveCells The number of active cells.
+ * @param nx, ny, nz The number of grid points in x, y and z direction.
+ * @param isoLevel The iso level of the iso surface to extract.
+*/
+kernel void generateTriangles(
+		global const float4 *cartesianGridCorners,
+		global const uint *activeCells,
+		global const uint2 *cellOffsets,
+		global const uchar *cubeIndices,
+		global float4 *triangleVertices,
+		uint numActiveCells, uint nx, uint ny, uint nz, float isoLevel)
+{
+    SPECIALIZE_GRID_SIZE(nx, ny);
+    uint activeCellIndex = get_global_id(0);
+    if (activeCellIndex >= numActiveCells) return; // Padding
+
+    uint cellIndex = activeCells[activeCellIndex];
+    int3 cell = getCellCoordinates(cellIndex, nx, ny);
+    int cubeIndex = cubeIndices[cellIndex];
+    struct GridCell gridCell;
+    loadGridCellCorners(&gridCell, cartesianGridCorners, nx, ny, cell.x, cell.y, cell.z,
+            getCrossingEdgeCorners(cubeIndex));
+    polygonizeGridCell(&gridCell, cubeIndex, triangleVertices, cellOffsets[cellIndex].y, isoLevel);
+}
+
+/**
+ * Same as generateTriangles, but for a Cartesian grid with implicit geometry (see loadGridCellImplicit).
+ * @param scalarField The scalar values at the grid points.
+ * @param activeCells The list of active cells.
+ * @param cellOffsets The exclusive prefix sum of the cell counts computed by classifyCells.
+ * @param cubeIndices The marching cubes cases computed by classifyCells.
+ * @param triangleVertices The list of generated triangle vertices of the iso surface.
+ * @param numActiveCells The number of active cells.
+ * @param nx, ny, nz The number of grid points in x, y and z direction.
+ * @param isoLevel The iso level of the iso surface to extract.
+ * @param originX, originY, originZ The position of the grid point (0,0,0).
+ * @param dx, dy, dz The distance between two grid points in x, y and z direction.
+ * @param offsetZ The z coordinate of the first grid point layer of the scalar field in the whole grid (for bricks).
+ */
+kernel void generateTrianglesImplicit(
+		global const float *scalarField,
+		global const uint *activeCells,
+		global const uint2 *cellOffsets,
+		global const uchar *cubeIndices,
+		global float4 *triangleVertices,
+		uint numActiveCells, uint nx, uint ny, uint nz, float isoLevel,
+		float originX, float originY, float originZ, float dx, float dy, float dz, uint offsetZ)
+{
+    SPECIALIZE_GRID_SIZE(nx, ny);
+    uint activeCellIndex = get_global_id(0);
+    if (activeCellIndex >= numActiveCells) return; // Padding
+
+    uint cellIndex = activeCells[activeCellIndex];
+    int3 cell = getCellCoordinates(cellIndex, nx, ny);
+    int cubeIndex = cubeIndices[cellIndex];
+    struct GridCell gridCell;
+    loadGridCellCornersImplicit(&gridCell, scalarField, (float3)(originX, originY, originZ), (float3)(dx, dy, dz),
+            nx, ny, cell.x, cell.y, cell.z, offsetZ, getCrossingEdgeCorners(cubeIndex));
+    polygonizeGridCell(&gridCell, cubeIndex, triangleVertices, cellOffsets[cellIndex].y, isoLevel);
+}
+
+/**
+ * The HistoPyramid traversal (see HistoPyramid.cl) generates one triangle per work item instead of all triangles of
+ * a cell. The triangles are written in the same order as by the stream compaction approach.
+ */
+
+#define HISTOPYRAMID_FAN_IN 8u
+
+/**
+ * Finds the cell a triangle belongs to by walking down the HistoPyramid. At every level, the child containing the
+ * triangle is selected by subtracting the triangle counts of the children before it.
+ * @param cellCounts Per cell: Whether the cell is active (x) and its number of triangle vertices (y).
+ * @param pyramid The levels of the HistoPyramid above the cells.
+ * @param levels The offset (x) and number of elements (y) of every level in the pyramid buffer (lowest level first).
+ * @param numLevels The number of levels in the pyramid buffer.
+ * @param numCells The number of cells.
+ * @param triangleIndex The index of the triangle in the iso surface. It is replaced by the index of the triangle in
+ * its cell.
+ * @return The index of the cell the triangle belongs to.
+ */
+uint traverseHistoPyramid(global const uint2 *cellCounts, global const uint *pyramid, global const uint2 *levels,
+        uint numLevels, uint numCells, uint *triangleIndex) {
+    uint index = 0u;
+    uint remaining = *triangleIndex;
+    for (int level = (int)numLevels - 2; level >= 0; level--) {
+        uint2 levelInfo = levels[level];
+        uint child = index * HISTOPYRAMID_FAN_IN;
+        uint end = min(child + HISTOPYRAMID_FAN_IN, levelInfo.y);
+        for (; child + 1u < end; child++) {
+            uint count = pyramid[levelInfo.x + child];
+            if (remaining < count) break;
+            remaining -= count;
+        }
+        index = child;
+    }
+
+    uint cellIndex = index * HISTOPYRAMID_FAN_IN;
+    uint end = min(cellIndex + HISTOPYRAMID_FAN_IN, numCells);
+    for (; cellIndex + 1u < end; cellIndex++) {
+        uint count = cellCounts[cellIndex].y / 3u;
+        if (remaining < count) break;
+        remaining -= count;
+    }
+    *triangleIndex = remaining;
+    return cellIndex;
+}
+
+/**
+ * Returns a bit mask of the corners of a grid cell at the ends of the edges of one of its triangles.
+ * @param cubeIndex The marching cubes case of the cell.
+ * @param triangleIndex The index of the triangle in the cell.
+ */
+int getTriangleCorners(int cubeIndex, uint triangleIndex) {
+    int cornerMask = 0;
+    for (int i = 0; i < 3; i++) {
+        int edge = triTable[cubeIndex][3*triangleIndex + i];
+        cornerMask |= (1 << edgeCorners[edge][0]) | (1 << edgeCorners[edge][1]);
     }
+    return cornerMask;
+}
+
+/**
+ * Generates a single triangle of a grid cell using Marching Cubes.
+ * @param gridCell The grid cell to polygonize (only the corners of getTriangleCorners are needed).
+ * @param cubeIndex The marching cubes case of the cell (see computeCubeIndex).
+ * @param triangleVertices The list of generated triangle vertices of the iso surface.
+ * @param vertexBufferOffset The index of the first vertex of the triangle in triangleVertices.
+ * @param triangleIndex The index of the triangle in the cell.
+ * @param isoLevel The iso level of the iso surface to extract.
+ */
+void polygonizeGridCellTriangle(struct GridCell *gridCell, int cubeIndex, global float4 *triangleVertices,
+        uint vertexBufferOffset, uint triangleIndex, float isoLevel) {
+    for (int i = 0; i < 3; i++) {
+        int edge = triTable[cubeIndex][3*triangleIndex + i];
+        int c0 = edgeCorners[edge][0];
+        int c1 = edgeCorners[edge][1];
+        triangleVertices[vertexBufferOffset + i] = vertexInterpIso(isoLevel,
+                gridCell->vf[c0].xyz, gridCell->vf[c1].xyz, gridCell->vf[c0].w, gridCell->vf[c1].w);
+    }
+}
+
+/**
+ * Polygonizes the grid cells using Marching Cubes with one work item per triangle of the iso surface.
+ * @param cartesianGridCorners The Cartesian grid data storing at each entry the position of a grid corner in xyz and
+ * a scalar value in w.
+ * @param cellCounts The cell counts computed by classifyCells.
+ * @param cubeIndices The marching cubes cases computed by classifyCells.
+ * @param pyramid The levels of the HistoPyramid above the cells.
+ * @param levels The offset (x) and number of elements (y) of every level in the pyramid buffer.
+ * @param triangleVertices The list of generated triangle vertices of the iso surface.
+ * @param numLevels The number of levels in the pyramid buffer.
+ * @param numTriangles The number of triangles of the iso surface.
+ * @param nx, ny, nz The number of grid points in x, y and z direction.
+ * @param isoLevel The iso level of the iso surface to extract.
+ */
+kernel void generateTrianglesHistoPyramid(
+		global const float4 *cartesianGridCorners,
+		global const uint2 *cellCounts,
+		global const uchar *cubeIndices,
+		global const uint *pyramid,
+		global const uint2 *levels,
+		global float4 *triangleVertices,
+		uint numLevels, uint numTriangles, uint nx, uint ny, uint nz, float isoLevel)
+{
+    SPECIALIZE_GRID_SIZE(nx, ny);
+    uint triangleIndex = get_global_id(0);
+    if (triangleIndex >= numTriangles) return; // Padding
+
+    uint cellTriangleIndex = triangleIndex;
+    uint cellIndex = traverseHistoPyramid(cellCounts, pyramid, levels, numLevels, (nx-1)*(ny-1)*(nz-1),
+            &cellTriangleIndex);
+    int3 cell = getCellCoordinates(cellIndex, nx, ny);
+    int cubeIndex = cubeIndices[cellIndex];
+    struct GridCell gridCell;
+    loadGridCellCorners(&gridCell, cartesianGridCorners, nx, ny, cell.x, cell.y, cell.z,
+            getTriangleCorners(cubeIndex, cellTriangleIndex));
+    polygonizeGridCellTriangle(&gridCell, cubeIndex, triangleVertices, 3u*triangleIndex, cellTriangleIndex, isoLevel);
+}
+
+/**
+ * Same as generateTrianglesHistoPyramid, but for a Cartesian grid with implicit geometry (see loadGridCellImplicit).
+ * @param scalarField The scalar values at the grid points.
+ * @param cellCounts The cell counts computed by classifyCells.
+ * @param cubeIndices The marching cubes cases computed by classifyCells.
+ * @param pyramid The levels of the HistoPyramid above the cells.
+ * @param levels The offset (x) and number of elements (y) of every level in the pyramid buffer.
+ * @param triangleVertices The list of generated triangle vertices of the iso surface.
+ * @param numLevels The number of levels in the pyramid buffer.
+ * @param numTriangles The number of triangles of the iso surface.
+ * @param nx, ny, nz The number of grid points in x, y and z direction.
+ * @param isoLevel The iso level of the iso surface to extract.
+ * @param originX, originY, originZ The position of the grid point (0,0,0).
+ * @param dx, dy, dz The distance between two grid points in x, y and z direction.
+ * @param offsetZ The z coordinate of the first grid point layer of the scalar field in the whole grid (for bricks).
+ */
+kernel void generateTrianglesHistoPyramidImplicit(
+		global const float *scalarField,
+		global const uint2 *cellCounts,
+		global const uchar *cubeIndices,
+		global const uint *pyramid,
+		global const uint2 *levels,
+		global float4 *triangleVertices,
+		uint numLevels, uint numTriangles, uint nx, uint ny, uint nz, float isoLevel,
+		float originX, float originY, float originZ, float dx, float dy, float dz, uint offsetZ)
+{
+    SPECIALIZE_GRID_SIZE(nx, ny);
+    uint triangleIndex = get_global_id(0);
+    if (triangleIndex >= numTriangles) return; // Padding
+
+    uint cellTriangleIndex = triangleIndex;
+    uint cellIndex = traverseHistoPyramid(cellCounts, pyramid, levels, numLevels, (nx-1)*(ny-1)*(nz-1),
+            &cellTriangleIndex);
+    int3 cell = getCellCoordinates(cellIndex, nx, ny);
+    int cubeIndex = cubeIndices[cellIndex];
+    struct GridCell gridCell;
+    loadGridCellCornersImplicit(&gridCell, scalarField, (float3)(originX, originY, originZ), (float3)(dx, dy, dz),
+            nx, ny, cell.x, cell.y, cell.z, offsetZ, getTriangleCorners(cubeIndex, cellTriangleIndex));
+    polygonizeGridCellTriangle(&gridCell, cubeIndex, triangleVertices, 3u*triangleIndex, cellTriangleIndex, isoLevel);
+}
+
+/**
+ * Marching cubes with indexed output generates every vertex only once instead of once per adjacent triangle.
+ * Every grid point owns the (up to) three edges to its neighbors in positive x, y and z direction, and a vertex is
+ * generated for every owned edge crossing the iso surface. The triangles of the cells then reference the vertices of
+ * their edges by index. This works in two passes:
+ * 1. classifyPointsIndexed writes for every grid point the number of vertices on its owned edges and the number of
+ *    indices of the cell at the grid point (i.e. the cell with the grid point as its corner 0).
+ * 2. After an exclusive prefix sum over these pairs, generateIndexedMesh writes the vertices and the indices.
+ */
+
+/**
+ * For every edge of a grid cell: The offset of the grid point owning the edge relative to corner 0 (xyz) and the
+ * direction of the edge (w, 0 = x, 1 = y, 2 = z).
+ */
+constant int4 edgeOwners[12] = {
+    (int4)(0, 0, 0, 0), (int4)(1, 0, 0, 2), (int4)(0, 0, 1, 0), (int4)(0, 0, 0, 2),
+    (int4)(0, 1, 0, 0), (int4)(1, 1, 0, 2), (int4)(0, 1, 1, 0), (int4)(0, 1, 0, 2),
+    (int4)(0, 0, 0, 1), (int4)(1, 0, 0, 1), (int4)(1, 0, 1, 1), (int4)(0, 0, 1, 1)
+};
+
+/**
+ * Loads a grid point and its neighbors in positive x, y and z direction, i.e. the end points of the owned edges.
+ * Neighbors outside of the grid are replaced by the grid point itself, so that their edges never cross the iso surface.
+ * @param edgePoints Where the grid point (index 0) and the neighbors (index 1 to 3) should be stored.
+ * @param cartesianGridCorners The Cartesian grid with scalar data.
+ * @param nx, ny, nz The number of grid points in x, y and z direction.
+ * @param x, y, z The coordinates of the grid point.
+ */
+void loadOwnedEdgePoints(float4 *edgePoints, global const float4 *cartesianGridCorners, int nx, int ny, int nz,
+        int x, int y, int z) {
+    int offset = x + y*nx + z*nx*ny;
+    edgePoints[0] = cartesianGridCorners[offset];
+    edgePoints[1] = x + 1 < nx ? cartesianGridCorners[offset + 1] : edgePoints[0];
+    edgePoints[2] = y + 1 < ny ? cartesianGridCorners[offset + nx] : edgePoints[0];
+    edgePoints[3] = z + 1 < nz ? cartesianGridCorners[offset + nx*ny] : edgePoints[0];
+}
+
+/**
+ * Same as loadOwnedEdgePoints, but for a Cartesian grid with implicit geometry (see loadGridCellImplicit).
+ */
+void loadOwnedEdgePointsImplicit(float4 *edgePoints, global const float *scalarField, float3 origin, float3 spacing,
+        int nx, int ny, int nz, int x, int y, int z, int offsetZ) {
+    int offset = x + y*nx + z*nx*ny;
+    int gz = z + offsetZ;
+    edgePoints[0] = (float4)(origin + convert_float3((int3)(x, y, gz)) * spacing, scalarField[offset]);
+    edgePoints[1] = x + 1 < nx ? (float4)(origin + convert_float3((int3)(x + 1, y, gz)) * spacing,
+            scalarField[offset + 1]) : edgePoints[0];
+    edgePoints[2] = y + 1 < ny ? (float4)(origin + convert_float3((int3)(x, y + 1, gz)) * spacing,
+            scalarField[offset + nx]) : edgePoints[0];
+    edgePoints[3] = z + 1 < nz ? (float4)(origin + convert_float3((int3)(x, y, gz + 1)) * spacing,
+            scalarField[offset + nx*ny]) : edgePoints[0];
+}
 
-    // Now, allocate space in the triangle vertex array using the global atomic vertex counter.
-    volatile __global uint *atomicVertexCounter = vertexCounter;
-    uint vertexBufferOffset = atomic_add(atomicVertexCounter, numTrianglePoints);
+/**
+ * Returns a bit mask of the owned edges of a grid point crossing the iso surface (bit i for the edge in direction i).
+ * The same criterion as in computeCubeIndex is used, so that the edges match the ones used in triTable.
+ */
+uint getOwnedEdgeCrossings(float4 *edgePoints, float isoLevel) {
+    bool below = edgePoints[0].w < isoLevel;
+    uint edgeMask = 0u;
+    for (int i = 0; i < 3; i++) {
+        if ((edgePoints[i + 1].w < isoLevel) != below) {
+            edgeMask |= 1u << i;
+        }
+    }
+    return edgeMask;
+}
 
-    // Write to the triangle vertex at the index positions we have reserved.
+/**
+ * Writes the vertices on the owned edges of a grid point crossing the iso surface.
+ */
+void writeOwnedEdgeVertices(float4 *edgePoints, uint edgeMask, global float4 *vertices, uint vertexOffset,
+        float isoLevel) {
+    for (int i = 0; i < 3; i++) {
+        if ((edgeMask & (1u << i)) != 0u) {
+            vertices[vertexOffset++] = vertexInterpIso(isoLevel, edgePoints[0].xyz, edgePoints[i + 1].xyz,
+                    edgePoints[0].w, edgePoints[i + 1].w);
+        }
+    }
+}
+
+/**
+ * Writes the indices of the triangles of a grid cell.
+ * @param cubeIndex The marching cubes case of the cell.
+ * @param pointOffsets The exclusive prefix sum of the point counts computed by classifyPointsIndexed.
+ * @param edgeMasks The owned edges crossing the iso surface of every grid point (see getOwnedEdgeCrossings).
+ * @param indices The index buffer.
+ * @param pointIndex The index of corner 0 of the cell.
+ * @param nx, ny The number of grid points in x and y direction.
+ */
+void writeCellIndices(int cubeIndex, global const uint2 *pointOffsets, global const uchar *edgeMasks,
+        global uint *indices, uint pointIndex, uint nx, uint ny) {
+    uint indexOffset = pointOffsets[pointIndex].y;
     for (int i = 0; triTable[cubeIndex][i] != -1; i++) {
-        triangleVertices[vertexBufferOffset + i] = vertexList[triTable[cubeIndex][i]];
+        int4 owner = edgeOwners[triTable[cubeIndex][i]];
+        uint ownerIndex = pointIndex + owner.x + owner.y*nx + owner.z*nx*ny;
+        // The vertices of a grid point are stored in the order of the edge directions.
+        uint edgeMask = edgeMasks[ownerIndex];
+        indices[indexOffset + i] = pointOffsets[ownerIndex].x + popcount(edgeMask & ((1u << owner.w) - 1u));
+    }
+}
+
+/**
+ * In a first pass, this function computes for every grid point the number of vertices on its owned edges and the
+ * number of indices the cell at the grid point generates.
+ * @param cartesianGridCorners The Cartesian grid data storing at each entry the position of a grid corner in xyz and
+ * a scalar value in w.
+ * @param pointCounts Per grid point: The number of vertices (x) and indices (y).
+ * @param edgeMasks Per grid point: The owned edges crossing the iso surface.
+ * @param cubeIndices Per grid point: The marching cubes case of the cell at the grid point (0 on the border).
+ * @param nx, ny, nz The number of grid points in x, y and z direction.
+ * @param isoLevel The iso level of the iso surface to extract.
+ */
+kernel void classifyPointsIndexed(
+		global const float4 *cartesianGridCorners,
+		global uint2 *pointCounts,
+		global uchar *edgeMasks,
+		global uchar *cubeIndices,
+		uint nx, uint ny, uint nz, float isoLevel)
+{
+    SPECIALIZE_GRID_SIZE(nx, ny);
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    int z = get_global_id(2);
+    if (x >= nx || y >= ny || z >= nz) return; // Padding
+
+    float4 edgePoints[4];
+    loadOwnedEdgePoints(edgePoints, cartesianGridCorners, nx, ny, nz, x, y, z);
+    uint edgeMask = getOwnedEdgeCrossings(edgePoints, isoLevel);
+    int cubeIndex = 0;
+    if (x < nx-1 && y < ny-1 && z < nz-1) {
+        struct GridCell gridCell;
+        loadGridCell(&gridCell, cartesianGridCorners, nx, ny, x, y, z);
+        cubeIndex = computeCubeIndex(&gridCell, isoLevel);
+    }
+    uint pointIndex = x + y*nx + z*nx*ny;
+    pointCounts[pointIndex] = (uint2)(popcount(edgeMask), getNumTriangleVertices(cubeIndex));
+    edgeMasks[pointIndex] = (uchar)edgeMask;
+    cubeIndices[pointIndex] = (uchar)cubeIndex;
+}
+
+/**
+ * Same as classifyPointsIndexed, but for a Cartesian grid with implicit geometry (see loadGridCellImplicit).
+ * @param scalarField The scalar values at the grid points.
+ * @param pointCounts Per grid point: The number of vertices (x) and indices (y).
+ * @param edgeMasks Per grid point: The owned edges crossing the iso surface.
+ * @param cubeIndices Per grid point: The marching cubes case of the cell at the grid point (0 on the border).
+ * @param nx, ny, nz The number of grid points in x, y and z direction.
+ * @param isoLevel The iso level of the iso surface to extract.
+ */
+kernel void classifyPointsIndexedImplicit(
+		global const float *scalarField,
+		global uint2 *pointCounts,
+		global uchar *edgeMasks,
+		global uchar *cubeIndices,
+		uint nx, uint ny, uint nz, float isoLevel)
+{
+    SPECIALIZE_GRID_SIZE(nx, ny);
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    int z = get_global_id(2);
+    if (x >= nx || y >= ny || z >= nz) return; // Padding
+
+    // The positions aren't needed for the classification.
+    float4 edgePoints[4];
+    loadOwnedEdgePointsImplicit(edgePoints, scalarField, (float3)(0.0f), (float3)(0.0f), nx, ny, nz, x, y, z, 0);
+    uint edgeMask = getOwnedEdgeCrossings(edgePoints, isoLevel);
+    int cubeIndex = 0;
+    if (x < nx-1 && y < ny-1 && z < nz-1) {
+        struct GridCell gridCell;
+        loadGridCellImplicit(&gridCell, scalarField, (float3)(0.0f), (float3)(0.0f), nx, ny, x, y, z, 0);
+        cubeIndex = computeCubeIndex(&gridCell, isoLevel);
+    }
+    uint pointIndex = x + y*nx + z*nx*ny;
+    pointCounts[pointIndex] = (uint2)(popcount(edgeMask), getNumTriangleVertices(cubeIndex));
+    edgeMasks[pointIndex] = (uchar)edgeMask;
+    cubeIndices[pointIndex] = (uchar)cubeIndex;
+}
+
+/**
+ * Same as getOwnedEdgeCrossings, but for the grid point (x,y,z) of the work item in the tile of the work group.
+ */
+uint getOwnedEdgeCrossingsTiled(local const float *tile, int nx, int ny, int nz, int x, int y, int z,
+        float isoLevel) {
+    int3 localId = (int3)((int)get_local_id(0), (int)get_local_id(1), (int)get_local_id(2));
+    float4 edgePoints[4];
+    edgePoints[0] = (float4)(0.0f, 0.0f, 0.0f, tile[getTileIndex(localId.x, localId.y, localId.z)]);
+    edgePoints[1] = x + 1 < nx ? (float4)(0.0f, 0.0f, 0.0f, tile[getTileIndex(localId.x + 1, localId.y, localId.z)])
+            : edgePoints[0];
+    edgePoints[2] = y + 1 < ny ? (float4)(0.0f, 0.0f, 0.0f, tile[getTileIndex(localId.x, localId.y + 1, localId.z)])
+            : edgePoints[0];
+    edgePoints[3] = z + 1 < nz ? (float4)(0.0f, 0.0f, 0.0f, tile[getTileIndex(localId.x, localId.y, localId.z + 1)])
+            : edgePoints[0];
+    return getOwnedEdgeCrossings(edgePoints, isoLevel);
+}
+
+/**
+ * Same as classifyPointsIndexed, but loads the grid points of the work group into local memory first.
+ * @param tile Local memory for (lx+1)*(ly+1)*(lz+1) scalar values.
+ */
+kernel void classifyPointsIndexedTiled(
+		global const float4 *cartesianGridCorners,
+		global uint2 *pointCounts,
+		global uchar *edgeMasks,
+		global uchar *cubeIndices,
+		uint nx, uint ny, uint nz, float isoLevel,
+		local float *tile)
+{
+    SPECIALIZE_GRID_SIZE(nx, ny);
+    loadTile(tile, cartesianGridCorners, nx, ny, nz);
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    int z = get_global_id(2);
+    if (x >= nx || y >= ny || z >= nz) return; // Padding
+
+    uint edgeMask = getOwnedEdgeCrossingsTiled(tile, nx, ny, nz, x, y, z, isoLevel);
+    int cubeIndex = 0;
+    if (x < nx-1 && y < ny-1 && z < nz-1) {
+        cubeIndex = computeCubeIndexTiled(tile, isoLevel);
+    }
+    uint pointIndex = x + y*nx + z*nx*ny;
+    pointCounts[pointIndex] = (uint2)(popcount(edgeMask), getNumTriangleVertices(cubeIndex));
+    edgeMasks[pointIndex] = (uchar)edgeMask;
+    cubeIndices[pointIndex] = (uchar)cubeIndex;
+}
+
+/**
+ * Same as classifyPointsIndexedImplicit, but loads the grid points of the work group into local memory first.
+ * @param tile Local memory for (lx+1)*(ly+1)*(lz+1) scalar values.
+ */
+kernel void classifyPointsIndexedImplicitTiled(
+		global const float *scalarField,
+		global uint2 *pointCounts,
+		global uchar *edgeMasks,
+		global uchar *cubeIndices,
+		uint nx, uint ny, uint nz, float isoLevel,
+		local float *tile)
+{
+    SPECIALIZE_GRID_SIZE(nx, ny);
+    loadTileImplicit(tile, scalarField, nx, ny, nz);
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    int z = get_global_id(2);
+    if (x >= nx || y >= ny || z >= nz) return; // Padding
+
+    uint edgeMask = getOwnedEdgeCrossingsTiled(tile, nx, ny, nz, x, y, z, isoLevel);
+    int cubeIndex = 0;
+    if (x < nx-1 && y < ny-1 && z < nz-1) {
+        cubeIndex = computeCubeIndexTiled(tile, isoLevel);
+    }
+    uint pointIndex = x + y*nx + z*nx*ny;
+    pointCounts[pointIndex] = (uint2)(popcount(edgeMask), getNumTriangleVertices(cubeIndex));
+    edgeMasks[pointIndex] = (uchar)edgeMask;
+    cubeIndices[pointIndex] = (uchar)cubeIndex;
+}
+
+/**
+ * Generates the vertices on the owned edges of every grid point and the indices of the triangles of every cell.
+ * @param cartesianGridCorners The Cartesian grid data storing at each entry the position of a grid corner in xyz and
+ * a scalar value in w.
+ * @param pointOffsets The exclusive prefix sum of the point counts computed by classifyPointsIndexed.
+ * @param edgeMasks Per grid point: The owned edges crossing the iso surface.
+ * @param cubeIndices Per grid point: The marching cubes case computed by classifyPointsIndexed.
+ * @param vertices The vertex buffer.
+ * @param indices The index buffer.
+ * @param nx, ny, nz The number of grid points in x, y and z direction.
+ * @param isoLevel The iso level of the iso surface to extract.
+ */
+kernel void generateIndexedMesh(
+		global const float4 *cartesianGridCorners,
+		global const uint2 *pointOffsets,
+		global const uchar *edgeMasks,
+		global const uchar *cubeIndices,
+		global float4 *vertices,
+		global uint *indices,
+		uint nx, uint ny, uint nz, float isoLevel)
+{
+    SPECIALIZE_GRID_SIZE(nx, ny);
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    int z = get_global_id(2);
+    if (x >= nx || y >= ny || z >= nz) return; // Padding
+
+    uint pointIndex = x + y*nx + z*nx*ny;
+    uint edgeMask = edgeMasks[pointIndex];
+    if (edgeMask != 0u) {
+        float4 edgePoints[4];
+        loadOwnedEdgePoints(edgePoints, cartesianGridCorners, nx, ny, nz, x, y, z);
+        writeOwnedEdgeVertices(edgePoints, edgeMask, vertices, pointOffsets[pointIndex].x, isoLevel);
+    }
+    if (x < nx-1 && y < ny-1 && z < nz-1) {
+        writeCellIndices(cubeIndices[pointIndex], pointOffsets, edgeMasks, indices, pointIndex, nx, ny);
+    }
+}
+
+/**
+ * Same as generateIndexedMesh, but for a Cartesian grid with implicit geometry (see loadGridCellImplicit).
+ * @param scalarField The scalar values at the grid points.
+ * @param pointOffsets The exclusive prefix sum of the point counts computed by classifyPointsIndexed.
+ * @param edgeMasks Per grid point: The owned edges crossing the iso surface.
+ * @param cubeIndices Per grid point: The marching cubes case computed by classifyPointsIndexed.
+ * @param vertices The vertex buffer.
+ * @param indices The index buffer.
+ * @param nx, ny, nz The number of grid points in x, y and z direction.
+ * @param isoLevel The iso level of the iso surface to extract.
+ * @param originX, originY, originZ The position of the grid point (0,0,0).
+ * @param dx, dy, dz The distance between two grid points in x, y and z direction.
+ * @param offsetZ The z coordinate of the first grid point layer of the scalar field in the whole grid (for bricks).
+ */
+kernel void generateIndexedMeshImplicit(
+		global const float *scalarField,
+		global const uint2 *pointOffsets,
+		global const uchar *edgeMasks,
+		global const uchar *cubeIndices,
+		global float4 *vertices,
+		global uint *indices,
+		uint nx, uint ny, uint nz, float isoLevel,
+		float originX, float originY, float originZ, float dx, float dy, float dz, uint offsetZ)
+{
+    SPECIALIZE_GRID_SIZE(nx, ny);
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    int z = get_global_id(2);
+    if (x >= nx || y >= ny || z >= nz) return; // Padding
+
+    uint pointIndex = x + y*nx + z*nx*ny;
+    uint edgeMask = edgeMasks[pointIndex];
+    if (edgeMask != 0u) {
+        float4 edgePoints[4];
+        loadOwnedEdgePointsImplicit(edgePoints, scalarField, (float3)(originX, originY, originZ),
+                (float3)(dx, dy, dz), nx, ny, nz, x, y, z, offsetZ);
+        writeOwnedEdgeVertices(edgePoints, edgeMask, vertices, pointOffsets[pointIndex].x, isoLevel);
+    }
+    if (x < nx-1 && y < ny-1 && z < nz-1) {
+        writeCellIndices(cubeIndices[pointIndex], pointOffsets, edgeMasks, indices, pointIndex, nx, ny);
     }
 }
@@ -0,0 +1,105 @@
+/*
+ * BSD 2-Clause License
+ * 
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Work-efficient parallel exclusive prefix sum (scan) over uint2 elements (Blelloch, "Prefix Sums and Their
+ * Applications", 1990; see also GPU Gems 3, chapter 39).
+ * Every work group scans a block of 2 * get_local_size(0) elements in local memory and stores the sum of all elements
+ * in the block. If there is more than one block, the block sums are scanned recursively and added to the elements of
+ * the blocks using addBlockOffsets.
+ */
+
+/**
+ * Computes the exclusive prefix sum of the elements in the block of the work group (in place).
+ * @param data The elements to scan.
+ * @param blockSums The sum of all elements of every block.
+ * @param n The number of elements.
+ * @param temp Local memory for 2 * get_local_size(0) elements.
+ */
+kernel void scanBlocks(global uint2 *data, global uint2 *blockSums, uint n, local uint2 *temp)
+{
+    uint localId = get_local_id(0);
+    uint blockSize = 2 * get_local_size(0);
+    uint blockOffset = get_group_id(0) * blockSize;
+    uint ai = localId;
+    uint bi = localId + get_local_size(0);
+    temp[ai] = blockOffset + ai < n ? data[blockOffset + ai] : (uint2)(0u);
+    temp[bi] = blockOffset + bi < n ? data[blockOffset + bi] : (uint2)(0u);
+
+    // Up-sweep (reduction) phase
+    uint offset = 1;
+    for (uint d = blockSize >> 1; d > 0; d >>= 1) {
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if (localId < d) {
+            uint i = offset * (2*localId + 1) - 1;
+            uint j = offset * (2*localId + 2) - 1;
+            temp[j] += temp[i];
+        }
+        offset <<= 1;
+    }
+
+    if (localId == 0) {
+        blockSums[get_group_id(0)] = temp[blockSize - 1];
+        temp[blockSize - 1] = (uint2)(0u);
+    }
+
+    // Down-sweep phase
+    for (uint d = 1; d < blockSize; d <<= 1) {
+        offset >>= 1;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if (localId < d) {
+            uint i = offset * (2*localId + 1) - 1;
+            uint j = offset * (2*localId + 2) - 1;
+            uint2 t = temp[i];
+            temp[i] = temp[j];
+            temp[j] += t;
+        }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (blockOffset + ai < n) {
+        data[blockOffset + ai] = temp[ai];
+    }
+    if (blockOffset + bi < n) {
+        data[blockOffset + bi] = temp[bi];
+    }
+}
+
+/**
+ * Adds the scanned block sums to the elements of the blocks.
+ * @param data The elements scanned per block by scanBlocks.
+ * @param blockOffsets The exclusive prefix sum of the block sums.
+ * @param n The number of elements.
+ * @param blockSize The number of elements per block.
+ */
+kernel void addBlockOffsets(global uint2 *data, global const uint2 *blockOffsets, uint n, uint blockSize)
+{
+    uint globalId = get_global_id(0);
+    if (globalId >= n) return; // Padding
+    data[globalId] += blockOffsets[globalId / blockSize];
+}
@@ -0,0 +1,261 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <cstring>
+#include "BinaryRequest.hpp"
+
+/**
+ * Converts an IEEE 754 half precision float to single precision.
+ */
+static inline float halfToFloat(uint16_t half) {
+    uint32_t sign = uint32_t(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1Fu;
+    uint32_t mantissa = half & 0x3FFu;
+    uint32_t bits;
+    if (exponent == 0x1Fu) {
+        // Infinity or NaN
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+    } else if (mantissa != 0) {
+        // Subnormal half values are normal single precision values.
+        exponent = 113;
+        while ((mantissa & 0x400u) == 0) {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3FFu) << 13);
+    } else {
+        bits = sign;
+    }
+    float value;
+    memcpy(&value, &bits, sizeof(float));
+    return value;
+}
+
+/**
+ * Converts numValues scalar values of the passed type to float.
+ */
+template<typename T, typename Conversion>
+static void convertScalarValues(BinaryReadStream &stream, BinaryRequest &request, size_t numValues,
+        Conversion conversion) {
+    BinaryArrayView<T> values = stream.readArrayView<T>(numValues);
+    std::vector<T> valuesStorage;
+    if (values.empty()) {
+        // Misaligned data needs to be copied first.
+        valuesStorage.resize(numValues);
+        stream.read((void*)&valuesStorage.front(), sizeof(T) * numValues);
+        values = BinaryArrayView<T>(&valuesStorage.front(), numValues);
+    }
+    request.scalarFieldStorage.resize(numValues);
+    float *scalarField = &request.scalarFieldStorage.front();
+    #pragma omp parallel for
+    for (size_t i = 0; i < numValues; i++) {
+        scalarField[i] = conversion(values[i]);
+    }
+    request.scalarField = scalarField;
+}
+
+/**
+ * Reads an array of numValues elements, preferably without copying it.
+ */
+template<typename T>
+static const T *readArray(BinaryReadStream &stream, std::vector<T> &storage, size_t numValues) {
+    BinaryArrayView<T> view = stream.readArrayView<T>(numValues);
+    if (!view.empty()) {
+        return view.data;
+    }
+    storage.resize(numValues);
+    stream.read((void*)&storage.front(), sizeof(T) * numValues);
+    return &storage.front();
+}
+
+/**
+ * Reads the CartesianGridCorner records of a grid with explicit geometry.
+ */
+static bool readCartesianGridCorners(BinaryReadStream &stream, BinaryRequest &request, size_t numPoints) {
+    if (stream.getRemainingSize() / sizeof(CartesianGridCorner) < numPoints) {
+        std::cerr << "Invalid size of binary request." << std::endl;
+        return false;
+    }
+    request.cartesianGrid = readArray(stream, request.cartesianGridStorage, numPoints);
+    return true;
+}
+
+/**
+ * Returns the size in bytes of one scalar value of the request's data type, or 0 for invalid data types.
+ */
+static size_t getScalarSize(const BinaryRequest &request) {
+    if (request.explicitGeometry) {
+        if (request.dataType != SCALAR_TYPE_FLOAT) {
+            std::cerr << "Grids with explicit geometry need to use float scalar values." << std::endl;
+            return 0;
+        }
+        return sizeof(CartesianGridCorner);
+    }
+    switch (request.dataType) {
+    case SCALAR_TYPE_UINT8:
+        return sizeof(uint8_t);
+    case SCALAR_TYPE_UINT16:
+    case SCALAR_TYPE_HALF:
+        return sizeof(uint16_t);
+    case SCALAR_TYPE_FLOAT:
+        return sizeof(float);
+    default:
+        std::cerr << "Unknown scalar data type " << request.dataType << " in binary request." << std::endl;
+        return 0;
+    }
+}
+
+/**
+ * Reads numPoints grid points in the data type of the request, i.e., either CartesianGridCorner records or scalar
+ * values that are converted to float.
+ */
+static bool readGridPoints(BinaryReadStream &stream, BinaryRequest &request, size_t numPoints) {
+    if (request.explicitGeometry) {
+        return readCartesianGridCorners(stream, request, numPoints);
+    }
+    if (stream.getRemainingSize() / getScalarSize(request) < numPoints) {
+        std::cerr << "Invalid size of binary request." << std::endl;
+        return false;
+    }
+
+    if (request.dataType == SCALAR_TYPE_UINT8) {
+        convertScalarValues<uint8_t>(stream, request, numPoints, [](uint8_t value) { return float(value); });
+    } else if (request.dataType == SCALAR_TYPE_UINT16) {
+        convertScalarValues<uint16_t>(stream, request, numPoints, [](uint16_t value) { return float(value); });
+    } else if (request.dataType == SCALAR_TYPE_HALF) {
+        convertScalarValues<uint16_t>(stream, request, numPoints, halfToFloat);
+    } else {
+        request.scalarField = readArray(stream, request.scalarFieldStorage, numPoints);
+    }
+    return true;
+}
+
+bool readBinaryRequest(BinaryReadStream &stream, BinaryRequest &request) {
+    // Requests in the legacy format start with the number of grid points in x direction.
+    uint32_t magic = 0;
+    if (stream.getRemainingSize() < sizeof(uint32_t)) {
+        std::cerr << "Empty binary request." << std::endl;
+        return false;
+    }
+    stream.read(magic);
+    if (magic != BINARY_REQUEST_MAGIC) {
+        uint32_t nx = magic;
+        if (!isValidGridSize(nx)) {
+            return false;
+        }
+        request.geometry = CartesianGridGeometry(glm::vec3(0.0f), 0.0f, 0.0f, 0.0f, nx, nx, nx);
+        request.isoValues = { 0.0f };
+        request.explicitGeometry = true;
+        return readCartesianGridCorners(stream, request, request.geometry.getNumPoints());
+    }
+
+    BinaryRequestHeader header;
+    header.magic = magic;
+    if (stream.getRemainingSize() < sizeof(BinaryRequestHeader) - sizeof(uint32_t)) {
+        std::cerr << "Binary request header truncated." << std::endl;
+        return false;
+    }
+    stream.read((void*)&header.version, sizeof(BinaryRequestHeader) - sizeof(uint32_t));
+    if (header.version == 0 || header.version > BINARY_REQUEST_VERSION) {
+        std::cerr << "Unsupported binary request version " << header.version << "." << std::endl;
+        return false;
+    }
+    if (!isValidGridSize(header.nx) || !isValidGridSize(header.ny) || !isValidGridSize(header.nz)) {
+        return false;
+    }
+    if (header.numIsoValues == 0 || stream.getRemainingSize() / sizeof(float) < header.numIsoValues) {
+        std::cerr << "Invalid number of iso values in binary request." << std::endl;
+        return false;
+    }
+    request.isoValues.resize(header.numIsoValues);
+    stream.read((void*)&request.isoValues.front(), sizeof(float) * header.numIsoValues);
+
+    request.geometry = CartesianGridGeometry(
+            glm::vec3(header.originX, header.originY, header.originZ), header.dx, header.dy, header.dz,
+            header.nx, header.ny, header.nz);
+    request.indexedOutput = (header.flags & BINARY_REQUEST_FLAG_INDEXED_OUTPUT) != 0;
+    request.flyingEdges = (header.flags & BINARY_REQUEST_FLAG_FLYING_EDGES) != 0;
+    request.streamed = (header.flags & BINARY_REQUEST_FLAG_STREAMED) != 0;
+    request.explicitGeometry = (header.flags & BINARY_REQUEST_FLAG_EXPLICIT_GEOMETRY) != 0;
+    request.dataType = header.dataType;
+    if (getScalarSize(request) == 0) {
+        return false;
+    }
+    // The grid of streamed requests follows in brick messages (see readBinaryBrick).
+    return request.streamed || readGridPoints(stream, request, request.geometry.getNumPoints());
+}
+
+bool isBinaryBrick(const void *data, size_t size) {
+    uint32_t magic = 0;
+    if (size < sizeof(uint32_t)) {
+        return false;
+    }
+    memcpy(&magic, data, sizeof(uint32_t));
+    return magic == BINARY_BRICK_MAGIC;
+}
+
+bool readBinaryBrick(BinaryReadStream &stream, BinaryRequest &request, uint32_t &zBegin, uint32_t &numLayers) {
+    BinaryBrickHeader header;
+    if (stream.getRemainingSize() < sizeof(BinaryBrickHeader)) {
+        std::cerr << "Binary brick header truncated." << std::endl;
+        return false;
+    }
+    stream.read((void*)&header, sizeof(BinaryBrickHeader));
+    if (header.magic != BINARY_BRICK_MAGIC || !request.streamed) {
+        std::cerr << "Unexpected binary brick." << std::endl;
+        return false;
+    }
+    if (header.numLayers < 2 || header.zBegin >= request.geometry.nz
+            || header.numLayers > request.geometry.nz - header.zBegin) {
+        std::cerr << "Invalid binary brick [" << header.zBegin << ", " << size_t(header.zBegin) + header.numLayers
+                << ") of a grid with " << request.geometry.nz << " layers." << std::endl;
+        return false;
+    }
+    zBegin = header.zBegin;
+    numLayers = header.numLayers;
+    return readGridPoints(stream, request, size_t(request.geometry.nx) * size_t(request.geometry.ny) * numLayers);
+}
+
+void writeIndexedMeshResponse(BinaryWriteStream &stream, const TriangleMesh &mesh) {
+    const uint32_t numVertices = mesh.vertices.size();
+    const uint32_t numIndices = mesh.indices.size();
+    stream.reserve(4 * sizeof(uint32_t) + sizeof(glm::vec3) * numVertices + sizeof(uint32_t) * numIndices);
+    stream.write(INDEXED_MESH_RESPONSE_MAGIC);
+    stream.write(INDEXED_MESH_RESPONSE_VERSION);
+    stream.write(numVertices);
+    stream.write(numIndices);
+    if (numVertices > 0) {
+        stream.write((const void*)&mesh.vertices.front(), sizeof(glm::vec3) * numVertices);
+    }
+    if (numIndices > 0) {
+        stream.write((const void*)&mesh.indices.front(), sizeof(uint32_t) * numIndices);
+    }
+}
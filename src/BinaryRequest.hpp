@@ -0,0 +1,159 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MARCHINGCUBESSERVER_BINARYREQUEST_HPP
+#define MARCHINGCUBESSERVER_BINARYREQUEST_HPP
+
+#include <vector>
+#include <cstdint>
+#include "BinaryStream.hpp"
+#include "mc/CartesianGrid.hpp"
+#include "mc/TriangleMesh.hpp"
+
+/// Magic number at the start of versioned binary requests ("MCSG" in little endian byte order).
+const uint32_t BINARY_REQUEST_MAGIC = 0x4753434Du;
+/// The newest supported version of the binary request format.
+const uint32_t BINARY_REQUEST_VERSION = 1u;
+
+/// The data type of the scalar values in a binary request.
+enum ScalarDataType : uint32_t {
+    SCALAR_TYPE_UINT8 = 0, SCALAR_TYPE_UINT16 = 1, SCALAR_TYPE_HALF = 2, SCALAR_TYPE_FLOAT = 3
+};
+
+/// Flags of binary requests.
+enum BinaryRequestFlags : uint32_t {
+    /// The grid has explicit geometry, i.e. the data consists of CartesianGridCorner records (SCALAR_TYPE_FLOAT only).
+    BINARY_REQUEST_FLAG_EXPLICIT_GEOMETRY = 1u,
+    /// The client expects an indexed mesh as a response (see writeIndexedMeshResponse).
+    BINARY_REQUEST_FLAG_INDEXED_OUTPUT = 2u,
+    /// The iso surface should be extracted using flying edges on the CPU.
+    BINARY_REQUEST_FLAG_FLYING_EDGES = 4u,
+    /// The request only consists of the header and the iso values. The grid follows in brick messages (see
+    /// BinaryBrickHeader), so it may be larger than the maximum message size and the memory of the server.
+    BINARY_REQUEST_FLAG_STREAMED = 8u
+};
+
+/**
+ * The header of versioned binary requests (all values in little endian byte order). The header is followed by
+ * numIsoValues float iso values and nx*ny*nz scalar values of the type dataType (with the x index varying fastest).
+ */
+struct BinaryRequestHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nx, ny, nz;
+    float originX, originY, originZ;
+    float dx, dy, dz;
+    uint32_t dataType;
+    uint32_t flags;
+    uint32_t numIsoValues;
+};
+
+/// Magic number at the start of the brick messages of streamed requests ("MCSB" in little endian byte order).
+const uint32_t BINARY_BRICK_MAGIC = 0x4253434Du;
+
+/**
+ * The header of a brick message of a streamed request (see BINARY_REQUEST_FLAG_STREAMED). The header is followed by
+ * the grid points of the layers [zBegin, zBegin + numLayers) in the data type of the request. The first brick starts
+ * with the layer 0, and every further brick starts with the last layer of the previous brick (a ghost layer shared by
+ * both bricks). Every brick has at least two layers. The response is sent after the brick ending with the layer nz-1.
+ */
+struct BinaryBrickHeader {
+    uint32_t magic;
+    uint32_t zBegin;
+    uint32_t numLayers;
+};
+
+/**
+ * The contents of a binary request. Depending on the flags, either scalarField (implicit geometry) or cartesianGrid
+ * (explicit geometry) points to the grid. If possible, the grid isn't copied, but referenced directly in the buffer of
+ * the stream the request was read from. Thus, the buffer needs to stay valid while the request is used.
+ */
+struct BinaryRequest {
+    BinaryRequest() : scalarField(NULL), cartesianGrid(NULL), indexedOutput(false), flyingEdges(false),
+            streamed(false), explicitGeometry(false), dataType(SCALAR_TYPE_FLOAT) {}
+    BinaryRequest(const BinaryRequest&) = delete;
+    BinaryRequest &operator=(const BinaryRequest&) = delete;
+
+    CartesianGridGeometry geometry;
+    std::vector<float> isoValues;
+    const float *scalarField;
+    const CartesianGridCorner *cartesianGrid;
+    bool indexedOutput;
+    bool flyingEdges;
+    /// Whether the grid follows in brick messages (see readBinaryBrick), to which the grid pointers point then.
+    bool streamed;
+    bool explicitGeometry;
+    uint32_t dataType; ///< The ScalarDataType of the grid
+
+    /// Storage for grids that can't be referenced in the buffer (e.g. scalar values converted to float).
+    std::vector<float> scalarFieldStorage;
+    std::vector<CartesianGridCorner> cartesianGridStorage;
+};
+
+/**
+ * Parses a binary request. Both the versioned format (see BinaryRequestHeader) and the legacy format (nx followed by
+ * nx^3 CartesianGridCorner records, iso value 0) are supported. Integer and half precision scalar values are converted
+ * to float. The stream should be a view of the received message (see BinaryReadStream) to avoid copying the grid.
+ * @param stream The stream to read the request from.
+ * @param request The parsed request.
+ * @return False if the request is malformed or uses an unsupported feature.
+ */
+bool readBinaryRequest(BinaryReadStream &stream, BinaryRequest &request);
+
+/**
+ * Returns whether a binary message is a brick of a streamed request (see BinaryBrickHeader).
+ */
+bool isBinaryBrick(const void *data, size_t size);
+
+/**
+ * Parses a brick message of a streamed request. Afterwards, scalarField or cartesianGrid of the request point to the
+ * grid points of the brick (converted to float like in readBinaryRequest).
+ * @param stream The stream to read the brick from (see readBinaryRequest).
+ * @param request The streamed request the brick belongs to.
+ * @param zBegin The first grid point layer of the brick.
+ * @param numLayers The number of grid point layers of the brick.
+ * @return False if the brick is malformed or exceeds the grid.
+ */
+bool readBinaryBrick(BinaryReadStream &stream, BinaryRequest &request, uint32_t &zBegin, uint32_t &numLayers);
+
+/// Magic number at the start of indexed mesh responses ("MCSM" in little endian byte order).
+const uint32_t INDEXED_MESH_RESPONSE_MAGIC = 0x4D53434Du;
+/// The version of the indexed mesh response format.
+const uint32_t INDEXED_MESH_RESPONSE_VERSION = 1u;
+
+/**
+ * Writes an indexed mesh response. Responses to clients not requesting indexed output are plain triangle soups (the
+ * vertices of all triangles as float triples). Indexed mesh responses consist of the magic number, the version, the
+ * number of vertices and the number of indices (uint32 each), followed by the vertices (float triples) and the
+ * indices (uint32, three per triangle). All values are stored in little endian byte order.
+ * @param stream The stream to write the response to.
+ * @param mesh The indexed mesh.
+ */
+void writeIndexedMeshResponse(BinaryWriteStream &stream, const TriangleMesh &mesh);
+
+#endif //MARCHINGCUBESSERVER_BINARYREQUEST_HPP
@@ -98,6 +98,7 @@ BinaryReadStream::BinaryReadStream(BinaryWriteStream &stream)
 	buffer = stream.buffer;
 	bufferSize = stream.bufferSize;
 	bufferStart = 0;
+	ownsBuffer = true;
 
 	// Delete the buffer from the old stream
 	stream.buffer = NULL;
@@ -110,6 +111,7 @@ BinaryReadStream::BinaryReadStream(void *_buffer, size_t _bufferSize)
 	buffer = (uint8_t*)_buffer;
 	bufferSize = _bufferSize;
 	bufferStart = 0;
+	ownsBuffer = true;
 }
 
 BinaryReadStream::BinaryReadStream(const void *_buffer, size_t _bufferSize)
@@ -118,12 +120,28 @@ BinaryReadStream::BinaryReadStream(const void *_buffer, size_t _bufferSize)
 	memcpy(buffer, _buffer, _bufferSize);
 	bufferSize = _bufferSize;
 	bufferStart = 0;
+	ownsBuffer = true;
+}
+
+BinaryReadStream::BinaryReadStream(const void *_buffer, size_t _bufferSize, bool copyBuffer)
+{
+	if (copyBuffer) {
+		buffer = new uint8_t[_bufferSize];
+		memcpy(buffer, _buffer, _bufferSize);
+	} else {
+		buffer = (uint8_t*)_buffer;
+	}
+	bufferSize = _bufferSize;
+	bufferStart = 0;
+	ownsBuffer = copyBuffer;
 }
 
 BinaryReadStream::~BinaryReadStream()
 {
 	if (buffer) {
-		delete[] buffer;
+		if (ownsBuffer) {
+			delete[] buffer;
+		}
 		buffer = NULL;
 		bufferStart = 0;
 		bufferSize = 0;
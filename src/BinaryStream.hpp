@@ -88,16 +88,36 @@ protected:
 	uint8_t *buffer;
 };
 
+/// A non-owning view of an array stored in the buffer of a BinaryReadStream (similar to std::span).
+template<typename T>
+struct BinaryArrayView
+{
+	BinaryArrayView() : data(NULL), size(0) {}
+	BinaryArrayView(const T *data, size_t size) : data(data), size(size) {}
+	inline bool empty() const { return size == 0; }
+	inline const T &operator[](size_t i) const { return data[i]; }
+	inline const T *begin() const { return data; }
+	inline const T *end() const { return data + size; }
+
+	const T *data;
+	size_t size;
+};
+
 class BinaryReadStream
 {
 public:
 	/// Read from passed input stream.
 	BinaryReadStream(BinaryWriteStream &stream);
-	/// Read from passed input buffer.
+	/// Read from passed input buffer (the stream takes ownership of the buffer).
 	BinaryReadStream(void *_buffer, size_t _bufferSize);
+	/// Read from a copy of the passed input buffer.
 	BinaryReadStream(const void *_buffer, size_t _bufferSize);
+	/// If copyBuffer is false, the stream is a view of the passed buffer, which needs to stay valid while reading.
+	BinaryReadStream(const void *_buffer, size_t _bufferSize, bool copyBuffer);
 	~BinaryReadStream();
 	inline size_t getSize() const { return bufferSize; }
+	/// @return The number of bytes that haven't been read yet.
+	inline size_t getRemainingSize() const { return bufferSize - bufferStart; }
 
 	/// Deserialization (see BinaryWriteStream for details).
 	void read(void *data, size_t size);
@@ -116,6 +136,23 @@ public:
 		}
 	}
 
+	/**
+	 * Reads an array of primitive values without copying it. The view is only valid as long as the buffer of the
+	 * stream is. An empty view is returned if the stream is too short or if the data isn't correctly aligned for T
+	 * (in that case, nothing is read and read(void*, size_t) can be used instead).
+	 */
+	template<typename T>
+	BinaryArrayView<T> readArrayView(size_t numElements)
+	{
+		if ((bufferSize - bufferStart) / sizeof(T) < numElements
+				|| reinterpret_cast<uintptr_t>(buffer + bufferStart) % alignof(T) != 0) {
+			return BinaryArrayView<T>();
+		}
+		BinaryArrayView<T> view(reinterpret_cast<const T*>(buffer + bufferStart), numElements);
+		bufferStart += sizeof(T) * numElements;
+		return view;
+	}
+
 	/// Deserialization with pipe operator
 	template<typename T>
 	BinaryReadStream& operator>>(T &val) { read(val); return *this; }
@@ -128,6 +165,8 @@ protected:
 	/// The current point in the buffer where the code reads from
 	size_t bufferStart;
 	uint8_t *buffer;
+	/// False if the stream is only a view of a buffer owned by someone else
+	bool ownsBuffer;
 };
 
 /*! BINARYSTREAM_HPP_ */
@@ -0,0 +1,413 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <algorithm>
+#include "SimdMath.hpp"
+#include "CindyScriptCompiler.hpp"
+
+/*
+ * By default, the build only uses the baseline instruction set of the target (e.g. SSE2 on x86-64). Thus, the batch
+ * evaluator is additionally compiled for AVX2 and AVX-512, and the dynamic loader picks the version supported by the
+ * CPU at startup (function multiversioning). Builds with USE_NATIVE_ARCH on an AVX2 machine don't need the clones.
+ */
+#if defined(__x86_64__) && defined(__linux__) && defined(__has_attribute)
+#if __has_attribute(target_clones) && !defined(__AVX2__)
+#define CDY_BATCH_TARGET_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#endif
+#endif
+#ifndef CDY_BATCH_TARGET_CLONES
+#define CDY_BATCH_TARGET_CLONES
+#endif
+
+namespace {
+
+/*
+ * While compiling, the number of variables and constants isn't known yet. Thus, registers are tagged with their kind
+ * in the upper bits and relocated to the layout [variables | constants | temporaries] after compilation.
+ */
+const uint32_t REGISTER_KIND_SHIFT = 30;
+const uint32_t REGISTER_INDEX_MASK = (1u << REGISTER_KIND_SHIFT) - 1u;
+const uint32_t REGISTER_VARIABLE = 0u << REGISTER_KIND_SHIFT;
+const uint32_t REGISTER_CONSTANT = 1u << REGISTER_KIND_SHIFT;
+const uint32_t REGISTER_TEMPORARY = 2u << REGISTER_KIND_SHIFT;
+
+struct TaggedInstruction {
+    CdyOpcode op;
+    uint32_t dst, lhs, rhs;
+};
+
+bool containsAssignment(const Json::Value &expr) {
+    if (expr["ctype"].asString() == "infix" && expr["oper"].asString() == "=") {
+        return true;
+    }
+    const Json::Value &args = expr["args"];
+    for (Json::ArrayIndex i = 0; i < args.size(); i++) {
+        if (containsAssignment(args[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+class CdyCompiler {
+public:
+    explicit CdyCompiler(CdyProgram &program) : program(program) {}
+
+    uint32_t variable(const std::string &name) {
+        auto it = std::find(program.variableNames.begin(), program.variableNames.end(), name);
+        if (it != program.variableNames.end()) {
+            return REGISTER_VARIABLE | uint32_t(it - program.variableNames.begin());
+        }
+        program.variableNames.push_back(name);
+        return REGISTER_VARIABLE | uint32_t(program.variableNames.size() - 1);
+    }
+
+    uint32_t constant(float value) {
+        auto it = std::find(program.constants.begin(), program.constants.end(), value);
+        if (it != program.constants.end()) {
+            return REGISTER_CONSTANT | uint32_t(it - program.constants.begin());
+        }
+        program.constants.push_back(value);
+        return REGISTER_CONSTANT | uint32_t(program.constants.size() - 1);
+    }
+
+    uint32_t emit(CdyOpcode op, uint32_t lhs, uint32_t rhs = 0) {
+        uint32_t dst = REGISTER_TEMPORARY | numTemporaries++;
+        instructions.push_back({op, dst, lhs, rhs});
+        return dst;
+    }
+
+    uint32_t compile(const Json::Value &expr) {
+        std::string exprType = expr["ctype"].asString();
+        if (exprType == "void") {
+            return constant(0.0f);
+        } else if (exprType == "variable") {
+            return variable(expr["name"].asString());
+        } else if (exprType == "number") {
+            return constant(expr["value"]["real"].asFloat());
+        } else if (exprType == "infix") {
+            const Json::Value &args = expr["args"];
+            std::string operation = expr["oper"].asString();
+            uint32_t lhs = compile(args[0]);
+            if ((lhs & ~REGISTER_INDEX_MASK) == REGISTER_VARIABLE && containsAssignment(args[1])) {
+                // The right-hand side might overwrite the variable before we use its old value.
+                lhs = emit(CDY_OP_MOV, lhs);
+            }
+            uint32_t rhs = compile(args[1]);
+            if (operation == "+") {
+                return emit(CDY_OP_ADD, lhs, rhs);
+            } else if (operation == "-") {
+                return emit(CDY_OP_SUB, lhs, rhs);
+            } else if (operation == "*") {
+                return emit(CDY_OP_MUL, lhs, rhs);
+            } else if (operation == "/") {
+                return emit(CDY_OP_DIV, lhs, rhs);
+            } else if (operation == "^") {
+                return emit(CDY_OP_POW, lhs, rhs);
+            } else if (operation == "=") {
+                uint32_t dst = variable(args[0]["name"].asString());
+                instructions.push_back({CDY_OP_MOV, dst, rhs, 0});
+                program.assignsVariables = true;
+                return rhs;
+            } else if (operation == ";") {
+                return rhs;
+            }
+        } else if (exprType == "function") {
+            std::string operation = expr["oper"].asString();
+            if (operation == "sqrt$1") {
+                return emit(CDY_OP_SQRT, compile(expr["args"][0]));
+            } else if (operation == "sin$1") {
+                return emit(CDY_OP_SIN, compile(expr["args"][0]));
+            } else if (operation == "cos$1") {
+                return emit(CDY_OP_COS, compile(expr["args"][0]));
+            }
+        }
+
+        std::cerr << "Error in compileExpressionCdy: Unknown expression." << std::endl;
+        return constant(0.0f);
+    }
+
+    /// Maps the tagged registers to the final register file layout.
+    bool relocate(uint32_t result) {
+        const uint32_t numVariables = uint32_t(program.variableNames.size());
+        const uint32_t numConstants = uint32_t(program.constants.size());
+        program.numRegisters = numVariables + numConstants + numTemporaries;
+        if (program.numRegisters > uint32_t(UINT16_MAX) + 1u) {
+            return false;
+        }
+
+        auto map = [numVariables, numConstants](uint32_t reg) -> uint16_t {
+            uint32_t index = reg & REGISTER_INDEX_MASK;
+            switch (reg & ~REGISTER_INDEX_MASK) {
+            case REGISTER_VARIABLE:
+                return uint16_t(index);
+            case REGISTER_CONSTANT:
+                return uint16_t(numVariables + index);
+            default:
+                return uint16_t(numVariables + numConstants + index);
+            }
+        };
+
+        program.instructions.clear();
+        program.instructions.reserve(instructions.size());
+        for (const TaggedInstruction &instr : instructions) {
+            program.instructions.push_back({instr.op, map(instr.dst), map(instr.lhs), map(instr.rhs)});
+        }
+        program.resultRegister = map(result);
+        return true;
+    }
+
+private:
+    CdyProgram &program;
+    std::vector<TaggedInstruction> instructions;
+    uint32_t numTemporaries = 0;
+};
+
+}
+
+bool compileExpressionCdy(const Json::Value &expr, const std::vector<std::string> &inputVariables,
+        CdyProgram &program) {
+    program = CdyProgram();
+    CdyCompiler compiler(program);
+    for (const std::string &name : inputVariables) {
+        compiler.variable(name);
+    }
+    program.numInputVariables = uint32_t(program.variableNames.size());
+    uint32_t result = compiler.compile(expr);
+    if (!compiler.relocate(result)) {
+        std::cerr << "Error in compileExpressionCdy: Expression exceeds the maximum number of registers." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+namespace {
+
+void canonicalizeExpressionCdy(const Json::Value &expr, std::string &key) {
+    // Strings are prefixed with their length, such that the representation is unambiguous.
+    auto appendString = [&key](const std::string &str) {
+        key += std::to_string(str.size());
+        key += ':';
+        key += str;
+    };
+
+    std::string exprType = expr["ctype"].asString();
+    appendString(exprType);
+    if (exprType == "variable") {
+        appendString(expr["name"].asString());
+    } else if (exprType == "number") {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%a", expr["value"]["real"].asDouble());
+        appendString(buffer);
+    } else if (exprType == "infix" || exprType == "function") {
+        appendString(expr["oper"].asString());
+    }
+
+    const Json::Value &args = expr["args"];
+    key += '(';
+    for (Json::ArrayIndex i = 0; i < args.size(); i++) {
+        canonicalizeExpressionCdy(args[i], key);
+    }
+    key += ')';
+}
+
+}
+
+std::string canonicalizeExpressionCdy(const Json::Value &expr) {
+    std::string key;
+    canonicalizeExpressionCdy(expr, key);
+    return key;
+}
+
+int CdyProgram::getVariableSlot(const std::string &name) const {
+    auto it = std::find(variableNames.begin(), variableNames.end(), name);
+    if (it == variableNames.end()) {
+        return -1;
+    }
+    return int(it - variableNames.begin());
+}
+
+void CdyProgram::initializeRegisters(std::vector<float> &registers,
+        const std::map<std::string, float> &variables) const {
+    registers.assign(numRegisters, 0.0f);
+    for (size_t i = 0; i < variableNames.size(); i++) {
+        auto it = variables.find(variableNames.at(i));
+        if (it != variables.end()) {
+            registers.at(i) = it->second;
+        }
+    }
+    std::copy(constants.begin(), constants.end(), registers.begin() + variableNames.size());
+}
+
+float CdyProgram::evaluate(float *registers) const {
+    for (const CdyInstruction &instr : instructions) {
+        switch (instr.op) {
+        case CDY_OP_MOV:
+            registers[instr.dst] = registers[instr.lhs];
+            break;
+        case CDY_OP_ADD:
+            registers[instr.dst] = registers[instr.lhs] + registers[instr.rhs];
+            break;
+        case CDY_OP_SUB:
+            registers[instr.dst] = registers[instr.lhs] - registers[instr.rhs];
+            break;
+        case CDY_OP_MUL:
+            registers[instr.dst] = registers[instr.lhs] * registers[instr.rhs];
+            break;
+        case CDY_OP_DIV:
+            registers[instr.dst] = registers[instr.lhs] / registers[instr.rhs];
+            break;
+        case CDY_OP_POW:
+            registers[instr.dst] = std::pow(registers[instr.lhs], registers[instr.rhs]);
+            break;
+        case CDY_OP_SQRT:
+            registers[instr.dst] = std::sqrt(registers[instr.lhs]);
+            break;
+        case CDY_OP_SIN:
+            registers[instr.dst] = std::sin(registers[instr.lhs]);
+            break;
+        case CDY_OP_COS:
+            registers[instr.dst] = std::cos(registers[instr.lhs]);
+            break;
+        }
+    }
+    return registers[resultRegister];
+}
+
+void CdyProgram::initializeBatchRegisters(std::vector<float> &registers,
+        const std::map<std::string, float> &variables) const {
+    std::vector<float> scalarRegisters;
+    initializeRegisters(scalarRegisters, variables);
+    registers.resize(numRegisters * CDY_BATCH_SIZE);
+    for (uint32_t i = 0; i < numRegisters; i++) {
+        std::fill(registers.begin() + i * CDY_BATCH_SIZE, registers.begin() + (i + 1) * CDY_BATCH_SIZE,
+                scalarRegisters.at(i));
+    }
+}
+
+CDY_BATCH_TARGET_CLONES const float *CdyProgram::evaluateBatch(float *registers) const {
+    for (const CdyInstruction &instr : instructions) {
+        float *dst = registers + instr.dst * CDY_BATCH_SIZE;
+        const float *lhs = registers + instr.lhs * CDY_BATCH_SIZE;
+        const float *rhs = registers + instr.rhs * CDY_BATCH_SIZE;
+        switch (instr.op) {
+        case CDY_OP_MOV:
+            #pragma omp simd
+            for (size_t l = 0; l < CDY_BATCH_SIZE; l++) {
+                dst[l] = lhs[l];
+            }
+            break;
+        case CDY_OP_ADD:
+            #pragma omp simd
+            for (size_t l = 0; l < CDY_BATCH_SIZE; l++) {
+                dst[l] = lhs[l] + rhs[l];
+            }
+            break;
+        case CDY_OP_SUB:
+            #pragma omp simd
+            for (size_t l = 0; l < CDY_BATCH_SIZE; l++) {
+                dst[l] = lhs[l] - rhs[l];
+            }
+            break;
+        case CDY_OP_MUL:
+            #pragma omp simd
+            for (size_t l = 0; l < CDY_BATCH_SIZE; l++) {
+                dst[l] = lhs[l] * rhs[l];
+            }
+            break;
+        case CDY_OP_DIV:
+            #pragma omp simd
+            for (size_t l = 0; l < CDY_BATCH_SIZE; l++) {
+                dst[l] = lhs[l] / rhs[l];
+            }
+            break;
+        case CDY_OP_POW: {
+            int numSpecialCases = 0;
+            #pragma omp simd reduction(+:numSpecialCases)
+            for (size_t l = 0; l < CDY_BATCH_SIZE; l++) {
+                numSpecialCases += powSimdIsSpecialCase(lhs[l], rhs[l]) ? 1 : 0;
+            }
+            if (numSpecialCases == 0) {
+                #pragma omp simd
+                for (size_t l = 0; l < CDY_BATCH_SIZE; l++) {
+                    dst[l] = powSimd(lhs[l], rhs[l]);
+                }
+            } else {
+                // Compute the special cases with the scalar function (dst may alias lhs or rhs).
+                float values[CDY_BATCH_SIZE];
+                #pragma omp simd
+                for (size_t l = 0; l < CDY_BATCH_SIZE; l++) {
+                    values[l] = powSimd(lhs[l], rhs[l]);
+                }
+                for (size_t l = 0; l < CDY_BATCH_SIZE; l++) {
+                    if (powSimdIsSpecialCase(lhs[l], rhs[l])) {
+                        values[l] = std::pow(lhs[l], rhs[l]);
+                    }
+                }
+                std::copy(values, values + CDY_BATCH_SIZE, dst);
+            }
+            break;
+        }
+        case CDY_OP_SQRT:
+            #pragma omp simd
+            for (size_t l = 0; l < CDY_BATCH_SIZE; l++) {
+                dst[l] = std::sqrt(lhs[l]);
+            }
+            break;
+        case CDY_OP_SIN:
+        case CDY_OP_COS: {
+            float maxArgument = 0.0f;
+            #pragma omp simd reduction(max:maxArgument)
+            for (size_t l = 0; l < CDY_BATCH_SIZE; l++) {
+                maxArgument = std::max(maxArgument, std::fabs(lhs[l]));
+            }
+            if (!(maxArgument <= SIMD_TRIG_MAX_ARGUMENT)) {
+                // Large (or NaN) arguments need the precise range reduction of the scalar functions.
+                for (size_t l = 0; l < CDY_BATCH_SIZE; l++) {
+                    dst[l] = instr.op == CDY_OP_SIN ? std::sin(lhs[l]) : std::cos(lhs[l]);
+                }
+            } else if (instr.op == CDY_OP_SIN) {
+                #pragma omp simd
+                for (size_t l = 0; l < CDY_BATCH_SIZE; l++) {
+                    dst[l] = sinSimd(lhs[l]);
+                }
+            } else {
+                #pragma omp simd
+                for (size_t l = 0; l < CDY_BATCH_SIZE; l++) {
+                    dst[l] = cosSimd(lhs[l]);
+                }
+            }
+            break;
+        }
+        }
+    }
+    return registers + resultRegister * CDY_BATCH_SIZE;
+}
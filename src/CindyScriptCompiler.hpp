@@ -0,0 +1,129 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MARCHINGCUBESSERVER_CINDYSCRIPTCOMPILER_HPP
+#define MARCHINGCUBESSERVER_CINDYSCRIPTCOMPILER_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <json/json.h>
+
+/// The operations supported by the CindyScript bytecode interpreter.
+enum CdyOpcode : uint8_t {
+    CDY_OP_MOV, CDY_OP_ADD, CDY_OP_SUB, CDY_OP_MUL, CDY_OP_DIV, CDY_OP_POW, CDY_OP_SQRT, CDY_OP_SIN, CDY_OP_COS
+};
+
+/// The number of points evaluated at once by CdyProgram::evaluateBatch.
+const size_t CDY_BATCH_SIZE = 64;
+
+/**
+ * A register machine instruction computing dst = op(lhs, rhs). Unary operations ignore rhs.
+ */
+struct CdyInstruction {
+    CdyOpcode op;
+    uint16_t dst;
+    uint16_t lhs;
+    uint16_t rhs;
+};
+
+/**
+ * A CindyScript expression compiled to a flat register bytecode.
+ * The register file is laid out as [variables | constants | temporaries]. Variables are resolved to register slots
+ * at compile time, so evaluating the program needs neither string compares nor map lookups.
+ */
+class CdyProgram {
+public:
+    /**
+     * Creates a register file for evaluating the program.
+     * @param registers The register file to initialize.
+     * @param variables The values of the variables (variables not contained in the map are set to zero).
+     */
+    void initializeRegisters(std::vector<float> &registers, const std::map<std::string, float> &variables) const;
+
+    /**
+     * Runs the program.
+     * @param registers A register file created by initializeRegisters.
+     * @return The value of the expression.
+     */
+    float evaluate(float *registers) const;
+
+    /**
+     * Creates a register file for evaluating the program on CDY_BATCH_SIZE points at once.
+     * Lane l of register r is stored at index r * CDY_BATCH_SIZE + l.
+     * @param registers The register file to initialize.
+     * @param variables The values of the variables (variables not contained in the map are set to zero).
+     */
+    void initializeBatchRegisters(std::vector<float> &registers,
+            const std::map<std::string, float> &variables) const;
+
+    /**
+     * Runs the program on CDY_BATCH_SIZE points at once. Each operation is applied to all lanes in a loop the compiler
+     * vectorizes (using SSE, AVX2 or AVX-512 depending on the CPU, see CDY_BATCH_TARGET_CLONES).
+     * @param registers A register file created by initializeBatchRegisters.
+     * @return A pointer to the CDY_BATCH_SIZE result values (stored in the register file).
+     */
+    const float *evaluateBatch(float *registers) const;
+
+    /// Returns the register slot of a variable or -1 if the expression doesn't reference it.
+    int getVariableSlot(const std::string &name) const;
+    inline size_t getNumVariables() const { return variableNames.size(); }
+
+    std::vector<CdyInstruction> instructions;
+    std::vector<std::string> variableNames; ///< Variable i is stored in register i.
+    /// The first numInputVariables variables are set per evaluation (e.g. x, y and z), the rest are free variables.
+    uint32_t numInputVariables = 0;
+    std::vector<float> constants; ///< Constant i is stored in register getNumVariables() + i.
+    uint32_t numRegisters = 0;
+    uint16_t resultRegister = 0;
+    /// Whether the expression assigns values to variables (i.e. variable slots need to be reset between evaluations).
+    bool assignsVariables = false;
+};
+
+/**
+ * Compiles a CindyScript expression to a register bytecode program.
+ * @param expr The CindyScript expression to compile (as a parsed source tree).
+ * @param inputVariables Variables that are guaranteed to be stored in the first register slots in the passed order
+ * (e.g. x, y and z for a scalar field).
+ * @param program The compiled program.
+ * @return False if the expression is too large to be compiled.
+ */
+bool compileExpressionCdy(const Json::Value &expr, const std::vector<std::string> &inputVariables,
+        CdyProgram &program);
+
+/**
+ * Creates a canonical representation of a CindyScript expression that only contains the information relevant for
+ * compiling it. Structurally equal expressions map to the same string, which can thus be used as a key for caching
+ * compiled programs (the values of the free variables are not part of the expression).
+ * @param expr The CindyScript expression (as a parsed source tree).
+ * @return The canonical representation.
+ */
+std::string canonicalizeExpressionCdy(const Json::Value &expr);
+
+#endif //MARCHINGCUBESSERVER_CINDYSCRIPTCOMPILER_HPP
@@ -0,0 +1,191 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "CindyScriptInterval.hpp"
+
+namespace {
+
+/// The relative error bound of the single precision evaluation (including the approximations in SimdMath.hpp).
+const double EVALUATION_EPSILON = 1e-5;
+const double TWO_PI = 6.283185307179586476925;
+const double HALF_PI = 1.570796326794896619231;
+
+const CdyInterval UNKNOWN_INTERVAL(std::numeric_limits<double>::quiet_NaN(),
+        std::numeric_limits<double>::quiet_NaN());
+
+inline double magnitude(const CdyInterval &interval) {
+    return std::max(std::fabs(interval.lower), std::fabs(interval.upper));
+}
+
+/// Widens the result of an operation by the rounding error of the single precision evaluation.
+CdyInterval widen(CdyInterval result, double operandMagnitude) {
+    if (std::isnan(result.lower) || std::isnan(result.upper)) {
+        return UNKNOWN_INTERVAL;
+    }
+    double error = EVALUATION_EPSILON * std::max(magnitude(result), operandMagnitude)
+            + std::numeric_limits<float>::denorm_min();
+    return CdyInterval(result.lower - error, result.upper + error);
+}
+
+CdyInterval multiply(const CdyInterval &a, const CdyInterval &b) {
+    double p0 = a.lower * b.lower, p1 = a.lower * b.upper, p2 = a.upper * b.lower, p3 = a.upper * b.upper;
+    if (std::isnan(p0) || std::isnan(p1) || std::isnan(p2) || std::isnan(p3)) {
+        return UNKNOWN_INTERVAL;
+    }
+    return CdyInterval(std::min(std::min(p0, p1), std::min(p2, p3)), std::max(std::max(p0, p1), std::max(p2, p3)));
+}
+
+CdyInterval reciprocal(const CdyInterval &a) {
+    if (a.lower <= 0.0 && a.upper >= 0.0) {
+        return UNKNOWN_INTERVAL;
+    }
+    return CdyInterval(1.0 / a.upper, 1.0 / a.lower);
+}
+
+CdyInterval power(const CdyInterval &a, const CdyInterval &b) {
+    if (b.lower == b.upper && b.lower == std::floor(b.lower)) {
+        // Integer exponent
+        double n = b.lower;
+        if (n == 0.0) {
+            return CdyInterval(1.0, 1.0);
+        }
+        if (n < 0.0) {
+            return reciprocal(power(a, CdyInterval(-n, -n)));
+        }
+        double pl = std::pow(a.lower, n), pu = std::pow(a.upper, n);
+        if (std::fmod(n, 2.0) != 0.0 || a.lower >= 0.0) {
+            // Odd exponents and non-negative bases are monotonically increasing.
+            return CdyInterval(pl, pu);
+        } else if (a.upper <= 0.0) {
+            return CdyInterval(pu, pl);
+        } else {
+            return CdyInterval(0.0, std::max(pl, pu));
+        }
+    }
+
+    // Non-integer exponents are only defined for non-negative bases (and x^y is monotonic in x and y for x > 0).
+    if (a.lower < 0.0 || (a.lower == 0.0 && b.lower <= 0.0)) {
+        return UNKNOWN_INTERVAL;
+    }
+    double p0 = std::pow(a.lower, b.lower), p1 = std::pow(a.lower, b.upper);
+    double p2 = std::pow(a.upper, b.lower), p3 = std::pow(a.upper, b.upper);
+    return CdyInterval(std::min(std::min(p0, p1), std::min(p2, p3)), std::max(std::max(p0, p1), std::max(p2, p3)));
+}
+
+/// Returns true if the interval contains a point offset + k * 2 pi for an integer k.
+inline bool containsPeriodicPoint(const CdyInterval &a, double offset) {
+    return std::ceil((a.lower - offset) / TWO_PI) <= std::floor((a.upper - offset) / TWO_PI);
+}
+
+/**
+ * Computes the range of sin(x + phase) for x in a.
+ */
+CdyInterval sine(const CdyInterval &a, double phase) {
+    if (std::isinf(a.lower) || std::isinf(a.upper)) {
+        return UNKNOWN_INTERVAL;
+    }
+    CdyInterval shifted(a.lower + phase, a.upper + phase);
+    if (shifted.upper - shifted.lower >= TWO_PI) {
+        return CdyInterval(-1.0, 1.0);
+    }
+    double sl = std::sin(shifted.lower), su = std::sin(shifted.upper);
+    double lower = std::min(sl, su), upper = std::max(sl, su);
+    if (containsPeriodicPoint(shifted, HALF_PI)) {
+        upper = 1.0;
+    }
+    if (containsPeriodicPoint(shifted, -HALF_PI)) {
+        lower = -1.0;
+    }
+    return CdyInterval(lower, upper);
+}
+
+}
+
+void initializeIntervalRegistersCdy(const CdyProgram &program, std::vector<CdyInterval> &registers,
+        const std::map<std::string, float> &variables) {
+    std::vector<float> scalarRegisters;
+    program.initializeRegisters(scalarRegisters, variables);
+    registers.resize(program.numRegisters);
+    for (uint32_t i = 0; i < program.numRegisters; i++) {
+        registers.at(i) = CdyInterval(scalarRegisters.at(i), scalarRegisters.at(i));
+    }
+}
+
+CdyInterval evaluateIntervalCdy(const CdyProgram &program, CdyInterval *registers) {
+    for (const CdyInstruction &instr : program.instructions) {
+        const CdyInterval a = registers[instr.lhs];
+        const CdyInterval b = registers[instr.rhs];
+        if (a.isUnknown() || (b.isUnknown() && instr.op != CDY_OP_MOV && instr.op != CDY_OP_SQRT
+                && instr.op != CDY_OP_SIN && instr.op != CDY_OP_COS)) {
+            registers[instr.dst] = UNKNOWN_INTERVAL;
+            continue;
+        }
+
+        CdyInterval result;
+        double operandMagnitude = magnitude(a);
+        switch (instr.op) {
+        case CDY_OP_MOV:
+            registers[instr.dst] = a;
+            continue;
+        case CDY_OP_ADD:
+            result = CdyInterval(a.lower + b.lower, a.upper + b.upper);
+            operandMagnitude = std::max(operandMagnitude, magnitude(b));
+            break;
+        case CDY_OP_SUB:
+            result = CdyInterval(a.lower - b.upper, a.upper - b.lower);
+            operandMagnitude = std::max(operandMagnitude, magnitude(b));
+            break;
+        case CDY_OP_MUL:
+            // x*x is generated by strength reduction of powers and is never negative.
+            result = instr.lhs == instr.rhs ? power(a, CdyInterval(2.0, 2.0)) : multiply(a, b);
+            break;
+        case CDY_OP_DIV:
+            result = multiply(a, reciprocal(b));
+            break;
+        case CDY_OP_POW:
+            result = power(a, b);
+            break;
+        case CDY_OP_SQRT:
+            result = a.lower >= 0.0 ? CdyInterval(std::sqrt(a.lower), std::sqrt(a.upper)) : UNKNOWN_INTERVAL;
+            break;
+        case CDY_OP_SIN:
+            result = sine(a, 0.0);
+            operandMagnitude = 0.0;
+            break;
+        case CDY_OP_COS:
+            result = sine(a, HALF_PI);
+            operandMagnitude = 0.0;
+            break;
+        }
+        registers[instr.dst] = widen(result, operandMagnitude);
+    }
+    return registers[program.resultRegister];
+}
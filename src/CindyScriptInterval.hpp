@@ -0,0 +1,73 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MARCHINGCUBESSERVER_CINDYSCRIPTINTERVAL_HPP
+#define MARCHINGCUBESSERVER_CINDYSCRIPTINTERVAL_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include "CindyScriptCompiler.hpp"
+
+/// Edge length (in grid cells) of the blocks in which sampled scalar fields are culled using interval arithmetic.
+const uint32_t CDY_CULLING_BLOCK_SIZE = 8;
+
+/**
+ * A closed interval [lower, upper]. If the bounds are NaN, nothing is known about the value range (e.g. because the
+ * expression may evaluate to NaN, like sqrt(x) for an interval containing negative numbers).
+ */
+struct CdyInterval {
+    double lower, upper;
+
+    CdyInterval() : lower(0.0), upper(0.0) {}
+    CdyInterval(double lower, double upper) : lower(lower), upper(upper) {}
+    inline bool isUnknown() const { return lower != lower || upper != upper; }
+    /// Returns true if the interval provably doesn't contain the passed value.
+    inline bool excludes(double value) const { return !isUnknown() && (value < lower || value > upper); }
+};
+
+/**
+ * Creates a register file for evaluating a program using interval arithmetic.
+ * @param program The compiled program.
+ * @param registers The register file to initialize.
+ * @param variables The values of the variables (variables not contained in the map are set to zero).
+ */
+void initializeIntervalRegistersCdy(const CdyProgram &program, std::vector<CdyInterval> &registers,
+        const std::map<std::string, float> &variables);
+
+/**
+ * Evaluates a program using interval arithmetic, i.e. computes an interval that contains the values of the expression
+ * for all variable values in the input intervals. The bounds are widened to account for the rounding errors of the
+ * (single precision, possibly vectorized) evaluation of the program.
+ * @param program The compiled program.
+ * @param registers A register file created by initializeIntervalRegistersCdy with the input variable intervals set.
+ * @return The interval containing the values of the expression.
+ */
+CdyInterval evaluateIntervalCdy(const CdyProgram &program, CdyInterval *registers);
+
+#endif //MARCHINGCUBESSERVER_CINDYSCRIPTINTERVAL_HPP
@@ -0,0 +1,174 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include "CindyScriptInterval.hpp"
+#include "CindyScriptOpenCL.hpp"
+
+namespace {
+
+/// Formats a float as an exact hexadecimal OpenCL C literal.
+std::string formatFloatLiteral(float value) {
+    if (std::isnan(value)) {
+        return "NAN";
+    } else if (std::isinf(value)) {
+        return value < 0.0f ? "(-INFINITY)" : "INFINITY";
+    }
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), value < 0.0f ? "(%af)" : "%af", double(value));
+    return buffer;
+}
+
+class OpenCLTranslator {
+public:
+    explicit OpenCLTranslator(const CdyProgram &program) : program(program), declared(program.numRegisters, false) {
+        numVariables = uint32_t(program.getNumVariables());
+        numConstants = uint32_t(program.constants.size());
+    }
+
+    std::string operand(uint16_t reg) {
+        if (reg >= numVariables && reg < numVariables + numConstants) {
+            return formatFloatLiteral(program.constants.at(reg - numVariables));
+        }
+        return "r" + std::to_string(reg);
+    }
+
+    std::string destination(uint16_t reg) {
+        if (declared.at(reg)) {
+            return "r" + std::to_string(reg);
+        }
+        declared.at(reg) = true;
+        return "float r" + std::to_string(reg);
+    }
+
+    std::string translate() {
+        std::ostringstream code;
+        code << "/**\n"
+             << " * Samples a scalar field generated from a CindyScript function on a Cartesian grid.\n"
+             << " */\n"
+             << "kernel void " << CDY_SCALAR_FIELD_KERNEL_NAME << "(\n"
+             << "        global float *scalarField, global const float *variables,\n"
+             << "        float originX, float originY, float originZ, float dx, float dy, float dz,\n"
+             << "        uint nx, uint ny, uint nz, global const float *blockValues,\n"
+             << "        uint numBlocksX, uint numBlocksY, uint numBlocksZ, uint offsetZ)\n"
+             << "{\n"
+             << "    uint x = get_global_id(0);\n"
+             << "    uint y = get_global_id(1);\n"
+             << "    uint localZ = get_global_id(2);\n"
+             << "    if (x >= nx || y >= ny || localZ >= nz) return; // Padding\n"
+             << "    uint z = localZ + offsetZ; // In the whole grid\n"
+             << "    float3 position = (float3)(originX + x*dx, originY + y*dy, originZ + z*dz);\n"
+             << "\n"
+             << "    // Grid points only belonging to culled blocks are set to the sentinel value of the block.\n"
+             << "    if (numBlocksX > 0) {\n"
+             << "        uint3 numBlocks = (uint3)(numBlocksX, numBlocksY, numBlocksZ);\n"
+             << "        uint3 blockStart = (uint3)(x > 0 ? (x-1)/" << CDY_CULLING_BLOCK_SIZE
+             << " : 0, y > 0 ? (y-1)/" << CDY_CULLING_BLOCK_SIZE
+             << " : 0, z > 0 ? (z-1)/" << CDY_CULLING_BLOCK_SIZE << " : 0);\n"
+             << "        uint3 blockEnd = min((uint3)(x, y, z) / " << CDY_CULLING_BLOCK_SIZE
+             << ", numBlocks - (uint3)(1));\n"
+             << "        bool culled = true;\n"
+             << "        for (uint bz = blockStart.z; bz <= blockEnd.z; bz++) {\n"
+             << "            for (uint by = blockStart.y; by <= blockEnd.y; by++) {\n"
+             << "                for (uint bx = blockStart.x; bx <= blockEnd.x; bx++) {\n"
+             << "                    culled = culled && !isnan(blockValues[(bz*numBlocks.y + by)*numBlocks.x + bx]);\n"
+             << "                }\n"
+             << "            }\n"
+             << "        }\n"
+             << "        if (culled) {\n"
+             << "            uint blockIndex = (blockStart.z*numBlocks.y + blockStart.y)*numBlocks.x + blockStart.x;\n"
+             << "            scalarField[x + y*nx + localZ*nx*ny] = blockValues[blockIndex];\n"
+             << "            return;\n"
+             << "        }\n"
+             << "    }\n"
+             << "\n";
+
+        // Registers 0, 1 and 2 store the position, the other variables are passed by the host.
+        for (uint16_t reg = 0; reg < numVariables; reg++) {
+            declared.at(reg) = true;
+            if (reg < 3) {
+                code << "    float r" << reg << " = position." << "xyz"[reg] << ";\n";
+            } else {
+                code << "    float r" << reg << " = variables[" << reg << "];\n";
+            }
+        }
+
+        for (const CdyInstruction &instr : program.instructions) {
+            std::string lhs = operand(instr.lhs);
+            std::string rhs = operand(instr.rhs);
+            std::string expression;
+            switch (instr.op) {
+            case CDY_OP_MOV:
+                expression = lhs;
+                break;
+            case CDY_OP_ADD:
+                expression = lhs + " + " + rhs;
+                break;
+            case CDY_OP_SUB:
+                expression = lhs + " - " + rhs;
+                break;
+            case CDY_OP_MUL:
+                expression = lhs + " * " + rhs;
+                break;
+            case CDY_OP_DIV:
+                expression = lhs + " / " + rhs;
+                break;
+            case CDY_OP_POW:
+                expression = "pow(" + lhs + ", " + rhs + ")";
+                break;
+            case CDY_OP_SQRT:
+                expression = "sqrt(" + lhs + ")";
+                break;
+            case CDY_OP_SIN:
+                expression = "sin(" + lhs + ")";
+                break;
+            case CDY_OP_COS:
+                expression = "cos(" + lhs + ")";
+                break;
+            }
+            code << "    " << destination(instr.dst) << " = " << expression << ";\n";
+        }
+
+        code << "    scalarField[x + y*nx + localZ*nx*ny] = " << operand(program.resultRegister) << ";\n"
+             << "}\n";
+        return code.str();
+    }
+
+private:
+    const CdyProgram &program;
+    std::vector<bool> declared;
+    uint32_t numVariables, numConstants;
+};
+
+}
+
+std::string translateProgramToOpenCLCdy(const CdyProgram &program) {
+    return OpenCLTranslator(program).translate();
+}
@@ -0,0 +1,56 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MARCHINGCUBESSERVER_CINDYSCRIPTOPENCL_HPP
+#define MARCHINGCUBESSERVER_CINDYSCRIPTOPENCL_HPP
+
+#include <string>
+#include "CindyScriptCompiler.hpp"
+
+/// The name of the kernel generated by translateProgramToOpenCLCdy.
+const char *const CDY_SCALAR_FIELD_KERNEL_NAME = "sampleScalarField";
+
+/**
+ * Translates a compiled CindyScript scalar field function to an OpenCL C kernel sampling the function on a Cartesian
+ * grid with implicit geometry. The register slots 0, 1 and 2 of the program need to store x, y and z (see
+ * compileScalarFieldCdy).
+ * The generated kernel has the following signature:
+ * kernel void sampleScalarField(global float *scalarField, global const float *variables,
+ *         float originX, float originY, float originZ, float dx, float dy, float dz,
+ *         uint nx, uint ny, uint nz, global const float *blockValues,
+ *         uint numBlocksX, uint numBlocksY, uint numBlocksZ, uint offsetZ)
+ * The variables buffer stores the values of the variable register slots of the program. Thus, the same kernel can be
+ * reused when only the values of the free variables change. blockValues stores the culled blocks computed by
+ * computeCulledBlocks (numBlocksX is zero if no block was culled). The kernel can sample a brick of nz grid point
+ * layers of a larger grid starting at the layer offsetZ, where origin and the culled blocks refer to the whole grid.
+ * @param program The program to translate.
+ * @return The OpenCL C source code of the kernel.
+ */
+std::string translateProgramToOpenCLCdy(const CdyProgram &program);
+
+#endif //MARCHINGCUBESSERVER_CINDYSCRIPTOPENCL_HPP
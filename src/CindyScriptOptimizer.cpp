@@ -0,0 +1,335 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <tuple>
+#include <algorithm>
+#include "CindyScriptOptimizer.hpp"
+
+namespace {
+
+const uint32_t NO_VALUE = UINT32_MAX;
+/// Powers x^n with |n| <= MAX_STRENGTH_REDUCED_EXPONENT are reduced to multiplications.
+const int MAX_STRENGTH_REDUCED_EXPONENT = 8;
+
+enum ValueKind {
+    VALUE_VARIABLE, VALUE_CONSTANT, VALUE_OPERATION
+};
+
+/**
+ * A node in the data flow graph. Operands always have a smaller ID than the values using them.
+ */
+struct Value {
+    ValueKind kind;
+    CdyOpcode op;
+    uint32_t lhs, rhs;
+    float constant;
+    uint32_t variable; ///< The variable slot in the unoptimized program
+};
+
+inline bool isUnary(CdyOpcode op) {
+    return op == CDY_OP_SQRT || op == CDY_OP_SIN || op == CDY_OP_COS;
+}
+
+/// Evaluates an operation on constants with the same semantics as CdyProgram::evaluate.
+float foldOperation(CdyOpcode op, float lhs, float rhs) {
+    switch (op) {
+    case CDY_OP_ADD:
+        return lhs + rhs;
+    case CDY_OP_SUB:
+        return lhs - rhs;
+    case CDY_OP_MUL:
+        return lhs * rhs;
+    case CDY_OP_DIV:
+        return lhs / rhs;
+    case CDY_OP_POW:
+        return std::pow(lhs, rhs);
+    case CDY_OP_SQRT:
+        return std::sqrt(lhs);
+    case CDY_OP_SIN:
+        return std::sin(lhs);
+    case CDY_OP_COS:
+        return std::cos(lhs);
+    default:
+        return lhs;
+    }
+}
+
+/**
+ * A data flow graph in SSA form. All values are hash-consed, i.e. structurally equal values (common subexpressions)
+ * are only stored once.
+ */
+class DataFlowGraph {
+public:
+    uint32_t variable(uint32_t slot) {
+        Value value = {VALUE_VARIABLE, CDY_OP_MOV, NO_VALUE, NO_VALUE, 0.0f, slot};
+        values.push_back(value);
+        return uint32_t(values.size() - 1);
+    }
+
+    uint32_t constant(float constant) {
+        uint32_t bits;
+        std::memcpy(&bits, &constant, sizeof(float));
+        auto it = constantIds.find(bits);
+        if (it != constantIds.end()) {
+            return it->second;
+        }
+        Value value = {VALUE_CONSTANT, CDY_OP_MOV, NO_VALUE, NO_VALUE, constant, 0};
+        values.push_back(value);
+        constantIds[bits] = uint32_t(values.size() - 1);
+        return uint32_t(values.size() - 1);
+    }
+
+    uint32_t operation(CdyOpcode op, uint32_t lhs, uint32_t rhs = NO_VALUE) {
+        // Constant folding
+        if (isConstant(lhs) && (rhs == NO_VALUE || isConstant(rhs))) {
+            return constant(foldOperation(op, values.at(lhs).constant,
+                    rhs == NO_VALUE ? 0.0f : values.at(rhs).constant));
+        }
+
+        // Algebraic simplifications and strength reduction
+        switch (op) {
+        case CDY_OP_ADD:
+            if (isConstant(rhs, 0.0f)) {
+                return lhs;
+            } else if (isConstant(lhs, 0.0f)) {
+                return rhs;
+            }
+            break;
+        case CDY_OP_SUB:
+            if (isConstant(rhs, 0.0f)) {
+                return lhs;
+            }
+            break;
+        case CDY_OP_MUL:
+            if (isConstant(rhs, 1.0f)) {
+                return lhs;
+            } else if (isConstant(lhs, 1.0f)) {
+                return rhs;
+            }
+            break;
+        case CDY_OP_DIV:
+            if (isConstant(rhs, 1.0f)) {
+                return lhs;
+            }
+            break;
+        case CDY_OP_POW:
+            if (isConstant(rhs)) {
+                float exponent = values.at(rhs).constant;
+                if (exponent == 0.5f) {
+                    return operation(CDY_OP_SQRT, lhs);
+                }
+                if (exponent == std::floor(exponent) && std::fabs(exponent) <= MAX_STRENGTH_REDUCED_EXPONENT) {
+                    int n = int(exponent);
+                    if (n == 0) {
+                        return constant(1.0f);
+                    }
+                    uint32_t power = integerPower(lhs, n < 0 ? -n : n);
+                    return n < 0 ? operation(CDY_OP_DIV, constant(1.0f), power) : power;
+                }
+            }
+            break;
+        default:
+            break;
+        }
+
+        // Canonical operand order for commutative operations
+        if ((op == CDY_OP_ADD || op == CDY_OP_MUL) && lhs > rhs) {
+            std::swap(lhs, rhs);
+        }
+
+        // Common subexpression elimination
+        auto key = std::make_tuple(int(op), lhs, rhs);
+        auto it = operationIds.find(key);
+        if (it != operationIds.end()) {
+            return it->second;
+        }
+        Value value = {VALUE_OPERATION, op, lhs, rhs, 0.0f, 0};
+        values.push_back(value);
+        operationIds[key] = uint32_t(values.size() - 1);
+        return uint32_t(values.size() - 1);
+    }
+
+    std::vector<Value> values;
+
+private:
+    inline bool isConstant(uint32_t id) {
+        return values.at(id).kind == VALUE_CONSTANT;
+    }
+
+    inline bool isConstant(uint32_t id, float constant) {
+        return values.at(id).kind == VALUE_CONSTANT && values.at(id).constant == constant;
+    }
+
+    /// Computes base^n (n > 0) using binary exponentiation.
+    uint32_t integerPower(uint32_t base, int n) {
+        uint32_t result = NO_VALUE;
+        while (n > 0) {
+            if (n & 1) {
+                result = result == NO_VALUE ? base : operation(CDY_OP_MUL, result, base);
+            }
+            n >>= 1;
+            if (n > 0) {
+                base = operation(CDY_OP_MUL, base, base);
+            }
+        }
+        return result;
+    }
+
+    std::map<uint32_t, uint32_t> constantIds;
+    std::map<std::tuple<int, uint32_t, uint32_t>, uint32_t> operationIds;
+};
+
+}
+
+void optimizeProgramCdy(CdyProgram &program, const std::map<std::string, float> *variableValues) {
+    // 1. Convert the program to a data flow graph. Assignments only change which value a register refers to.
+    DataFlowGraph graph;
+    std::vector<uint32_t> registerValues(program.numRegisters, NO_VALUE);
+    const uint32_t numVariables = uint32_t(program.getNumVariables());
+    for (uint32_t slot = 0; slot < numVariables; slot++) {
+        if (variableValues && slot >= program.numInputVariables) {
+            auto it = variableValues->find(program.variableNames.at(slot));
+            registerValues.at(slot) = graph.constant(it != variableValues->end() ? it->second : 0.0f);
+        } else {
+            registerValues.at(slot) = graph.variable(slot);
+        }
+    }
+    for (size_t i = 0; i < program.constants.size(); i++) {
+        registerValues.at(numVariables + i) = graph.constant(program.constants.at(i));
+    }
+    for (const CdyInstruction &instr : program.instructions) {
+        if (instr.op == CDY_OP_MOV) {
+            registerValues.at(instr.dst) = registerValues.at(instr.lhs);
+        } else {
+            registerValues.at(instr.dst) = graph.operation(instr.op, registerValues.at(instr.lhs),
+                    isUnary(instr.op) ? NO_VALUE : registerValues.at(instr.rhs));
+        }
+    }
+    const uint32_t result = registerValues.at(program.resultRegister);
+    const std::vector<Value> &values = graph.values;
+
+    // 2. Dead code elimination
+    std::vector<bool> live(values.size(), false);
+    live.at(result) = true;
+    for (size_t id = values.size(); id-- > 0; ) {
+        if (live.at(id) && values.at(id).kind == VALUE_OPERATION) {
+            live.at(values.at(id).lhs) = true;
+            if (values.at(id).rhs != NO_VALUE) {
+                live.at(values.at(id).rhs) = true;
+            }
+        }
+    }
+
+    // 3. Register allocation. The input variables keep their slots.
+    CdyProgram optimized;
+    std::vector<uint32_t> registers(values.size(), NO_VALUE);
+    std::vector<uint32_t> variableRegisters(numVariables, NO_VALUE);
+    for (uint32_t slot = 0; slot < program.numInputVariables; slot++) {
+        variableRegisters.at(slot) = slot;
+        optimized.variableNames.push_back(program.variableNames.at(slot));
+    }
+    optimized.numInputVariables = program.numInputVariables;
+    for (size_t id = 0; id < values.size(); id++) {
+        const Value &value = values.at(id);
+        if (live.at(id) && value.kind == VALUE_VARIABLE && variableRegisters.at(value.variable) == NO_VALUE) {
+            variableRegisters.at(value.variable) = uint32_t(optimized.variableNames.size());
+            optimized.variableNames.push_back(program.variableNames.at(value.variable));
+        }
+    }
+    for (size_t id = 0; id < values.size(); id++) {
+        const Value &value = values.at(id);
+        if (value.kind == VALUE_VARIABLE) {
+            registers.at(id) = variableRegisters.at(value.variable);
+        } else if (live.at(id) && value.kind == VALUE_CONSTANT) {
+            registers.at(id) = uint32_t(optimized.variableNames.size() + optimized.constants.size());
+            optimized.constants.push_back(value.constant);
+        }
+    }
+
+    std::vector<uint32_t> operations;
+    for (size_t id = 0; id < values.size(); id++) {
+        if (live.at(id) && values.at(id).kind == VALUE_OPERATION) {
+            operations.push_back(uint32_t(id));
+        }
+    }
+    // The index of the last operation reading a value (the result is never released).
+    std::vector<size_t> lastUse(values.size(), 0);
+    for (size_t i = 0; i < operations.size(); i++) {
+        const Value &value = values.at(operations.at(i));
+        lastUse.at(value.lhs) = i;
+        if (value.rhs != NO_VALUE) {
+            lastUse.at(value.rhs) = i;
+        }
+    }
+    lastUse.at(result) = operations.size();
+
+    const uint32_t firstTemporary = uint32_t(optimized.variableNames.size() + optimized.constants.size());
+    uint32_t numRegisters = firstTemporary;
+    std::vector<uint32_t> freeRegisters;
+    for (size_t i = 0; i < operations.size(); i++) {
+        uint32_t id = operations.at(i);
+        const Value &value = values.at(id);
+        // Registers of temporaries can be reused by this operation after their last use.
+        if (values.at(value.lhs).kind == VALUE_OPERATION && lastUse.at(value.lhs) == i) {
+            freeRegisters.push_back(registers.at(value.lhs));
+        }
+        if (value.rhs != NO_VALUE && value.rhs != value.lhs && values.at(value.rhs).kind == VALUE_OPERATION
+                && lastUse.at(value.rhs) == i) {
+            freeRegisters.push_back(registers.at(value.rhs));
+        }
+        if (freeRegisters.empty()) {
+            registers.at(id) = numRegisters++;
+        } else {
+            registers.at(id) = freeRegisters.back();
+            freeRegisters.pop_back();
+        }
+    }
+
+    if (numRegisters > uint32_t(UINT16_MAX) + 1u) {
+        // Keep the unoptimized program.
+        return;
+    }
+
+    // 4. Emit the optimized bytecode.
+    for (uint32_t id : operations) {
+        const Value &value = values.at(id);
+        CdyInstruction instr;
+        instr.op = value.op;
+        instr.dst = uint16_t(registers.at(id));
+        instr.lhs = uint16_t(registers.at(value.lhs));
+        instr.rhs = value.rhs == NO_VALUE ? uint16_t(0) : uint16_t(registers.at(value.rhs));
+        optimized.instructions.push_back(instr);
+    }
+    optimized.numRegisters = numRegisters;
+    optimized.resultRegister = uint16_t(registers.at(result));
+    optimized.assignsVariables = false;
+    program = optimized;
+}
@@ -0,0 +1,52 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MARCHINGCUBESSERVER_CINDYSCRIPTOPTIMIZER_HPP
+#define MARCHINGCUBESSERVER_CINDYSCRIPTOPTIMIZER_HPP
+
+#include <map>
+#include <string>
+#include "CindyScriptCompiler.hpp"
+
+/**
+ * Optimizes a compiled CindyScript program. The program is converted to a data flow graph in SSA form, on which
+ * - assignments to variables are resolved (i.e. the optimized program never writes to variable slots),
+ * - constant subtrees are folded,
+ * - powers with small integer exponents are reduced to multiplications (and x^0.5 to a square root),
+ * - trivial operations like x+0 or x*1 are removed,
+ * - common subexpressions are merged and dead code is eliminated.
+ * Finally, the temporary registers are reallocated, such that registers are reused after their last use.
+ * @param program The program to optimize (in place).
+ * @param variableValues If not NULL, the free variables (i.e. all but the input variables) are substituted by the
+ * passed values and folded into the program. Variables not contained in the map are substituted by zero (like when
+ * evaluating the program). If NULL, only the structure of the expression is optimized, such that the program can be
+ * reused for different variable values.
+ */
+void optimizeProgramCdy(CdyProgram &program, const std::map<std::string, float> *variableValues = NULL);
+
+#endif //MARCHINGCUBESSERVER_CINDYSCRIPTOPTIMIZER_HPP
@@ -0,0 +1,103 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MARCHINGCUBESSERVER_LRUCACHE_HPP
+#define MARCHINGCUBESSERVER_LRUCACHE_HPP
+
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * A cache with a maximum number of entries that evicts the least recently used entry when it is full.
+ * The cache counts hits, misses and evictions for reporting its efficiency.
+ */
+template<typename Key, typename Value>
+class LruCache {
+public:
+    /// @param maxSize The maximum number of cached entries.
+    explicit LruCache(size_t maxSize) : maxSize(maxSize) {}
+
+    /**
+     * Looks up an entry and marks it as the most recently used one.
+     * @return A pointer to the cached value or NULL if the key is not in the cache.
+     */
+    Value *find(const Key &key) {
+        auto it = index.find(key);
+        if (it == index.end()) {
+            numMisses++;
+            return NULL;
+        }
+        numHits++;
+        entries.splice(entries.begin(), entries, it->second);
+        return &it->second->second;
+    }
+
+    /**
+     * Inserts (or replaces) an entry as the most recently used one. If the cache is full, the least recently used
+     * entry is evicted.
+     * @return A reference to the cached value.
+     */
+    Value &insert(const Key &key, const Value &value) {
+        auto it = index.find(key);
+        if (it != index.end()) {
+            entries.erase(it->second);
+            index.erase(it);
+        }
+        entries.push_front(std::make_pair(key, value));
+        index[key] = entries.begin();
+        while (entries.size() > maxSize && entries.size() > 1) {
+            index.erase(entries.back().first);
+            entries.pop_back();
+            numEvictions++;
+        }
+        return entries.front().second;
+    }
+
+    void clear() {
+        entries.clear();
+        index.clear();
+    }
+
+    inline size_t size() const { return entries.size(); }
+    inline size_t getMaxSize() const { return maxSize; }
+    inline uint64_t getNumHits() const { return numHits; }
+    inline uint64_t getNumMisses() const { return numMisses; }
+    inline uint64_t getNumEvictions() const { return numEvictions; }
+
+private:
+    typedef std::list<std::pair<Key, Value>> EntryList;
+    size_t maxSize;
+    EntryList entries; ///< Ordered from most to least recently used
+    std::unordered_map<Key, typename EntryList::iterator> index;
+    uint64_t numHits = 0, numMisses = 0, numEvictions = 0;
+};
+
+#endif //MARCHINGCUBESSERVER_LRUCACHE_HPP
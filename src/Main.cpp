@@ -29,12 +29,17 @@
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <limits>
+#include <map>
+#include <memory>
 #include <websocketpp/config/asio_no_tls.hpp>
 #include <websocketpp/server.hpp>
 #include <json/json.h>
 #include "BinaryStream.hpp"
+#include "BinaryRequest.hpp"
 #include "CindyScriptParser.hpp"
 #include "mc/MarchingCubes.hpp"
+#include "mc/KernelBenchmark.hpp"
 #include "mc/CartesianGrid.hpp"
 
 /**
@@ -53,11 +58,164 @@ using websocketpp::lib::bind;
 
 static MarchingCubesImpl *mcImpl = NULL;
 
+/**
+ * A streamed binary request (see BINARY_REQUEST_FLAG_STREAMED) waiting for further bricks of its grid.
+ */
+struct StreamedRequest {
+    BinaryRequest request;
+    /// One extraction per iso value of the request
+    std::vector<StreamedExtraction> extractions;
+};
+
+/// The streamed requests of the open connections (the server loop runs in one thread, so no lock is needed).
+static std::map<websocketpp::connection_hdl, std::unique_ptr<StreamedRequest>,
+        std::owner_less<websocketpp::connection_hdl>> streamedRequests;
+
+/**
+ * Parses the name of an iso surface extraction engine ("marching-cubes" or "flying-edges").
+ * @param name The name of the engine.
+ * @param engine The parsed engine.
+ * @return False if the name is unknown.
+ */
+bool parseExtractionEngine(const std::string &name, ExtractionEngine &engine) {
+    if (name == "marching-cubes") {
+        engine = ENGINE_MARCHING_CUBES;
+    } else if (name == "flying-edges") {
+        engine = ENGINE_FLYING_EDGES;
+    } else {
+        std::cerr << "Unknown engine: " << name << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Parses the value of a numeric command line argument like "--buffer-pool-mb=<value>".
+ * @param argument The command line argument.
+ * @param prefixLength The length of the option name including the equals sign.
+ * @param maxValue The largest accepted value.
+ * @param value The parsed value.
+ * @return False if the value isn't a non-negative integer of at most maxValue (an error is printed in this case).
+ */
+bool parseUnsignedArgument(const std::string &argument, size_t prefixLength, unsigned long long maxValue,
+        unsigned long long &value) {
+    const std::string text = argument.substr(prefixLength);
+    bool valid = !text.empty() && text.find_first_not_of("0123456789") == std::string::npos;
+    if (valid) {
+        try {
+            value = std::stoull(text);
+            valid = value <= maxValue;
+        } catch (std::out_of_range &exception) {
+            valid = false;
+        }
+    }
+    if (!valid) {
+        std::cerr << "Invalid command line argument: " << argument << std::endl;
+    }
+    return valid;
+}
+
+/**
+ * Parses the number of grid points in one direction of a JSON request.
+ * @param value The JSON value of the size.
+ * @param n The parsed size.
+ * @return False if the value isn't an unsigned integer or not a valid grid size (see isValidGridSize).
+ */
+bool parseJsonGridSize(const Json::Value &value, uint32_t &n) {
+    if (!value.isUInt()) {
+        std::cerr << "Missing or invalid grid size in JSON request." << std::endl;
+        return false;
+    }
+    n = value.asUInt();
+    return isValidGridSize(n);
+}
+
+/**
+ * Sends a mesh to the client (the triangle vertex list for clients not requesting indexed output).
+ * @param s The server.
+ * @param hdl The connection handle.
+ * @param mesh The mesh to send.
+ * @param indexedOutput Whether the client expects an indexed mesh (see writeIndexedMeshResponse).
+ */
+void sendMesh(server* s, websocketpp::connection_hdl hdl, const TriangleMesh &mesh, bool indexedOutput) {
+    try {
+        if (indexedOutput) {
+            BinaryWriteStream writeStream;
+            writeIndexedMeshResponse(writeStream, mesh);
+            s->send(hdl, (void *)writeStream.getBuffer(), writeStream.getSize(), websocketpp::frame::opcode::binary);
+        } else {
+            s->send(hdl, (void *)&mesh.vertices.front(), sizeof(glm::vec3) * mesh.vertices.size(),
+                    websocketpp::frame::opcode::binary);
+        }
+    } catch (websocketpp::exception const & e) {
+        std::cerr << "Send failed: " << "(" << e.what() << ")" << std::endl;
+    }
+}
+
+/**
+ * Extracts the iso surfaces of a brick of a streamed request. After the last brick, the mesh is sent to the client.
+ * @param s The server.
+ * @param hdl The connection handle.
+ * @param msg The received brick message (see BinaryBrickHeader).
+ */
+void onBrickMessage(server* s, websocketpp::connection_hdl hdl, message_ptr msg) {
+    auto it = streamedRequests.find(hdl);
+    if (it == streamedRequests.end()) {
+        std::cerr << "Received a brick without a streamed request." << std::endl;
+        return;
+    }
+    StreamedRequest &streamedRequest = *it->second;
+    BinaryRequest &request = streamedRequest.request;
+
+    // The payload stays alive until the brick is processed, so the stream doesn't need to copy it.
+    BinaryReadStream readStream((const void *)msg->get_payload().data(), msg->get_payload().size(), false);
+    uint32_t zBegin = 0, numLayers = 0;
+    if (!readBinaryBrick(readStream, request, zBegin, numLayers)) {
+        std::cerr << "Invalid brick of streamed request, discarding the request." << std::endl;
+        streamedRequests.erase(it);
+        return;
+    }
+    std::cout << "Received brick [" << zBegin << ", " << (zBegin + numLayers) << ") of streamed request." << std::endl;
+
+    const void *brickGrid = request.explicitGeometry ? (const void*)request.cartesianGrid
+            : (const void*)request.scalarField;
+    for (StreamedExtraction &extraction : streamedRequest.extractions) {
+        if (!mcImpl->extractStreamedBrick(extraction, zBegin, numLayers, brickGrid)) {
+            std::cerr << "Invalid brick of streamed request, discarding the request." << std::endl;
+            streamedRequests.erase(it);
+            return;
+        }
+    }
+    if (!streamedRequest.extractions.front().isFinished()) {
+        return;
+    }
+
+    // The iso surfaces of multiple iso values are sent as one mesh.
+    TriangleMesh mesh(request.indexedOutput);
+    for (StreamedExtraction &extraction : streamedRequest.extractions) {
+        mesh.append(extraction.mesh);
+    }
+    mcImpl->finishRequest();
+    std::cout << "#triangles: " << mesh.getNumTriangles() << ", #vertices: " << mesh.vertices.size() << std::endl;
+    sendMesh(s, hdl, mesh, request.indexedOutput);
+    streamedRequests.erase(it);
+}
+
+/**
+ * This function is called when a connection is closed. Unfinished streamed requests of the connection are discarded.
+ * @param hdl The connection handle.
+ */
+void on_close(websocketpp::connection_hdl hdl) {
+    streamedRequests.erase(hdl);
+}
+
 /**
  * This function is called when the server receives a request.
- * The request consists of a Cartesian grid storing a discrete scalar field.
- * As an answer, the server creates and sends a triangular approximation of the iso surface (at iso level 0) as a list
- * of triangle points.
+ * The request consists of a Cartesian grid storing a discrete scalar field (binary requests, see BinaryRequest.hpp) or
+ * of a CindyScript scalar field function (JSON requests). The grid of streamed binary requests follows in further
+ * messages (see onBrickMessage).
+ * As an answer, the server creates and sends a triangular approximation of the iso surface(s) as a list of triangle
+ * points.
  * @param s The server.
  * @param hdl The connection handle.
  * @param msg The received message.
@@ -68,15 +226,33 @@ void on_message(server* s, websocketpp::connection_hdl hdl, message_ptr msg) {
         std::cerr << "Expected text opcode." << std::endl;
         return;
     }
+    if (msg->get_opcode() == websocketpp::frame::opcode::binary
+            && isBinaryBrick(msg->get_payload().data(), msg->get_payload().size())) {
+        onBrickMessage(s, hdl, msg);
+        return;
+    }
     std::cout << "Received request." << std::endl;
 
-    std::vector<CartesianGridCorner> cartesianGrid;
-    uint32_t nx = 0;
-    float isoValue = 0.0f;
+    // Grids with explicit geometry are only sent by binary clients, all other grids use implicit geometry.
+    // Binary requests reference the grid directly in the received payload.
+    const CartesianGridCorner *cartesianGrid = NULL;
+    const float *scalarField = NULL;
+    std::vector<float> scalarValues;
+    BinaryRequest binaryRequest;
+    CartesianGridGeometry geometry;
+    std::vector<float> isoValues;
+    // Whether the client expects an indexed mesh instead of a triangle soup.
+    bool indexedOutput = false;
+    ExtractionEngine engine = ENGINE_DEFAULT;
+
+    // JSON requests with a compilable scalar field function are sampled directly on the device.
+    bool sampleOnDevice = false;
+    std::shared_ptr<CompiledScalarField> compiledScalarField;
+    std::map<std::string, float> variableMap;
 
     // For more information on the message format, see IsoSurface.js of CindyPrint.
     if (msg->get_opcode() == websocketpp::frame::opcode::text) {
-        std::cout << "Processing JSON request..." << nx << std::endl;
+        std::cout << "Processing JSON request..." << std::endl;
         Json::Value root;
         Json::CharReaderBuilder readerBuilder;
         Json::CharReader *reader = readerBuilder.newCharReader();
@@ -88,45 +264,114 @@ void on_message(server* s, websocketpp::connection_hdl hdl, message_ptr msg) {
         delete reader;
 
         glm::vec3 origin(root["origin"]["x"].asFloat(), root["origin"]["y"].asFloat(), root["origin"]["z"].asFloat());
+        // ny, nz, dy and dz are optional (for cubic grids).
+        uint32_t nx = 0, ny = 0, nz = 0;
+        if (!parseJsonGridSize(root["nx"], nx) || !parseJsonGridSize(root.get("ny", root["nx"]), ny)
+                || !parseJsonGridSize(root.get("nz", root["nx"]), nz)) {
+            std::cerr << "Invalid JSON request." << std::endl;
+            return;
+        }
         float dx = root["dx"].asFloat();
-        nx = root["nx"].asUInt();
-        isoValue = root["isoValue"].asFloat();
+        geometry = CartesianGridGeometry(origin,
+                dx, root.get("dy", dx).asFloat(), root.get("dz", dx).asFloat(), nx, ny, nz);
+        float isoValue = root["isoValue"].asFloat();
+        isoValues.push_back(isoValue);
+        indexedOutput = root.get("indexed", false).asBool();
+        if (root.isMember("engine")) {
+            parseExtractionEngine(root["engine"].asString(), engine);
+        }
         Json::Value scalarFunctionCdy = root["scalarFunction"];
         Json::Value variables = root["variables"];
 
-        cartesianGrid = constructCartesianGridScalarField(
-                origin, dx, nx, scalarFunctionCdy, variables);
+        // The compiled function is reused if a client resends it (e.g. with different variables).
+        compiledScalarField = mcImpl->getScalarFieldCache().lookup(scalarFunctionCdy);
+        mcImpl->getScalarFieldCache().printStatistics();
+        if (compiledScalarField->isValid) {
+            variableMap = parseVariablesCdy(variables);
+            sampleOnDevice = true;
+        } else {
+            // The grid size is only bounded per direction, so the grid may not fit into the host memory.
+            try {
+                scalarValues = constructCartesianGridScalarField(geometry, isoValue, scalarFunctionCdy, variables);
+            } catch (std::exception &exception) { // std::bad_alloc or std::length_error
+                std::cerr << "The grid of the JSON request doesn't fit into memory (" << exception.what() << ")."
+                        << std::endl;
+                return;
+            }
+            scalarField = scalarValues.empty() ? NULL : &scalarValues.front();
+        }
     }
 
     if (msg->get_opcode() == websocketpp::frame::opcode::binary) {
-        std::cout << "Processing binary request..." << nx << std::endl;
-        BinaryReadStream readStream((const void *)msg->get_payload().data(), msg->get_payload().size());
-
-        // Read number of cells in x, y and z direction (for now uniform).
-        readStream.read(nx);
-
-        // Allocate memory for cartesian grid and read the data.
-        cartesianGrid.resize(nx*nx*nx);
-        readStream.read((void*)&cartesianGrid.front(), sizeof(CartesianGridCorner)*nx*nx*nx);
+        std::cout << "Processing binary request..." << std::endl;
+        // The payload stays alive until the request is processed, so the stream doesn't need to copy it.
+        BinaryReadStream readStream((const void *)msg->get_payload().data(), msg->get_payload().size(), false);
+        if (!readBinaryRequest(readStream, binaryRequest)) {
+            std::cerr << "Invalid binary request." << std::endl;
+            return;
+        }
+        if (binaryRequest.streamed) {
+            // Streamed grids are extracted brick by brick on the device (see marchingCubesBricked).
+            if (mcImpl->getBackend() != BACKEND_OPENCL || binaryRequest.flyingEdges) {
+                std::cerr << "Streamed requests need the OpenCL backend and marching cubes." << std::endl;
+                return;
+            }
+            std::unique_ptr<StreamedRequest> streamedRequest(new StreamedRequest);
+            for (float isoValue : binaryRequest.isoValues) {
+                streamedRequest->extractions.push_back(StreamedExtraction(
+                        binaryRequest.geometry, isoValue, !binaryRequest.explicitGeometry,
+                        binaryRequest.indexedOutput));
+            }
+            streamedRequest->request.geometry = binaryRequest.geometry;
+            streamedRequest->request.isoValues = binaryRequest.isoValues;
+            streamedRequest->request.indexedOutput = binaryRequest.indexedOutput;
+            streamedRequest->request.streamed = true;
+            streamedRequest->request.explicitGeometry = binaryRequest.explicitGeometry;
+            streamedRequest->request.dataType = binaryRequest.dataType;
+            // A new streamed request replaces an unfinished one of the same connection.
+            streamedRequests[hdl] = std::move(streamedRequest);
+            const CartesianGridGeometry &gridGeometry = binaryRequest.geometry;
+            std::cout << "Grid size: " << gridGeometry.nx << "x" << gridGeometry.ny << "x" << gridGeometry.nz
+                    << ", waiting for bricks..." << std::endl;
+            return;
+        }
+        geometry = binaryRequest.geometry;
+        isoValues = binaryRequest.isoValues;
+        cartesianGrid = binaryRequest.cartesianGrid;
+        scalarField = binaryRequest.scalarField;
+        indexedOutput = binaryRequest.indexedOutput;
+        if (binaryRequest.flyingEdges) {
+            engine = ENGINE_FLYING_EDGES;
+        }
     }
 
-    std::cout << "nx: " << nx << std::endl;
+    std::cout << "Grid size: " << geometry.nx << "x" << geometry.ny << "x" << geometry.nz << std::endl;
 
     // Launch the marching cubes algorithm for creating the iso surface and measure the time it took.
     auto startLoad = std::chrono::system_clock::now();
-    std::vector<glm::vec3> trianglePoints = mcImpl->marchingCubes(nx, isoValue, cartesianGrid);
+    // The iso surfaces of multiple iso values are sent as one mesh.
+    TriangleMesh mesh(indexedOutput);
+    for (float isoValue : isoValues) {
+        TriangleMesh isoSurface(indexedOutput);
+        if (sampleOnDevice) {
+            isoSurface = mcImpl->marchingCubesScalarField(
+                    geometry, isoValue, *compiledScalarField, variableMap, indexedOutput, engine);
+        } else if (scalarField) {
+            isoSurface = mcImpl->marchingCubesImplicit(geometry, isoValue, scalarField, indexedOutput, engine);
+        } else if (cartesianGrid) {
+            isoSurface = mcImpl->marchingCubes(
+                    geometry.nx, geometry.ny, geometry.nz, isoValue, cartesianGrid, indexedOutput, engine);
+        }
+        mesh.append(isoSurface);
+    }
+    mcImpl->finishRequest();
     auto endLoad = std::chrono::system_clock::now();
     auto elapsedLoad = std::chrono::duration_cast<std::chrono::milliseconds>(endLoad - startLoad);
     std::cout << "Marching cubes finished in: " << std::to_string(elapsedLoad.count()/1000.0f) << "s" << std::endl;
-    std::cout << "#triangle points: " << trianglePoints.size() << std::endl;
+    std::cout << "#triangles: " << mesh.getNumTriangles() << ", #vertices: " << mesh.vertices.size() << std::endl;
 
-    // Finally, send the triangle vertex list to the client.
-    try {
-        s->send(hdl, (void *)&trianglePoints.front(), sizeof(glm::vec3) * trianglePoints.size(),
-                websocketpp::frame::opcode::binary);
-    } catch (websocketpp::exception const & e) {
-        std::cerr << "Send failed: " << "(" << e.what() << ")" << std::endl;
-    }
+    // Finally, send the mesh to the client.
+    sendMesh(s, hdl, mesh, indexedOutput);
 }
 
 /**
@@ -139,6 +384,8 @@ void listenForClose() {
         std::getline(std::cin, command);
         if (command == "quit" || command == "exit") {
             running = false;
+        } else if (command == "autotune") {
+            mcImpl->autotune();
         } else {
             std::cerr << "Unknown command!" << std::endl;
         }
@@ -159,7 +406,78 @@ int main(int argc, char *argv[]) {
     std::cout << "Please type 'quit' for closing the server..." << std::endl;
 
     mcImpl = new MarchingCubesImpl;
+    bool runBenchmark = false;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--traversal=auto") {
+            mcImpl->setActiveCellTraversal(TRAVERSAL_AUTO);
+        } else if (argument == "--traversal=prefix-sum") {
+            mcImpl->setActiveCellTraversal(TRAVERSAL_PREFIX_SUM);
+        } else if (argument == "--traversal=histopyramid") {
+            mcImpl->setActiveCellTraversal(TRAVERSAL_HISTOPYRAMID);
+        } else if (argument == "--backend=auto") {
+            mcImpl->setBackend(BACKEND_AUTO);
+        } else if (argument == "--backend=opencl") {
+            mcImpl->setBackend(BACKEND_OPENCL);
+        } else if (argument == "--backend=cpu") {
+            mcImpl->setBackend(BACKEND_CPU);
+        } else if (argument.find("--buffer-pool-mb=") == 0) {
+            unsigned long long megabytes;
+            if (parseUnsignedArgument(argument, 17, std::numeric_limits<size_t>::max() / (1024 * 1024), megabytes)) {
+                mcImpl->setBufferPoolLimit(size_t(megabytes) * 1024 * 1024);
+            }
+        } else if (argument.find("--memory-budget-mb=") == 0) {
+            unsigned long long megabytes;
+            if (parseUnsignedArgument(argument, 19, std::numeric_limits<size_t>::max() / (1024 * 1024), megabytes)) {
+                mcImpl->setMemoryBudget(size_t(megabytes) * 1024 * 1024);
+            }
+        } else if (argument == "--devices=all") {
+            mcImpl->setUseAllDevices(true);
+        } else if (argument == "--devices=first") {
+            mcImpl->setUseAllDevices(false);
+        } else if (argument.find("--program-cache=") == 0) {
+            mcImpl->setProgramCacheDirectory(argument.substr(16));
+        } else if (argument.find("--specialize-after=") == 0) {
+            unsigned long long minRequests;
+            if (parseUnsignedArgument(argument, 19, std::numeric_limits<uint32_t>::max(), minRequests)) {
+                mcImpl->setKernelSpecialization(uint32_t(minRequests));
+            }
+        } else if (argument == "--autotune" || argument == "--autotune=startup") {
+            mcImpl->setWorkGroupAutotuning(AUTOTUNE_STARTUP);
+        } else if (argument == "--autotune=force") {
+            mcImpl->setWorkGroupAutotuning(AUTOTUNE_FORCE);
+        } else if (argument == "--autotune=cached") {
+            mcImpl->setWorkGroupAutotuning(AUTOTUNE_CACHED);
+        } else if (argument == "--autotune=off") {
+            mcImpl->setWorkGroupAutotuning(AUTOTUNE_OFF);
+        } else if (argument == "--tiling=auto") {
+            mcImpl->setGridTiling(TILING_AUTO);
+        } else if (argument == "--tiling=on") {
+            mcImpl->setGridTiling(TILING_ON);
+        } else if (argument == "--tiling=off") {
+            mcImpl->setGridTiling(TILING_OFF);
+        } else if (argument == "--benchmark") {
+            runBenchmark = true;
+        } else if (argument.find("--engine=") == 0) {
+            ExtractionEngine engine;
+            if (parseExtractionEngine(argument.substr(9), engine)) {
+                mcImpl->setDefaultEngine(engine);
+            }
+        } else {
+            std::cerr << "Unknown command line argument: " << argument << std::endl;
+        }
+    }
     mcImpl->init();
+    if (runBenchmark) {
+        if (mcImpl->getBackend() == BACKEND_OPENCL) {
+            runKernelSpecializationBenchmark(*mcImpl);
+        } else {
+            std::cerr << "The benchmark needs the OpenCL backend." << std::endl;
+        }
+        mcImpl->quit();
+        delete mcImpl;
+        return 0;
+    }
 
     try {
         // Set logging settings
@@ -171,6 +489,7 @@ int main(int argc, char *argv[]) {
 
         // Register the message handler
         mcServer.set_message_handler(bind(&on_message, &mcServer, ::_1, ::_2));
+        mcServer.set_close_handler(bind(&on_close, ::_1));
 
         // Listen on port 17279
         mcServer.listen(17279);
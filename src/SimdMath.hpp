@@ -0,0 +1,156 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MARCHINGCUBESSERVER_SIMDMATH_HPP
+#define MARCHINGCUBESSERVER_SIMDMATH_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+/*
+ * Branch-free single precision approximations of the elementary functions used by CindyScript expressions.
+ * The functions only use arithmetic, comparisons, selects and integer/float conversions, such that the compiler can
+ * vectorize loops calling them (e.g. with "#pragma omp simd") using SSE, AVX2 or AVX-512 instructions.
+ * The polynomials are taken from the Cephes math library (http://www.netlib.org/cephes/).
+ */
+
+/// Inputs with an absolute value above this threshold lose precision in the range reduction of sinSimd/cosSimd.
+const float SIMD_TRIG_MAX_ARGUMENT = 8192.0f;
+
+inline float floatFromBits(uint32_t bits) {
+    float f;
+    std::memcpy(&f, &bits, sizeof(float));
+    return f;
+}
+
+inline uint32_t bitsFromFloat(float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(float));
+    return bits;
+}
+
+/**
+ * Evaluates either the sine or the cosine polynomial on the reduced argument.
+ * @param x The absolute value of the argument.
+ * @param quadrantOffset 0 for the sine, 2 for the cosine.
+ * @param sign The sign to apply to the result.
+ */
+inline float sinCosSimd(float x, int quadrantOffset, float sign) {
+    const float FOPI = 1.27323954473516f; // 4 / pi
+    const float DP1 = 0.78515625f;
+    const float DP2 = 2.4187564849853515625e-4f;
+    const float DP3 = 3.77489497744594108e-8f;
+
+    int j = int(x * FOPI);
+    j = (j + 1) & ~1;
+    float y = float(j);
+    j -= quadrantOffset;
+    x = ((x - y * DP1) - y * DP2) - y * DP3;
+
+    float z = x * x;
+    float polyCos = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z
+            - 0.5f * z + 1.0f;
+    float polySin = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * x + x;
+    float result = (j & 2) == 0 ? polySin : polyCos;
+    return (j & 4) == 0 ? sign * result : -sign * result;
+}
+
+inline float sinSimd(float x) {
+    return sinCosSimd(std::fabs(x), 0, x < 0.0f ? -1.0f : 1.0f);
+}
+
+inline float cosSimd(float x) {
+    // The cosine flips the sign in the quadrants where the sine doesn't.
+    return -sinCosSimd(std::fabs(x), 2, 1.0f);
+}
+
+/// Natural logarithm for x > 0 (finite).
+inline float logSimd(float x) {
+    const float SQRTHF = 0.707106781186547524f;
+
+    // Split x into a mantissa m in [0.5, 1) and an exponent e.
+    uint32_t bits = bitsFromFloat(x);
+    float e = float(int((bits >> 23) & 0xffu) - 126);
+    float m = floatFromBits((bits & 0x807fffffu) | 0x3f000000u);
+
+    bool small = m < SQRTHF;
+    e = small ? e - 1.0f : e;
+    m = small ? m + m - 1.0f : m - 1.0f;
+
+    float z = m * m;
+    float y = ((((((((7.0376836292e-2f * m - 1.1514610310e-1f) * m + 1.1676998740e-1f) * m - 1.2420140846e-1f) * m
+            + 1.4249322787e-1f) * m - 1.6668057665e-1f) * m + 2.0000714765e-1f) * m - 2.4999993993e-1f) * m
+            + 3.3333331174e-1f) * m * z;
+    y += -2.12194440e-4f * e;
+    y += -0.5f * z;
+    return m + y + 0.693359375f * e;
+}
+
+inline float expSimd(float x) {
+    const float LOG2E = 1.44269504088896341f;
+    const float EXP_HI = 88.7228391116729996f; // log(FLT_MAX)
+    const float EXP_LO = -87.3365447504f;
+
+    float xc = x > EXP_HI ? EXP_HI : (x < EXP_LO ? EXP_LO : x);
+    float fx = std::floor(xc * LOG2E + 0.5f);
+    xc -= fx * 0.693359375f;
+    xc -= fx * -2.12194440e-4f;
+
+    float z = xc * xc;
+    float y = (((((1.9875691500e-4f * xc + 1.3981999507e-3f) * xc + 8.3334519073e-3f) * xc + 4.1665795894e-2f) * xc
+            + 1.6666665459e-1f) * xc + 5.0000001201e-1f) * z + xc + 1.0f;
+
+    // Multiply by 2^fx by constructing the exponent bits directly (split in two factors, as fx may be 128).
+    y = y * floatFromBits(uint32_t(int(fx) + 126) << 23) * 2.0f;
+    y = x > EXP_HI ? INFINITY : y;
+    return x < EXP_LO ? 0.0f : y;
+}
+
+/**
+ * Computes x^y. The special cases x == 0 and non-finite arguments are not handled and need to be filtered out using
+ * powSimdIsSpecialCase.
+ */
+inline float powSimd(float x, float y) {
+    float result = expSimd(y * logSimd(std::fabs(x)));
+
+    // Negative bases are only defined for integer exponents. Floats with |y| >= 2^24 are always even integers.
+    bool exactInt = std::fabs(y) < 16777216.0f;
+    int yInt = exactInt ? int(y) : 0;
+    bool isInteger = !exactInt || float(yInt) == y;
+    bool isOdd = (yInt & 1) != 0;
+    result = x < 0.0f && isOdd ? -result : result;
+    result = x < 0.0f && !isInteger ? NAN : result;
+    return y == 0.0f ? 1.0f : result;
+}
+
+inline bool powSimdIsSpecialCase(float x, float y) {
+    return x == 0.0f || !std::isfinite(x) || !std::isfinite(y);
+}
+
+#endif //MARCHINGCUBESSERVER_SIMDMATH_HPP
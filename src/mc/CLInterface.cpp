@@ -29,27 +29,36 @@
 #include <iostream>
 #include <cassert>
 #include <fstream>
+#include <cstring>
 #include "CLInterface.hpp"
 
 CLInterface::~CLInterface()
 {
 }
 
-void CLInterface::initialize(CLContextInfo contextInfo)
+bool CLInterface::initialize(CLContextInfo contextInfo)
 {
-	// 1. Get right OpenCL platform
-    cl::Platform::get(&allPlatforms);
+	// 1. Get right OpenCL platform (an error is raised if no ICD is installed)
+	try {
+		cl::Platform::get(&allPlatforms);
+	} catch (cl::Error &error) {
+		allPlatforms.clear();
+	}
     if (allPlatforms.size() <= contextInfo.platformNum) {
-        std::cerr << "Fatal Error: No OpenCL platform with specified ID found!" << std::endl;
-    	exit(1);
+        std::cerr << "Error: No OpenCL platform with specified ID found!" << std::endl;
+    	return false;
     }
     platform = allPlatforms.at(contextInfo.platformNum);
 
 	// 2. Get right OpenCL device(s)
-	platform.getDevices(CL_DEVICE_TYPE_ALL, &allDevices);
+	try {
+		platform.getDevices(CL_DEVICE_TYPE_ALL, &allDevices);
+	} catch (cl::Error &error) {
+		allDevices.clear();
+	}
 	if(allDevices.size() == 0){
         std::cout << "No OpenCL devices found. Please check your installation!" << std::endl;
-		exit(1);
+		return false;
 	}
 	if (contextInfo.useAllDevices) {
 		devices = allDevices;
@@ -60,6 +69,7 @@ void CLInterface::initialize(CLContextInfo contextInfo)
 
 	// 3. Create OpenCL context
 	context = cl::Context(devices);
+	return true;
 }
 
 void CLInterface::printInfo()
@@ -92,25 +102,32 @@ cl::Program CLInterface::loadProgramFromSourceFile(const char *filename)
 	return loadProgramFromSourceFiles({filename});
 }
 
+/**
+ * Returns the options for compiling the source files of the compute programs on the passed platform.
+ */
+std::string getCompileArgs(cl::Platform platform) {
+	if (strcmp(platform.getInfo<CL_PLATFORM_NAME>().c_str(), "AMD Accelerated Parallel Processing") == 0) {
+		// Odd bug on AMD APP SDK with "-Werror"
+		return "";
+	}
+	return "-Werror";
+}
+
 /**
  * Compiles a source file and returns a cl::Program object.
- * @param filename: The filename of the source file
+ * @param filename: The filename of the source file (used for error messages)
+ * @param kernelCode: The content of the source file
+ * @param compileArgs: The compiler options
  * @param context: The OpenCL context
  * @param devices: The devices that shall be used for compiling the program
  */
-cl::Program compileSourceFile(const std::string &filename, cl::Context context, cl::Platform platform,
-        std::vector<cl::Device> devices) {
+cl::Program compileSourceFile(const std::string &filename, const std::string &kernelCode,
+        const std::string &compileArgs, cl::Context context, std::vector<cl::Device> devices) {
 	std::cout << "Compiling " << filename << "..." << std::endl;
 
 	cl::Program::Sources sources;
-	std::string kernelCode = loadTextFile(filename.c_str());
 	sources.push_back({kernelCode.c_str(), kernelCode.length()});
 	cl::Program program(context, sources);
-	std::string compileArgs = "-Werror";
-	if (strcmp(platform.getInfo<CL_PLATFORM_NAME>().c_str(), "AMD Accelerated Parallel Processing") == 0) {
-		// Odd bug on AMD APP SDK with "-Werror"
-		compileArgs = "";
-	}
 	if (program.compile(compileArgs.c_str()) != CL_SUCCESS) {
         std::cerr << "Error while building " << filename << ":" << std::endl
                 << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(devices[0]) << std::endl;
@@ -119,15 +136,68 @@ cl::Program compileSourceFile(const std::string &filename, cl::Context context,
 	return program;
 }
 
-cl::Program CLInterface::loadProgramFromSourceFiles(const std::vector<std::string> &filenames)
+/**
+ * Returns the slot of a program in the binary cache for the passed device (see ProgramBinaryCache).
+ */
+std::string getBinaryCacheSlot(cl::Platform platform, cl::Device device, const std::string &compileArgs,
+        const std::vector<std::string> &filenames) {
+	std::string slot = platform.getInfo<CL_PLATFORM_NAME>() + "\n" + platform.getInfo<CL_PLATFORM_VERSION>() + "\n"
+	        + device.getInfo<CL_DEVICE_NAME>() + "\n" + device.getInfo<CL_DRIVER_VERSION>() + "\n" + compileArgs;
+	for (const std::string& filename : filenames) {
+		slot += "\n" + filename;
+	}
+	return slot;
+}
+
+cl::Program CLInterface::loadProgramFromSourceFiles(const std::vector<std::string> &filenames,
+        const std::string &buildOptions)
 {
-	// 4. Load and compile OpenCL C source files
-	std::vector<cl::Program> programs;
+	// 4. Load the OpenCL C source files
+	std::vector<std::string> kernelCodes;
+	std::string allKernelCode;
 	for (const std::string& filename : filenames) {
-		programs.push_back(compileSourceFile(filename, context, platform, devices));
+		kernelCodes.push_back(loadTextFile(filename.c_str()));
+		allKernelCode += kernelCodes.back();
+	}
+	std::string compileArgs = getCompileArgs(platform);
+	if (!buildOptions.empty()) {
+		compileArgs += (compileArgs.empty() ? "" : " ") + buildOptions;
+	}
+
+	// The binaries of the program for all devices are used if they are cached and still valid.
+	std::vector<std::string> cacheSlots, cacheKeys;
+	if (binaryCache.isEnabled()) {
+		std::string sourceHash = ProgramBinaryCache::hash(allKernelCode);
+		for (cl::Device &device : devices) {
+			cacheSlots.push_back(getBinaryCacheSlot(platform, device, compileArgs, filenames));
+			cacheKeys.push_back(cacheSlots.back() + "\n" + sourceHash);
+		}
+		cl::Program::Binaries binaries(devices.size());
+		for (size_t i = 0; i < devices.size(); i++) {
+			if (!binaryCache.load(cacheSlots.at(i), cacheKeys.at(i), binaries.at(i))) {
+				binaries.clear();
+				break;
+			}
+		}
+		if (!binaries.empty()) {
+			try {
+				cl::Program program(context, devices, binaries);
+				program.build(devices);
+				std::cout << "Loaded the compute program from the binary cache." << std::endl;
+				return program;
+			} catch (cl::Error &error) {
+				std::cerr << "Warning: Couldn't load the cached program binaries. Rebuilding them." << std::endl;
+			}
+		}
+	}
+
+	// 5. Compile the source files
+	std::vector<cl::Program> programs;
+	for (size_t i = 0; i < filenames.size(); i++) {
+		programs.push_back(compileSourceFile(filenames.at(i), kernelCodes.at(i), compileArgs, context, devices));
 	}
 
-	// 5. Link all source files together into one executable
+	// 6. Link all source files together into one executable
 	cl_int err = CL_SUCCESS;
 	cl::Program linkedProgram = cl::linkProgram(programs, NULL, NULL, NULL, &err);
 	if (err != CL_SUCCESS) {
@@ -135,9 +205,35 @@ cl::Program CLInterface::loadProgramFromSourceFiles(const std::vector<std::strin
 		        << linkedProgram.getBuildInfo<CL_PROGRAM_BUILD_LOG>(devices[0]) << std::endl;
 		exit(1);
 	}
+
+	if (binaryCache.isEnabled()) {
+		// The binaries are ordered like the devices of the program, which are the devices of the context.
+		std::vector<cl::Device> programDevices = linkedProgram.getInfo<CL_PROGRAM_DEVICES>();
+		cl::Program::Binaries binaries = linkedProgram.getInfo<CL_PROGRAM_BINARIES>();
+		for (size_t i = 0; i < programDevices.size() && i < binaries.size(); i++) {
+			for (size_t j = 0; j < devices.size(); j++) {
+				if (devices.at(j)() == programDevices.at(i)()) {
+					binaryCache.store(cacheSlots.at(j), cacheKeys.at(j), binaries.at(i));
+				}
+			}
+		}
+	}
 	return linkedProgram;
 }
 
+cl::Program CLInterface::loadProgramFromSourceString(const std::string &source, const std::string &buildOptions)
+{
+	cl::Program program(context, source);
+	try {
+		program.build(devices, buildOptions.c_str());
+	} catch (cl::Error &error) {
+		std::cerr << "Error while building generated program:" << std::endl
+		        << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(devices[0]) << std::endl;
+		throw;
+	}
+	return program;
+}
+
 cl::Program CLInterface::loadProgramFromBinaryFile(const char *filename)
 {
 	cl::Program::Binaries binaries;
@@ -37,6 +37,7 @@
 #include <string>
 #include "CL/cl2.hpp"
 #include "Singleton.hpp"
+#include "ProgramBinaryCache.hpp"
 
 /// Represents information on OpenCL context creation
 struct CLContextInfo {
@@ -62,13 +63,20 @@ public:
     virtual ~CLInterface();
 
     /// Initializes an OpenCL context for the default platform & default device
-	void initialize(CLContextInfo contextInfo = CLContextInfo());
+    /// @return False if no OpenCL platform or device is available.
+	bool initialize(CLContextInfo contextInfo = CLContextInfo());
     /// Prints information about the installed OpenCL platform/devices on the command line
 	void printInfo();
 
     /// Loads and compiles a compute program from OpenCL C source files
 	cl::Program loadProgramFromSourceFile(const char *filename);
-	cl::Program loadProgramFromSourceFiles(const std::vector<std::string> &filenames);
+    /// Links multiple source files. The build options (e.g. "-D NAME=VALUE") are added to the default options.
+	cl::Program loadProgramFromSourceFiles(const std::vector<std::string> &filenames,
+	        const std::string &buildOptions = "");
+    /// Directory of the binaries of programs loaded from source files (see ProgramBinaryCache, empty to disable)
+    inline void setBinaryCacheDirectory(const std::string &directory) { binaryCache.setDirectory(directory); }
+    /// Builds a compute program from OpenCL C source code generated at runtime (throws cl::Error on failure)
+	cl::Program loadProgramFromSourceString(const std::string &source, const std::string &buildOptions = "");
     /// Loads a compute program from a pre-compiled OpenCL C binary file (device specific!)
 	cl::Program loadProgramFromBinaryFile(const char *filename);
 
@@ -89,6 +97,7 @@ private:
     cl::Platform platform; ///< Used platform
 	std::vector<cl::Device> devices; ///< Used devices
     cl::Context context;
+    ProgramBinaryCache binaryCache;
 };
 
 
@@ -2,35 +2,215 @@
 // Created by christoph on 26.05.19.
 //
 
+#include <iostream>
+#include <algorithm>
+#include <cmath>
 #include "../CindyScriptParser.hpp"
+#include "../CindyScriptCompiler.hpp"
+#include "../CindyScriptOptimizer.hpp"
+#include "../CindyScriptInterval.hpp"
 #include "CartesianGrid.hpp"
 
-std::vector<CartesianGridCorner> constructCartesianGridScalarField(const glm::vec3 &origin, float dx, uint32_t nx,
-        Json::Value &scalarFunctionCdy, Json::Value &variables) {
-    std::vector<CartesianGridCorner> cartesianGrid;
-    cartesianGrid.resize(nx*nx*nx);
-    std::map<std::string, float> variableMapGlobal;
+bool isValidGridSize(uint32_t n) {
+    if (n < 2 || n > MAX_GRID_SIZE) {
+        std::cerr << "Invalid grid size " << n << " in request." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::map<std::string, float> parseVariablesCdy(Json::Value &variables) {
+    std::map<std::string, float> variableMap;
     for (auto it = variables.begin(); it != variables.end(); it++) {
-        variableMapGlobal[it.key().asString()] = it->asFloat();
+        variableMap[it.key().asString()] = it->asFloat();
     }
+    return variableMap;
+}
 
-    // 1D scalar values at the grid points
+bool compileScalarFieldCdy(Json::Value &scalarFunctionCdy, CdyProgram &program) {
+    // The register slots 0, 1 and 2 are guaranteed to store x, y and z.
+    return compileExpressionCdy(scalarFunctionCdy["body"], {"x", "y", "z"}, program);
+}
+
+std::vector<float> constructCartesianGridScalarField(const CartesianGridGeometry &geometry, float isoValue,
+        Json::Value &scalarFunctionCdy, Json::Value &variables) {
+    std::map<std::string, float> variableMapGlobal = parseVariablesCdy(variables);
+
+    // Compile the function once instead of walking the source tree for every grid point.
+    CdyProgram program;
+    if (compileScalarFieldCdy(scalarFunctionCdy, program)) {
+        return constructCartesianGridScalarField(geometry, isoValue, program, variableMapGlobal);
+    }
+
+    std::cerr << "Falling back to the source tree evaluator." << std::endl;
+    const uint32_t nx = geometry.nx, ny = geometry.ny, nz = geometry.nz;
+    std::vector<float> scalarField;
+    scalarField.resize(geometry.getNumPoints());
     #pragma omp parallel for
-    for (uint32_t i = 0; i < nx; i++) {
-        for (uint32_t j = 0; j < nx; j++) {
+    for (uint32_t i = 0; i < nz; i++) {
+        for (uint32_t j = 0; j < ny; j++) {
             for (uint32_t k = 0; k < nx; k++) {
                 std::map<std::string, float> variableMap = variableMapGlobal;
-                CartesianGridCorner &gridCorner = cartesianGrid.at(i*nx*nx + j*nx + k);
-                gridCorner.v.x = origin.x + k*dx;
-                gridCorner.v.y = origin.y + j*dx;
-                gridCorner.v.z = origin.z + i*dx;
-                variableMap["x"] = gridCorner.v.x;
-                variableMap["y"] = gridCorner.v.y;
-                variableMap["z"] = gridCorner.v.z;
-                gridCorner.f = evaluateExpressionCdy(scalarFunctionCdy["body"], variableMap);
+                glm::vec3 position = geometry.getPosition(k, j, i);
+                variableMap["x"] = position.x;
+                variableMap["y"] = position.y;
+                variableMap["z"] = position.z;
+                scalarField.at(size_t(i)*nx*ny + j*nx + k) = evaluateExpressionCdy(
+                        scalarFunctionCdy["body"], variableMap);
+            }
+        }
+    }
+    return scalarField;
+}
+
+/// The first culling block containing the grid point with index p (in one dimension).
+static inline uint32_t firstBlockContaining(uint32_t p) {
+    return p > 0 ? (p - 1) / CDY_CULLING_BLOCK_SIZE : 0;
+}
+
+/// The last culling block containing the grid point with index p (in one dimension).
+static inline uint32_t lastBlockContaining(uint32_t p, uint32_t numBlocks) {
+    return std::min(p / CDY_CULLING_BLOCK_SIZE, numBlocks - 1);
+}
+
+std::vector<float> computeCulledBlocks(const CartesianGridGeometry &geometry, float isoValue,
+        const CdyProgram &program, const std::map<std::string, float> &variables, glm::uvec3 &numBlocks) {
+    for (int dim = 0; dim < 3; dim++) {
+        uint32_t n = geometry.getSize(dim);
+        numBlocks[dim] = n >= 2 ? (n - 2) / CDY_CULLING_BLOCK_SIZE + 1 : 0;
+    }
+    std::vector<float> blockValues(size_t(numBlocks.x)*numBlocks.y*numBlocks.z);
+    size_t numCulledBlocks = 0;
+
+    #pragma omp parallel reduction(+:numCulledBlocks)
+    {
+        std::vector<CdyInterval> initialRegisters;
+        initializeIntervalRegistersCdy(program, initialRegisters, variables);
+        std::vector<CdyInterval> registers;
+
+        #pragma omp for
+        for (uint32_t bz = 0; bz < numBlocks.z; bz++) {
+            for (uint32_t by = 0; by < numBlocks.y; by++) {
+                for (uint32_t bx = 0; bx < numBlocks.x; bx++) {
+                    registers = initialRegisters;
+                    uint32_t blockIndices[3] = { bx, by, bz };
+                    for (int dim = 0; dim < 3; dim++) {
+                        uint32_t start = blockIndices[dim] * CDY_CULLING_BLOCK_SIZE;
+                        uint32_t end = std::min(start + CDY_CULLING_BLOCK_SIZE, geometry.getSize(dim) - 1);
+                        // The same expressions as in the sampling code (as floating point errors may matter).
+                        float lower = geometry.origin[dim] + start*geometry.getSpacing(dim);
+                        float upper = geometry.origin[dim] + end*geometry.getSpacing(dim);
+                        registers.at(dim) = CdyInterval(std::min(lower, upper), std::max(lower, upper));
+                    }
+
+                    CdyInterval interval = evaluateIntervalCdy(program, &registers.front());
+                    float &blockValue = blockValues[(size_t(bz)*numBlocks.y + by)*numBlocks.x + bx];
+                    if (interval.excludes(isoValue)) {
+                        // The closest float on the side of the iso value all function values in the block are on.
+                        blockValue = isoValue < interval.lower ? std::nextafter(isoValue, INFINITY)
+                                : std::nextafter(isoValue, -INFINITY);
+                        numCulledBlocks++;
+                    } else {
+                        blockValue = NAN;
+                    }
+                }
+            }
+        }
+    }
+
+    std::cout << "Culled " << numCulledBlocks << " of " << blockValues.size() << " blocks." << std::endl;
+    if (numCulledBlocks == 0) {
+        blockValues.clear();
+    }
+    return blockValues;
+}
+
+std::vector<float> constructCartesianGridScalarField(const CartesianGridGeometry &geometry, float isoValue,
+        const CdyProgram &programGeneric, const std::map<std::string, float> &variableMapGlobal) {
+    const uint32_t nx = geometry.nx, ny = geometry.ny, nz = geometry.nz;
+    std::vector<float> scalarField;
+    scalarField.resize(geometry.getNumPoints());
+
+    // Substitute the free variables and fold all parts of the function that don't depend on the position.
+    CdyProgram program = programGeneric;
+    optimizeProgramCdy(program, &variableMapGlobal);
+
+    // Only the grid points belonging to at least one block that may contain the iso surface are sampled.
+    glm::uvec3 numBlocks(0);
+    std::vector<float> blockValues = computeCulledBlocks(geometry, isoValue, program, variableMapGlobal, numBlocks);
+    const bool useCulling = !blockValues.empty();
+
+    // 1D scalar values at the grid points. The grid points to sample in a row in x direction are evaluated in SIMD
+    // batches.
+    #pragma omp parallel
+    {
+        std::vector<float> initialRegisters;
+        program.initializeBatchRegisters(initialRegisters, variableMapGlobal);
+        std::vector<float> registers = initialRegisters;
+        float *registersX = &registers.front();
+        float *registersY = registersX + CDY_BATCH_SIZE;
+        float *registersZ = registersY + CDY_BATCH_SIZE;
+        const size_t numVariableLanes = program.getNumVariables() * CDY_BATCH_SIZE;
+        std::vector<bool> rowBlockSampled(numBlocks.x);
+        std::vector<uint32_t> sampledPoints;
+        sampledPoints.reserve(nx);
+
+        #pragma omp for
+        for (uint32_t i = 0; i < nz; i++) {
+            for (uint32_t j = 0; j < ny; j++) {
+                sampledPoints.clear();
+                float *row = &scalarField[size_t(i)*nx*ny + j*nx];
+
+                if (useCulling) {
+                    // A block in the row needs to be sampled if one of the up to four blocks containing the row does.
+                    uint32_t bzStart = firstBlockContaining(i), bzEnd = lastBlockContaining(i, numBlocks.z);
+                    uint32_t byStart = firstBlockContaining(j), byEnd = lastBlockContaining(j, numBlocks.y);
+                    for (uint32_t bx = 0; bx < numBlocks.x; bx++) {
+                        bool sampled = false;
+                        for (uint32_t bz = bzStart; bz <= bzEnd; bz++) {
+                            for (uint32_t by = byStart; by <= byEnd; by++) {
+                                size_t blockIndex = (size_t(bz)*numBlocks.y + by)*numBlocks.x + bx;
+                                sampled = sampled || std::isnan(blockValues[blockIndex]);
+                            }
+                        }
+                        rowBlockSampled[bx] = sampled;
+                    }
+                    for (uint32_t k = 0; k < nx; k++) {
+                        uint32_t bxStart = firstBlockContaining(k), bxEnd = lastBlockContaining(k, numBlocks.x);
+                        if (rowBlockSampled[bxStart] || rowBlockSampled[bxEnd]) {
+                            sampledPoints.push_back(k);
+                        } else {
+                            row[k] = blockValues[(size_t(bzStart)*numBlocks.y + byStart)*numBlocks.x + bxStart];
+                        }
+                    }
+                } else {
+                    for (uint32_t k = 0; k < nx; k++) {
+                        sampledPoints.push_back(k);
+                    }
+                }
+
+                for (size_t batchStart = 0; batchStart < sampledPoints.size(); batchStart += CDY_BATCH_SIZE) {
+                    if (program.assignsVariables) {
+                        std::copy(initialRegisters.begin(), initialRegisters.begin() + numVariableLanes,
+                                registers.begin());
+                    }
+                    size_t batchEnd = std::min(batchStart + CDY_BATCH_SIZE, sampledPoints.size());
+                    for (uint32_t l = 0; l < CDY_BATCH_SIZE; l++) {
+                        // Unused lanes of the last batch repeat the last point.
+                        glm::vec3 position = geometry.getPosition(
+                                sampledPoints[std::min(batchStart + l, batchEnd - 1)], j, i);
+                        registersX[l] = position.x;
+                        registersY[l] = position.y;
+                        registersZ[l] = position.z;
+                    }
+                    const float *values = program.evaluateBatch(registersX);
+                    for (size_t l = batchStart; l < batchEnd; l++) {
+                        row[sampledPoints[l]] = values[l - batchStart];
+                    }
+                }
             }
         }
     }
 
-    return cartesianGrid;
+    return scalarField;
 }
@@ -29,9 +29,16 @@
 #define MARCHINGCUBESSERVER_CARTESIANGRID_HPP
 
 #include <vector>
+#include <map>
+#include <string>
 #include <json/json.h>
 #include <glm/glm.hpp>
+#include "../CindyScriptCompiler.hpp"
 
+/**
+ * Cartesian grids with explicit geometry store the position of every grid point next to its scalar value. This is
+ * necessary for warped grids sent by clients.
+ */
 struct CartesianGridCorner {
     // Corner position (xyz) and scalar value (w).
     glm::vec3 v;
@@ -39,16 +46,90 @@ struct CartesianGridCorner {
 };
 
 /**
- * Constructs a cartesian grid from a scalar field in 3D.
- * @param origin Origin of the cartesian grid.
- * @param dx Distance between two vertices in x direction (assuming dx = dy = dz).
- * @param nx The number of vertices in x direction (assuming nx = ny = nz).
+ * Cartesian grids with implicit geometry only store the scalar values (with the x index varying fastest). The position
+ * of the grid point (x, y, z) is origin + (x*dx, y*dy, z*dz).
+ */
+struct CartesianGridGeometry {
+    glm::vec3 origin;
+    float dx, dy, dz;
+    uint32_t nx, ny, nz;
+
+    CartesianGridGeometry() : dx(0.0f), dy(0.0f), dz(0.0f), nx(0), ny(0), nz(0) {}
+    CartesianGridGeometry(const glm::vec3 &origin, float dx, float dy, float dz, uint32_t nx, uint32_t ny, uint32_t nz)
+            : origin(origin), dx(dx), dy(dy), dz(dz), nx(nx), ny(ny), nz(nz) {}
+    inline size_t getNumPoints() const { return size_t(nx)*size_t(ny)*size_t(nz); }
+    /// The number of grid points in x (0), y (1) or z (2) direction.
+    inline uint32_t getSize(int dim) const { return dim == 0 ? nx : (dim == 1 ? ny : nz); }
+    /// The distance between two grid points in x (0), y (1) or z (2) direction.
+    inline float getSpacing(int dim) const { return dim == 0 ? dx : (dim == 1 ? dy : dz); }
+    inline glm::vec3 getPosition(uint32_t x, uint32_t y, uint32_t z) const {
+        return glm::vec3(origin.x + x*dx, origin.y + y*dy, origin.z + z*dz);
+    }
+};
+
+/// The maximum number of grid points in one direction of a requested grid.
+const uint32_t MAX_GRID_SIZE = 1u << 20;
+
+/**
+ * Checks the number of grid points in one direction of a requested grid (at least 2, at most MAX_GRID_SIZE). Larger
+ * grids would overflow the size computations and never fit into memory anyway. Prints an error if the size is invalid.
+ * @param n The number of grid points.
+ * @return Whether the size is valid.
+ */
+bool isValidGridSize(uint32_t n);
+
+/**
+ * Samples a scalar field in 3D on a Cartesian grid.
+ * @param geometry The geometry of the Cartesian grid.
+ * @param isoValue The iso value of the iso surface to extract. Blocks that provably don't contain the iso surface
+ * aren't sampled (see computeCulledBlocks).
  * @param scalarFunctionCdy A three-dimensional scalar field function vec3 -> Number.
  * The function is stored as a parsed source tree of a CindyScript function.
  * @param variables The free variables in the function to substitute.
- * @return The corners of the cartesian grid (with scalar values attached).
+ * @return The scalar values at the grid points.
  */
-std::vector<CartesianGridCorner> constructCartesianGridScalarField(const glm::vec3 &origin, float dx, uint32_t nx,
+std::vector<float> constructCartesianGridScalarField(const CartesianGridGeometry &geometry, float isoValue,
         Json::Value &scalarFunctionCdy, Json::Value &variables);
 
+/**
+ * Samples a scalar field in 3D on a Cartesian grid.
+ * @param geometry The geometry of the Cartesian grid.
+ * @param isoValue The iso value of the iso surface to extract. Blocks that provably don't contain the iso surface
+ * aren't sampled (see computeCulledBlocks).
+ * @param program The scalar field function compiled with compileScalarFieldCdy.
+ * @param variableMapGlobal The values of the free variables in the function.
+ * @return The scalar values at the grid points.
+ */
+std::vector<float> constructCartesianGridScalarField(const CartesianGridGeometry &geometry, float isoValue,
+        const CdyProgram &program, const std::map<std::string, float> &variableMapGlobal);
+
+/**
+ * Uses interval arithmetic to find the blocks of CDY_CULLING_BLOCK_SIZE^3 grid cells that can't intersect the iso
+ * surface. The grid points that only belong to culled blocks don't need to be sampled. Instead, they can be set to a
+ * sentinel value on the same side of the iso value, as no triangles are generated in culled blocks anyway.
+ * @param geometry The geometry of the Cartesian grid.
+ * @param isoValue The iso value of the iso surface to extract.
+ * @param program The compiled scalar field function (ideally specialized for the variable values).
+ * @param variables The values of the free variables in the function.
+ * @param numBlocks The number of blocks in x, y and z direction.
+ * @return For every block (x index varying fastest), NaN if the block may intersect the iso surface and otherwise the
+ * sentinel value. The vector is empty if no block could be culled.
+ */
+std::vector<float> computeCulledBlocks(const CartesianGridGeometry &geometry, float isoValue,
+        const CdyProgram &program, const std::map<std::string, float> &variables, glm::uvec3 &numBlocks);
+
+/**
+ * Compiles a three-dimensional scalar field function vec3 -> Number to bytecode.
+ * The register slots 0, 1 and 2 of the compiled program store x, y and z.
+ * @param scalarFunctionCdy The parsed source tree of the CindyScript function.
+ * @param program The compiled program.
+ * @return False if the function couldn't be compiled.
+ */
+bool compileScalarFieldCdy(Json::Value &scalarFunctionCdy, CdyProgram &program);
+
+/**
+ * Converts the free variables of a request to a map from variable names to values.
+ */
+std::map<std::string, float> parseVariablesCdy(Json::Value &variables);
+
 #endif //MARCHINGCUBESSERVER_CARTESIANGRID_HPP
@@ -0,0 +1,125 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include "ComputeKernels.hpp"
+
+ComputeKernels::ComputeKernels(const cl::Program &computeProgram) :
+        classifyCells(cl::Kernel(computeProgram, "classifyCells")),
+        classifyCellsImplicit(cl::Kernel(computeProgram, "classifyCellsImplicit")),
+        classifyCellsTiled(cl::Kernel(computeProgram, "classifyCellsTiled")),
+        classifyCellsImplicitTiled(cl::Kernel(computeProgram, "classifyCellsImplicitTiled")),
+        compactActiveCells(cl::Kernel(computeProgram, "compactActiveCells")),
+        generateTriangles(cl::Kernel(computeProgram, "generateTriangles")),
+        generateTrianglesImplicit(cl::Kernel(computeProgram, "generateTrianglesImplicit")),
+        generateTrianglesHistoPyramid(cl::Kernel(computeProgram, "generateTrianglesHistoPyramid")),
+        generateTrianglesHistoPyramidImplicit(cl::Kernel(computeProgram, "generateTrianglesHistoPyramidImplicit")),
+        classifyPointsIndexed(cl::Kernel(computeProgram, "classifyPointsIndexed")),
+        classifyPointsIndexedImplicit(cl::Kernel(computeProgram, "classifyPointsIndexedImplicit")),
+        classifyPointsIndexedTiled(cl::Kernel(computeProgram, "classifyPointsIndexedTiled")),
+        classifyPointsIndexedImplicitTiled(cl::Kernel(computeProgram, "classifyPointsIndexedImplicitTiled")),
+        generateIndexedMesh(cl::Kernel(computeProgram, "generateIndexedMesh")),
+        generateIndexedMeshImplicit(cl::Kernel(computeProgram, "generateIndexedMeshImplicit")),
+        buildHistoPyramidBase(cl::Kernel(computeProgram, "buildHistoPyramidBase")),
+        buildHistoPyramidLevel(cl::Kernel(computeProgram, "buildHistoPyramidLevel")),
+        scanBlocks(cl::Kernel(computeProgram, "scanBlocks")),
+        addBlockOffsets(cl::Kernel(computeProgram, "addBlockOffsets"))
+{
+}
+
+size_t ComputeKernels::getMaxWorkGroupSize(const cl::Device &device, KernelPass pass)
+{
+    size_t maxSize = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+    std::vector<cl::Kernel> kernels;
+    switch (pass) {
+    case PASS_CLASSIFY_CELLS:
+        kernels = { classifyCells.getKernel(), classifyCellsImplicit.getKernel(), classifyCellsTiled.getKernel(),
+                classifyCellsImplicitTiled.getKernel() };
+        break;
+    case PASS_CLASSIFY_POINTS:
+        kernels = { classifyPointsIndexed.getKernel(), classifyPointsIndexedImplicit.getKernel(),
+                classifyPointsIndexedTiled.getKernel(), classifyPointsIndexedImplicitTiled.getKernel() };
+        break;
+    case PASS_GENERATE_INDEXED_MESH:
+        kernels = { generateIndexedMesh.getKernel(), generateIndexedMeshImplicit.getKernel() };
+        break;
+    case PASS_GENERATE_TRIANGLES:
+        kernels = { compactActiveCells.getKernel(), generateTriangles.getKernel(),
+                generateTrianglesImplicit.getKernel(), generateTrianglesHistoPyramid.getKernel(),
+                generateTrianglesHistoPyramidImplicit.getKernel(), buildHistoPyramidBase.getKernel(),
+                buildHistoPyramidLevel.getKernel() };
+        break;
+    default:
+        kernels = { scanBlocks.getKernel(), addBlockOffsets.getKernel() };
+        // scanBlocks stores two uint2 elements per work item in local memory.
+        cl_ulong localMemSize = device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+        if (localMemSize != 0) {
+            maxSize = std::min(maxSize, size_t(localMemSize / (4 * sizeof(cl_uint))));
+        }
+        break;
+    }
+    for (cl::Kernel &kernel : kernels) {
+        maxSize = getKernelWorkGroupSize(kernel, device, maxSize);
+    }
+    return std::max(maxSize, size_t(1));
+}
+
+void ComputeKernels::fitWorkGroupSizes(const cl::Device &device, const cl::NDRange *passLocalWorkSizes)
+{
+    for (int pass = 0; pass < NUM_KERNEL_PASSES; pass++) {
+        localWorkSizes[pass] = fitWorkGroupSize(passLocalWorkSizes[pass],
+                getMaxWorkGroupSize(device, KernelPass(pass)));
+    }
+}
+
+size_t ComputeKernels::getKernelWorkGroupSize(cl::Kernel kernel, const cl::Device &device, size_t limit)
+{
+    try {
+        size_t kernelLimit = kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+        return kernelLimit != 0 ? std::min(kernelLimit, limit) : limit;
+    } catch (cl::Error &error) {
+        return limit;
+    }
+}
+
+cl::NDRange ComputeKernels::fitWorkGroupSize(const cl::NDRange &localWorkSize, size_t maxWorkGroupSize)
+{
+    const size_t dimensions = localWorkSize.dimensions();
+    size_t sizes[3] = { 1, 1, 1 };
+    for (size_t i = 0; i < dimensions && i < 3; i++) {
+        sizes[i] = std::max(localWorkSize[int(i)], size_t(1));
+    }
+    while (sizes[0] * sizes[1] * sizes[2] > maxWorkGroupSize) {
+        size_t *largest = std::max_element(sizes, sizes + 3);
+        *largest /= 2;
+    }
+    if (dimensions == 1) {
+        return cl::NDRange(sizes[0]);
+    }
+    return cl::NDRange(sizes[0], sizes[1], sizes[2]);
+}
@@ -0,0 +1,145 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MARCHINGCUBESSERVER_COMPUTEKERNELS_HPP
+#define MARCHINGCUBESSERVER_COMPUTEKERNELS_HPP
+
+#include "CLInterface.hpp"
+
+/**
+ * The kernel passes with their own work-group size. The sizes are tuned per device (see
+ * MarchingCubesImpl::autotuneWorkGroupSizes) and every set of kernels fits them to its own limits, as e.g. the kernels
+ * specialized for a grid shape may support smaller work groups than the generic ones (see fitWorkGroupSizes).
+ * - PASS_CLASSIFY_CELLS: classifyCells and its implicit and tiled variants (3D).
+ * - PASS_CLASSIFY_POINTS: classifyPointsIndexed and its implicit and tiled variants (3D).
+ * - PASS_GENERATE_INDEXED_MESH: generateIndexedMesh and generateIndexedMeshImplicit (3D).
+ * - PASS_GENERATE_TRIANGLES: compactActiveCells, the HistoPyramid kernels and generateTriangles* (1D).
+ * - PASS_SCAN: scanBlocks and addBlockOffsets (1D, power of two).
+ */
+enum KernelPass {
+    PASS_CLASSIFY_CELLS, PASS_CLASSIFY_POINTS, PASS_GENERATE_INDEXED_MESH, PASS_GENERATE_TRIANGLES, PASS_SCAN,
+    NUM_KERNEL_PASSES
+};
+
+/**
+ * The kernels of the compute program (MarchingCubes.cl, Scan.cl and HistoPyramid.cl) wrapped in functors. They are
+ * created once at startup, as creating kernels and querying their argument metadata is expensive on some runtimes.
+ * Kernel arguments are stored in the kernel object, so kernels must not be enqueued by multiple threads at the same
+ * time. Every command queue used by a separate thread needs its own instance.
+ */
+struct ComputeKernels {
+    typedef cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer, unsigned int, unsigned int, unsigned int, float>
+            ClassifyCellsFunctor;
+    typedef cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer, cl::Buffer,
+            unsigned int, unsigned int, unsigned int, float> ClassifyPointsFunctor;
+    typedef cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer, unsigned int, unsigned int, unsigned int, float,
+            cl::LocalSpaceArg> ClassifyCellsTiledFunctor;
+    typedef cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer, cl::Buffer,
+            unsigned int, unsigned int, unsigned int, float, cl::LocalSpaceArg> ClassifyPointsTiledFunctor;
+    typedef cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer, cl::Buffer, cl::Buffer, cl::Buffer,
+            unsigned int, unsigned int, unsigned int, float> GenerateIndexedMeshFunctor;
+    typedef cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer, cl::Buffer, cl::Buffer, cl::Buffer,
+            unsigned int, unsigned int, unsigned int, float, float, float, float, float, float, float, unsigned int>
+            GenerateIndexedMeshImplicitFunctor;
+    typedef cl::KernelFunctor<cl::Buffer, cl::Buffer, unsigned int, unsigned int> CompactActiveCellsFunctor;
+    typedef cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer, cl::Buffer, cl::Buffer,
+            unsigned int, unsigned int, unsigned int, unsigned int, float> GenerateTrianglesFunctor;
+    typedef cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer, cl::Buffer, cl::Buffer,
+            unsigned int, unsigned int, unsigned int, unsigned int, float, float, float, float, float, float, float,
+            unsigned int> GenerateTrianglesImplicitFunctor;
+    typedef cl::KernelFunctor<cl::Buffer, cl::Buffer, unsigned int, unsigned int> BuildHistoPyramidBaseFunctor;
+    typedef cl::KernelFunctor<cl::Buffer, unsigned int, unsigned int, unsigned int, unsigned int>
+            BuildHistoPyramidLevelFunctor;
+    typedef cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer, cl::Buffer, cl::Buffer, cl::Buffer,
+            unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, float>
+            GenerateTrianglesHistoPyramidFunctor;
+    typedef cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer, cl::Buffer, cl::Buffer, cl::Buffer,
+            unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, float,
+            float, float, float, float, float, float, unsigned int> GenerateTrianglesHistoPyramidImplicitFunctor;
+    typedef cl::KernelFunctor<cl::Buffer, cl::Buffer, unsigned int, cl::LocalSpaceArg> ScanBlocksFunctor;
+    typedef cl::KernelFunctor<cl::Buffer, cl::Buffer, unsigned int, unsigned int> AddBlockOffsetsFunctor;
+
+    /// Creates all kernels of the passed compute program.
+    explicit ComputeKernels(const cl::Program &computeProgram);
+
+    /// Returns the largest work-group size supported by all kernels of a pass on a device.
+    size_t getMaxWorkGroupSize(const cl::Device &device, KernelPass pass);
+    /// Sets localWorkSizes to the passed sizes of all passes, halved until they fit into the limits of the kernels.
+    void fitWorkGroupSizes(const cl::Device &device, const cl::NDRange *passLocalWorkSizes);
+    /// Returns the maximum work-group size of a kernel on a device, or the passed limit if it is lower or unknown.
+    static size_t getKernelWorkGroupSize(cl::Kernel kernel, const cl::Device &device, size_t limit);
+    /// Halves the largest dimension of a work-group size until it has at most maxWorkGroupSize work items.
+    static cl::NDRange fitWorkGroupSize(const cl::NDRange &localWorkSize, size_t maxWorkGroupSize);
+
+    /// Returns the kernel classifying the cells of grids with implicit or explicit geometry.
+    inline ClassifyCellsFunctor &getClassifyCells(bool implicitGeometry) {
+        return implicitGeometry ? classifyCellsImplicit : classifyCells;
+    }
+    /// Returns the kernel classifying the grid points for indexed output.
+    inline ClassifyPointsFunctor &getClassifyPointsIndexed(bool implicitGeometry) {
+        return implicitGeometry ? classifyPointsIndexedImplicit : classifyPointsIndexed;
+    }
+    /// Returns the kernel classifying the cells using local-memory tiling.
+    inline ClassifyCellsTiledFunctor &getClassifyCellsTiled(bool implicitGeometry) {
+        return implicitGeometry ? classifyCellsImplicitTiled : classifyCellsTiled;
+    }
+    /// Returns the kernel classifying the grid points for indexed output using local-memory tiling.
+    inline ClassifyPointsTiledFunctor &getClassifyPointsIndexedTiled(bool implicitGeometry) {
+        return implicitGeometry ? classifyPointsIndexedImplicitTiled : classifyPointsIndexedTiled;
+    }
+
+    // MarchingCubes.cl
+    ClassifyCellsFunctor classifyCells;
+    ClassifyCellsFunctor classifyCellsImplicit;
+    ClassifyCellsTiledFunctor classifyCellsTiled;
+    ClassifyCellsTiledFunctor classifyCellsImplicitTiled;
+    CompactActiveCellsFunctor compactActiveCells;
+    GenerateTrianglesFunctor generateTriangles;
+    GenerateTrianglesImplicitFunctor generateTrianglesImplicit;
+    GenerateTrianglesHistoPyramidFunctor generateTrianglesHistoPyramid;
+    GenerateTrianglesHistoPyramidImplicitFunctor generateTrianglesHistoPyramidImplicit;
+    ClassifyPointsFunctor classifyPointsIndexed;
+    ClassifyPointsFunctor classifyPointsIndexedImplicit;
+    ClassifyPointsTiledFunctor classifyPointsIndexedTiled;
+    ClassifyPointsTiledFunctor classifyPointsIndexedImplicitTiled;
+    GenerateIndexedMeshFunctor generateIndexedMesh;
+    GenerateIndexedMeshImplicitFunctor generateIndexedMeshImplicit;
+
+    // HistoPyramid.cl
+    BuildHistoPyramidBaseFunctor buildHistoPyramidBase;
+    BuildHistoPyramidLevelFunctor buildHistoPyramidLevel;
+
+    // Scan.cl
+    ScanBlocksFunctor scanBlocks;
+    AddBlockOffsetsFunctor addBlockOffsets;
+
+    /// The work-group sizes of the passes fitted to these kernels (see fitWorkGroupSizes)
+    cl::NDRange localWorkSizes[NUM_KERNEL_PASSES];
+};
+
+#endif //MARCHINGCUBESSERVER_COMPUTEKERNELS_HPP
@@ -0,0 +1,147 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include "DeviceBufferPool.hpp"
+
+PooledBuffer &PooledBuffer::operator=(PooledBuffer &&other) {
+    if (this != &other) {
+        release();
+        pool = other.pool;
+        buffer = std::move(other.buffer);
+        other.pool = NULL;
+    }
+    return *this;
+}
+
+void PooledBuffer::release() {
+    if (pool && buffer()) {
+        pool->release(buffer);
+    }
+    pool = NULL;
+    buffer = cl::Buffer();
+}
+
+void DeviceBufferPool::initialize(const cl::Context &context, size_t maxPooledBytes, size_t maxAllocSize) {
+    this->context = context;
+    this->maxPooledBytes = maxPooledBytes;
+    this->maxAllocSize = maxAllocSize;
+}
+
+/**
+ * Rounds the size of a buffer up to the next power of two.
+ */
+static size_t getSizeClass(size_t size) {
+    size_t sizeClass = DeviceBufferPool::MIN_SIZE_CLASS;
+    while (sizeClass < size) {
+        sizeClass *= 2;
+    }
+    return sizeClass;
+}
+
+PooledBuffer DeviceBufferPool::acquire(size_t size) {
+    const size_t sizeClass = getSizeClass(size);
+    if (maxAllocSize != 0 && sizeClass > maxAllocSize) {
+        // Rounding up would exceed the allocation limit although the exact size may fit. Such buffers aren't pooled.
+        return PooledBuffer(NULL, allocate(size));
+    }
+    auto it = freeBuffers.find(sizeClass);
+    if (it != freeBuffers.end() && !it->second.empty()) {
+        cl::Buffer buffer = it->second.back().buffer;
+        it->second.pop_back();
+        pooledBytes -= sizeClass;
+        return PooledBuffer(this, buffer);
+    }
+
+    return PooledBuffer(this, allocate(sizeClass));
+}
+
+/**
+ * Allocates a buffer with the passed size. If the allocation fails, the pool is freed and the allocation is retried.
+ */
+cl::Buffer DeviceBufferPool::allocate(size_t size) {
+    try {
+        return cl::Buffer(context, CL_MEM_READ_WRITE, size);
+    } catch (cl::Error &error) {
+        // The device memory may be occupied by pooled buffers.
+        if (pooledBytes == 0) {
+            throw;
+        }
+        std::cerr << "Device buffer allocation failed. Freeing the buffer pool..." << std::endl;
+        clear();
+        return cl::Buffer(context, CL_MEM_READ_WRITE, size);
+    }
+}
+
+void DeviceBufferPool::release(cl::Buffer &buffer) {
+    const size_t sizeClass = buffer.getInfo<CL_MEM_SIZE>();
+    if (sizeClass > maxPooledBytes) {
+        return;
+    }
+    while (pooledBytes + sizeClass > maxPooledBytes) {
+        freeLeastRecentlyUsed();
+    }
+    PooledEntry entry;
+    entry.buffer = buffer;
+    entry.lastUsedRequest = requestIndex;
+    freeBuffers[sizeClass].push_back(entry);
+    pooledBytes += sizeClass;
+}
+
+void DeviceBufferPool::freeLeastRecentlyUsed() {
+    auto leastRecentlyUsed = freeBuffers.end();
+    for (auto it = freeBuffers.begin(); it != freeBuffers.end(); it++) {
+        // The buffers of a size class are sorted by their last use.
+        if (!it->second.empty() && (leastRecentlyUsed == freeBuffers.end()
+                || it->second.front().lastUsedRequest < leastRecentlyUsed->second.front().lastUsedRequest)) {
+            leastRecentlyUsed = it;
+        }
+    }
+    if (leastRecentlyUsed != freeBuffers.end()) {
+        leastRecentlyUsed->second.erase(leastRecentlyUsed->second.begin());
+        pooledBytes -= leastRecentlyUsed->first;
+    }
+}
+
+void DeviceBufferPool::trim() {
+    requestIndex++;
+    for (auto &sizeClassBuffers : freeBuffers) {
+        std::vector<PooledEntry> &entries = sizeClassBuffers.second;
+        size_t numIdle = 0;
+        while (numIdle < entries.size() && requestIndex - entries[numIdle].lastUsedRequest > MAX_IDLE_REQUESTS) {
+            numIdle++;
+        }
+        entries.erase(entries.begin(), entries.begin() + numIdle);
+        pooledBytes -= numIdle * sizeClassBuffers.first;
+    }
+}
+
+void DeviceBufferPool::clear() {
+    freeBuffers.clear();
+    pooledBytes = 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MARCHINGCUBESSERVER_DEVICEBUFFERPOOL_HPP
+#define MARCHINGCUBESSERVER_DEVICEBUFFERPOOL_HPP
+
+#include <map>
+#include <vector>
+#include <cstdint>
+#include "CLInterface.hpp"
+
+class DeviceBufferPool;
+
+/**
+ * A device buffer acquired from a DeviceBufferPool. The buffer is returned to the pool when the object is destroyed.
+ * Buffers not belonging to a pool (pool = NULL) are simply released.
+ */
+class PooledBuffer {
+public:
+    PooledBuffer() : pool(NULL) {}
+    PooledBuffer(DeviceBufferPool *pool, const cl::Buffer &buffer) : pool(pool), buffer(buffer) {}
+    PooledBuffer(PooledBuffer &&other) : pool(other.pool), buffer(std::move(other.buffer)) { other.pool = NULL; }
+    PooledBuffer &operator=(PooledBuffer &&other);
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer &operator=(const PooledBuffer&) = delete;
+    ~PooledBuffer() { release(); }
+
+    /// Returns the buffer to the pool.
+    void release();
+    inline cl::Buffer &get() { return buffer; }
+    inline operator cl::Buffer&() { return buffer; }
+
+private:
+    DeviceBufferPool *pool;
+    cl::Buffer buffer;
+};
+
+/**
+ * A pool of device buffers reused across requests to avoid allocating (and zeroing) device memory for every request.
+ * Buffers are allocated in power-of-two size classes. Buffers whose size class exceeds the maximum allocation size of
+ * the device are allocated with their exact size and not pooled. Released buffers are kept until either the pooled
+ * memory exceeds the high-water cap (then the least recently used buffers are freed) or they weren't used for
+ * MAX_IDLE_REQUESTS requests (see trim).
+ * As buffers are reused as soon as they are released, buffers used on more than one command queue may only be
+ * released after all commands using them have finished.
+ */
+class DeviceBufferPool {
+    friend class PooledBuffer;
+public:
+    DeviceBufferPool() : maxPooledBytes(0), maxAllocSize(0), pooledBytes(0), requestIndex(0) {}
+    /**
+     * @param context The context to allocate the buffers in.
+     * @param maxPooledBytes The maximum size of all buffers kept in the pool (not including buffers in use).
+     * @param maxAllocSize The maximum size of a buffer on the device (CL_DEVICE_MAX_MEM_ALLOC_SIZE, 0 if unknown).
+     */
+    void initialize(const cl::Context &context, size_t maxPooledBytes, size_t maxAllocSize);
+    /**
+     * Returns a buffer (CL_MEM_READ_WRITE) with at least the passed size in bytes.
+     */
+    PooledBuffer acquire(size_t size);
+    /**
+     * Needs to be called after every request. Frees the buffers that weren't used for MAX_IDLE_REQUESTS requests.
+     */
+    void trim();
+    /// Frees all buffers in the pool.
+    void clear();
+
+    /// Buffers not used for this number of requests are freed by trim.
+    static const uint64_t MAX_IDLE_REQUESTS = 32;
+    /// The smallest size class in bytes.
+    static const size_t MIN_SIZE_CLASS = 4096;
+
+private:
+    cl::Buffer allocate(size_t size);
+    void release(cl::Buffer &buffer);
+    /// Frees the least recently used buffer in the pool.
+    void freeLeastRecentlyUsed();
+
+    struct PooledEntry {
+        cl::Buffer buffer;
+        uint64_t lastUsedRequest;
+    };
+
+    cl::Context context;
+    std::map<size_t, std::vector<PooledEntry>> freeBuffers; ///< Size class -> free buffers (most recent last)
+    size_t maxPooledBytes;
+    size_t maxAllocSize;
+    size_t pooledBytes;
+    uint64_t requestIndex;
+};
+
+#endif //MARCHINGCUBESSERVER_DEVICEBUFFERPOOL_HPP
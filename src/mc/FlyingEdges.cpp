@@ -0,0 +1,305 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <vector>
+#include <algorithm>
+#include "MarchingCubesTables.hpp"
+#include "GridAccess.hpp"
+#include "FlyingEdges.hpp"
+
+namespace {
+
+/**
+ * The data of a row of grid points in x direction.
+ */
+struct FlyingEdgesRow {
+    /// The first and last intersected edge in x direction (as point indices). Outside of [xFirst, xLast], all points
+    /// of the row are on the same side of the iso surface. Rows without intersections use xFirst = nx-1, xLast = 0.
+    uint32_t xFirst, xLast;
+    /// The number of vertices on the owned edges in x, y and z direction and the number of triangles of the row of
+    /// cells with this row as their corner 0.
+    uint32_t numXVertices, numYVertices, numZVertices, numTriangles;
+    /// The index of the first vertex and the first triangle of the row in the mesh.
+    uint32_t vertexOffset, triangleOffset;
+};
+
+/// The number of triangles for every cube index.
+struct TriangleCountTable {
+    TriangleCountTable() {
+        for (int cubeIndex = 0; cubeIndex < 256; cubeIndex++) {
+            int numEdges = 0;
+            while (triTable[cubeIndex][numEdges] != -1) {
+                numEdges++;
+            }
+            counts[cubeIndex] = uint8_t(numEdges / 3);
+        }
+    }
+    uint8_t counts[256];
+};
+static const TriangleCountTable triangleCountTable;
+
+/**
+ * Computes the range of points [first, last] of multiple rows, outside of which no edge between the rows intersects
+ * the iso surface. Outside of the trim ranges of the rows, every row is on one side of the iso surface. Thus, only
+ * if the rows are on different sides at the start or end, the range needs to be extended to the start or end.
+ * @return False if there are no intersected edges in the rows and between them.
+ */
+inline bool computeTrimRange(const FlyingEdgesRow **rows, const uint8_t **classes, int numRows, uint32_t nx,
+        uint32_t &first, uint32_t &last) {
+    first = nx - 1;
+    last = 0;
+    bool differentStart = false, differentEnd = false;
+    for (int i = 0; i < numRows; i++) {
+        first = std::min(first, rows[i]->xFirst);
+        last = std::max(last, rows[i]->xLast);
+        differentStart = differentStart || classes[i][0] != classes[0][0];
+        differentEnd = differentEnd || classes[i][nx-1] != classes[0][nx-1];
+    }
+    if (differentStart) {
+        first = 0;
+    }
+    if (differentEnd) {
+        last = nx - 1;
+    }
+    return first <= last;
+}
+
+template<class GridAccess>
+TriangleMesh flyingEdgesImpl(const GridAccess &grid, uint32_t nx, uint32_t ny, uint32_t nz, float isoLevel) {
+    const uint32_t numRows = ny * nz;
+    std::vector<FlyingEdgesRow> rows(numRows);
+    // Whether the grid points are below the iso level (the same criterion as for the cube index).
+    std::vector<uint8_t> classes(size_t(nx) * size_t(ny) * size_t(nz));
+
+    // Pass 1: Classify the grid points and compute the trim range of every row.
+    #pragma omp parallel for schedule(dynamic)
+    for (uint32_t row = 0; row < numRows; row++) {
+        const size_t rowOffset = size_t(row) * nx;
+        uint8_t *rowClasses = &classes[rowOffset];
+        for (uint32_t x = 0; x < nx; x++) {
+            rowClasses[x] = grid.getValue(rowOffset + x) < isoLevel ? 1 : 0;
+        }
+        FlyingEdgesRow &rowData = rows[row];
+        rowData.xFirst = nx - 1;
+        rowData.xLast = 0;
+        rowData.numXVertices = 0;
+        for (uint32_t x = 0; x < nx - 1; x++) {
+            if (rowClasses[x] != rowClasses[x+1]) {
+                rowData.xFirst = std::min(rowData.xFirst, x);
+                rowData.xLast = x + 1;
+                rowData.numXVertices++;
+            }
+        }
+    }
+
+    // Pass 2: Count the intersected edges in y and z direction and the triangles.
+    #pragma omp parallel for schedule(dynamic)
+    for (uint32_t row = 0; row < numRows; row++) {
+        const uint32_t y = row % ny, z = row / ny;
+        FlyingEdgesRow &rowData = rows[row];
+        rowData.numYVertices = 0;
+        rowData.numZVertices = 0;
+        rowData.numTriangles = 0;
+        uint32_t first, last;
+        const FlyingEdgesRow *trimRows[4] = { &rowData, &rowData, &rowData, &rowData };
+        const uint8_t *rowClasses[4] = { &classes[size_t(row) * nx], NULL, NULL, NULL };
+
+        if (y + 1 < ny) {
+            trimRows[1] = &rows[row + 1];
+            rowClasses[1] = rowClasses[0] + nx;
+            if (computeTrimRange(trimRows, rowClasses, 2, nx, first, last)) {
+                for (uint32_t x = first; x <= last; x++) {
+                    rowData.numYVertices += rowClasses[0][x] != rowClasses[1][x] ? 1 : 0;
+                }
+            }
+        }
+        if (z + 1 < nz) {
+            const FlyingEdgesRow *zRows[2] = { &rowData, &rows[row + ny] };
+            const uint8_t *zClasses[2] = { rowClasses[0], rowClasses[0] + size_t(nx) * ny };
+            if (computeTrimRange(zRows, zClasses, 2, nx, first, last)) {
+                for (uint32_t x = first; x <= last; x++) {
+                    rowData.numZVertices += zClasses[0][x] != zClasses[1][x] ? 1 : 0;
+                }
+            }
+        }
+        if (y + 1 < ny && z + 1 < nz) {
+            // The rows (y+1,z), (y,z+1) and (y+1,z+1) of the cells.
+            trimRows[2] = &rows[row + ny];
+            trimRows[3] = &rows[row + ny + 1];
+            rowClasses[2] = rowClasses[0] + size_t(nx) * ny;
+            rowClasses[3] = rowClasses[2] + nx;
+            if (computeTrimRange(trimRows, rowClasses, 4, nx, first, last)) {
+                for (uint32_t x = first; x < last; x++) {
+                    int cubeIndex = rowClasses[0][x] | rowClasses[0][x+1] << 1 | rowClasses[2][x+1] << 2
+                            | rowClasses[2][x] << 3 | rowClasses[1][x] << 4 | rowClasses[1][x+1] << 5
+                            | rowClasses[3][x+1] << 6 | rowClasses[3][x] << 7;
+                    rowData.numTriangles += triangleCountTable.counts[cubeIndex];
+                }
+            }
+        }
+    }
+
+    // Pass 3: Compute the offsets of the vertices and triangles of the rows.
+    uint32_t numVertices = 0, numTriangles = 0;
+    for (uint32_t row = 0; row < numRows; row++) {
+        FlyingEdgesRow &rowData = rows[row];
+        rowData.vertexOffset = numVertices;
+        rowData.triangleOffset = numTriangles;
+        numVertices += rowData.numXVertices + rowData.numYVertices + rowData.numZVertices;
+        numTriangles += rowData.numTriangles;
+    }
+
+    TriangleMesh mesh(true);
+    if (numTriangles == 0) {
+        return mesh;
+    }
+    mesh.vertices.resize(numVertices);
+    mesh.indices.resize(size_t(numTriangles) * 3);
+    glm::vec3 *vertices = &mesh.vertices.front();
+    uint32_t *indices = &mesh.indices.front();
+
+    // Pass 4: Generate the vertices and triangles of the rows.
+    #pragma omp parallel for schedule(dynamic)
+    for (uint32_t row = 0; row < numRows; row++) {
+        const uint32_t y = row % ny, z = row / ny;
+        const FlyingEdgesRow &rowData = rows[row];
+        const size_t rowOffset = size_t(row) * nx;
+        const uint8_t *rowClasses = &classes[rowOffset];
+        const size_t yStride = nx, zStride = size_t(nx) * ny;
+
+        // The vertices of a row are stored in the order x, y, z edges.
+        uint32_t vertexIndex = rowData.vertexOffset;
+        for (uint32_t x = rowData.xFirst; x < rowData.xLast; x++) {
+            if (rowClasses[x] != rowClasses[x+1]) {
+                vertices[vertexIndex++] = vertexInterpIso(isoLevel,
+                        grid.getPosition(rowOffset + x, x, y, z), grid.getPosition(rowOffset + x + 1, x + 1, y, z),
+                        grid.getValue(rowOffset + x), grid.getValue(rowOffset + x + 1));
+            }
+        }
+        uint32_t first, last;
+        if (rowData.numYVertices > 0) {
+            const FlyingEdgesRow *yRows[2] = { &rowData, &rows[row + 1] };
+            const uint8_t *yClasses[2] = { rowClasses, rowClasses + yStride };
+            computeTrimRange(yRows, yClasses, 2, nx, first, last);
+            for (uint32_t x = first; x <= last; x++) {
+                if (rowClasses[x] != rowClasses[x + yStride]) {
+                    vertices[vertexIndex++] = vertexInterpIso(isoLevel,
+                            grid.getPosition(rowOffset + x, x, y, z),
+                            grid.getPosition(rowOffset + yStride + x, x, y + 1, z),
+                            grid.getValue(rowOffset + x), grid.getValue(rowOffset + yStride + x));
+                }
+            }
+        }
+        if (rowData.numZVertices > 0) {
+            const FlyingEdgesRow *zRows[2] = { &rowData, &rows[row + ny] };
+            const uint8_t *zClasses[2] = { rowClasses, rowClasses + zStride };
+            computeTrimRange(zRows, zClasses, 2, nx, first, last);
+            for (uint32_t x = first; x <= last; x++) {
+                if (rowClasses[x] != rowClasses[x + zStride]) {
+                    vertices[vertexIndex++] = vertexInterpIso(isoLevel,
+                            grid.getPosition(rowOffset + x, x, y, z),
+                            grid.getPosition(rowOffset + zStride + x, x, y, z + 1),
+                            grid.getValue(rowOffset + x), grid.getValue(rowOffset + zStride + x));
+                }
+            }
+        }
+
+        if (rowData.numTriangles == 0) {
+            continue;
+        }
+
+        // The rows (y,z), (y+1,z), (y,z+1) and (y+1,z+1) of the cells.
+        const FlyingEdgesRow *cellRows[4] = { &rowData, &rows[row + 1], &rows[row + ny], &rows[row + ny + 1] };
+        const uint8_t *cellClasses[4] = {
+                rowClasses, rowClasses + yStride, rowClasses + zStride, rowClasses + zStride + yStride };
+        computeTrimRange(cellRows, cellClasses, 4, nx, first, last);
+
+        // The indices of the next vertex on the edges in x direction of the four rows, on the edges in y direction
+        // of the rows (y,z) and (y,z+1), and on the edges in z direction of the rows (y,z) and (y+1,z).
+        // No edge before the start of the trim range is intersected.
+        uint32_t xEdgeIds[4], yEdgeIds[2], zEdgeIds[2];
+        for (int i = 0; i < 4; i++) {
+            xEdgeIds[i] = cellRows[i]->vertexOffset;
+        }
+        yEdgeIds[0] = rowData.vertexOffset + rowData.numXVertices;
+        yEdgeIds[1] = cellRows[2]->vertexOffset + cellRows[2]->numXVertices;
+        zEdgeIds[0] = rowData.vertexOffset + rowData.numXVertices + rowData.numYVertices;
+        zEdgeIds[1] = cellRows[1]->vertexOffset + cellRows[1]->numXVertices + cellRows[1]->numYVertices;
+
+        uint32_t *triangleIndices = indices + size_t(rowData.triangleOffset) * 3;
+        for (uint32_t x = first; x < last; x++) {
+            const uint8_t *c0 = cellClasses[0], *c1 = cellClasses[1], *c2 = cellClasses[2], *c3 = cellClasses[3];
+            int cubeIndex = c0[x] | c0[x+1] << 1 | c2[x+1] << 2 | c2[x] << 3
+                    | c1[x] << 4 | c1[x+1] << 5 | c3[x+1] << 6 | c3[x] << 7;
+            bool yEdge0 = c0[x] != c1[x], yEdge1 = c2[x] != c3[x];
+            bool zEdge0 = c0[x] != c2[x], zEdge1 = c1[x] != c3[x];
+
+            if (triTable[cubeIndex][0] != -1) {
+                // The vertex indices of the twelve edges of the cell (see the edge order in cl/MarchingCubes.cl).
+                uint32_t edgeIds[12];
+                edgeIds[0] = xEdgeIds[0];
+                edgeIds[2] = xEdgeIds[2];
+                edgeIds[4] = xEdgeIds[1];
+                edgeIds[6] = xEdgeIds[3];
+                edgeIds[8] = yEdgeIds[0];
+                edgeIds[9] = yEdgeIds[0] + (yEdge0 ? 1 : 0);
+                edgeIds[11] = yEdgeIds[1];
+                edgeIds[10] = yEdgeIds[1] + (yEdge1 ? 1 : 0);
+                edgeIds[3] = zEdgeIds[0];
+                edgeIds[1] = zEdgeIds[0] + (zEdge0 ? 1 : 0);
+                edgeIds[7] = zEdgeIds[1];
+                edgeIds[5] = zEdgeIds[1] + (zEdge1 ? 1 : 0);
+                for (int i = 0; triTable[cubeIndex][i] != -1; i++) {
+                    *triangleIndices++ = edgeIds[triTable[cubeIndex][i]];
+                }
+            }
+
+            // Advance to the next cell.
+            for (int i = 0; i < 4; i++) {
+                xEdgeIds[i] += cellClasses[i][x] != cellClasses[i][x+1] ? 1 : 0;
+            }
+            yEdgeIds[0] += yEdge0 ? 1 : 0;
+            yEdgeIds[1] += yEdge1 ? 1 : 0;
+            zEdgeIds[0] += zEdge0 ? 1 : 0;
+            zEdgeIds[1] += zEdge1 ? 1 : 0;
+        }
+    }
+
+    return mesh;
+}
+
+}
+
+TriangleMesh flyingEdges(const CartesianGridGeometry &geometry, float isoLevel, const float *scalarField) {
+    return flyingEdgesImpl(ImplicitGridAccess(geometry, scalarField), geometry.nx, geometry.ny, geometry.nz, isoLevel);
+}
+
+TriangleMesh flyingEdges(uint32_t nx, uint32_t ny, uint32_t nz, float isoLevel,
+        const CartesianGridCorner *cartesianGrid) {
+    return flyingEdgesImpl(ExplicitGridAccess(cartesianGrid), nx, ny, nz, isoLevel);
+}
@@ -0,0 +1,67 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MARCHINGCUBESSERVER_FLYINGEDGES_HPP
+#define MARCHINGCUBESSERVER_FLYINGEDGES_HPP
+
+#include "CartesianGrid.hpp"
+#include "TriangleMesh.hpp"
+
+/**
+ * Flying edges (Schroeder et al., "Flying Edges: A High-Performance Scalable Isocontouring Algorithm", 2015) is an
+ * alternative to the cell-parallel marching cubes algorithm running on the CPU. It processes the rows of grid points
+ * in x direction in parallel in four passes:
+ * 1. Classify the grid points and the edges in x direction of every row, and compute the trim range of the row (the
+ *    range outside of which the row doesn't intersect the iso surface).
+ * 2. Count the intersected edges in y and z direction owned by every row and the triangles of every row of cells.
+ * 3. Compute the offsets of the vertices and triangles of every row with a prefix sum.
+ * 4. Generate the vertices and triangles of every row.
+ * Every scalar value is only read once for the classification, and every intersected edge is interpolated once.
+ * The output is an indexed mesh, and no synchronization between the rows is necessary.
+ */
+
+/**
+ * Extracts the iso surface of a Cartesian grid with implicit geometry using flying edges.
+ * @param geometry The geometry of the Cartesian grid.
+ * @param isoLevel The iso level of the iso surface to construct.
+ * @param scalarField The scalar values at the grid points (geometry.getNumPoints() values).
+ * @return The indexed triangle mesh of the iso surface.
+ */
+TriangleMesh flyingEdges(const CartesianGridGeometry &geometry, float isoLevel, const float *scalarField);
+
+/**
+ * Extracts the iso surface of a Cartesian grid with explicit geometry using flying edges.
+ * @param nx, ny, nz The number of grid points in x, y and z direction.
+ * @param isoLevel The iso level of the iso surface to construct.
+ * @param cartesianGrid The Cartesian grid (nx*ny*nz entries).
+ * @return The indexed triangle mesh of the iso surface.
+ */
+TriangleMesh flyingEdges(uint32_t nx, uint32_t ny, uint32_t nz, float isoLevel,
+        const CartesianGridCorner *cartesianGrid);
+
+#endif //MARCHINGCUBESSERVER_FLYINGEDGES_HPP
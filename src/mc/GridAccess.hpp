@@ -0,0 +1,82 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MARCHINGCUBESSERVER_GRIDACCESS_HPP
+#define MARCHINGCUBESSERVER_GRIDACCESS_HPP
+
+#include <cmath>
+#include <glm/glm.hpp>
+#include "CartesianGrid.hpp"
+
+/*
+ * Helpers for the CPU implementations of the iso surface extraction (see FlyingEdges.hpp and MarchingCubesCpu.hpp).
+ * The implementations are templates over the grid access classes, such that grids with implicit and explicit
+ * geometry share the same code.
+ */
+
+/**
+ * Accesses the scalar values and positions of a Cartesian grid with implicit geometry.
+ */
+struct ImplicitGridAccess {
+    ImplicitGridAccess(const CartesianGridGeometry &geometry, const float *scalarField)
+            : geometry(geometry), scalarField(scalarField) {}
+    inline float getValue(size_t index) const { return scalarField[index]; }
+    inline glm::vec3 getPosition(size_t index, uint32_t x, uint32_t y, uint32_t z) const {
+        return geometry.getPosition(x, y, z);
+    }
+    const CartesianGridGeometry &geometry;
+    const float *scalarField;
+};
+
+/**
+ * Accesses the scalar values and positions of a Cartesian grid with explicit geometry.
+ */
+struct ExplicitGridAccess {
+    ExplicitGridAccess(const CartesianGridCorner *cartesianGrid) : cartesianGrid(cartesianGrid) {}
+    inline float getValue(size_t index) const { return cartesianGrid[index].f; }
+    inline glm::vec3 getPosition(size_t index, uint32_t x, uint32_t y, uint32_t z) const {
+        return cartesianGrid[index].v;
+    }
+    const CartesianGridCorner *cartesianGrid;
+};
+
+/**
+ * Interpolates the intersection of the iso surface with an edge (see vertexInterpIso in cl/MarchingCubes.cl).
+ */
+inline glm::vec3 vertexInterpIso(float isoLevel, const glm::vec3 &p0, const glm::vec3 &p1, float f0, float f1) {
+    if (std::fabs(isoLevel - f0) < 0.00001f)
+        return p0;
+    if (std::fabs(isoLevel - f1) < 0.00001f)
+        return p1;
+    if (std::fabs(f0 - f1) < 0.00001f)
+        return p0;
+    float mu = (isoLevel - f0) / (f1 - f0);
+    return glm::vec3(p0.x + mu * (p1.x - p0.x), p0.y + mu * (p1.y - p0.y), p0.z + mu * (p1.z - p0.z));
+}
+
+#endif //MARCHINGCUBESSERVER_GRIDACCESS_HPP
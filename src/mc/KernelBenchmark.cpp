@@ -0,0 +1,101 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include "KernelBenchmark.hpp"
+
+/// The number of timed extractions per variant (after one untimed warm-up extraction).
+const int BENCHMARK_NUM_RUNS = 10;
+
+std::vector<float> createBenchmarkScalarField(const CartesianGridGeometry &geometry)
+{
+    std::vector<float> scalarField(geometry.getNumPoints());
+    #pragma omp parallel for
+    for (int z = 0; z < int(geometry.nz); z++) {
+        for (uint32_t y = 0; y < geometry.ny; y++) {
+            for (uint32_t x = 0; x < geometry.nx; x++) {
+                glm::vec3 position = geometry.origin + glm::vec3(x * geometry.dx, y * geometry.dy, z * geometry.dz);
+                float ripples = 0.1f * std::sin(8.0f * position.x) * std::sin(8.0f * position.y)
+                        * std::sin(8.0f * position.z);
+                scalarField[x + (y + size_t(z) * geometry.ny) * geometry.nx] = glm::length(position) + ripples;
+            }
+        }
+    }
+    return scalarField;
+}
+
+/**
+ * Returns the mean time in milliseconds of BENCHMARK_NUM_RUNS extractions.
+ */
+static double timeExtraction(MarchingCubesImpl &mcImpl, const CartesianGridGeometry &geometry,
+        const std::vector<float> &scalarField, bool indexedOutput, size_t &numVertices)
+{
+    // The warm-up extraction also builds the specialized kernels.
+    const float isoLevel = 0.7f;
+    numVertices = mcImpl.marchingCubesImplicit(geometry, isoLevel, &scalarField.front(), indexedOutput,
+            ENGINE_MARCHING_CUBES).vertices.size();
+    mcImpl.finishRequest();
+    auto startTime = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCHMARK_NUM_RUNS; i++) {
+        mcImpl.marchingCubesImplicit(geometry, isoLevel, &scalarField.front(), indexedOutput, ENGINE_MARCHING_CUBES);
+        mcImpl.finishRequest();
+    }
+    auto endTime = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(endTime - startTime).count() / BENCHMARK_NUM_RUNS;
+}
+
+void runKernelSpecializationBenchmark(MarchingCubesImpl &mcImpl)
+{
+    const uint32_t gridSizes[] = { 64, 128, 256 };
+    std::cout << std::endl << "Kernel specialization benchmark (mean of " << BENCHMARK_NUM_RUNS << " runs)"
+            << std::endl;
+    std::cout << std::setw(10) << "grid" << std::setw(10) << "output" << std::setw(12) << "vertices"
+            << std::setw(14) << "generic ms" << std::setw(16) << "specialized ms" << std::setw(10) << "speedup"
+            << std::endl;
+
+    for (uint32_t n : gridSizes) {
+        const float spacing = 2.0f / float(n - 1);
+        CartesianGridGeometry geometry(glm::vec3(-1.0f), spacing, spacing, spacing, n, n, n);
+        std::vector<float> scalarField = createBenchmarkScalarField(geometry);
+        for (int indexed = 0; indexed < 2; indexed++) {
+            size_t numVertices = 0;
+            mcImpl.setKernelSpecialization(0);
+            double genericTime = timeExtraction(mcImpl, geometry, scalarField, indexed != 0, numVertices);
+            mcImpl.setKernelSpecialization(1);
+            double specializedTime = timeExtraction(mcImpl, geometry, scalarField, indexed != 0, numVertices);
+
+            std::cout << std::setw(10) << (std::to_string(n) + "^3") << std::setw(10) << (indexed ? "indexed" : "soup")
+                    << std::setw(12) << numVertices << std::fixed << std::setprecision(2)
+                    << std::setw(14) << genericTime << std::setw(16) << specializedTime
+                    << std::setw(9) << genericTime / specializedTime << "x" << std::endl;
+        }
+    }
+}
@@ -0,0 +1,51 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MARCHINGCUBESSERVER_KERNELBENCHMARK_HPP
+#define MARCHINGCUBESSERVER_KERNELBENCHMARK_HPP
+
+#include "MarchingCubes.hpp"
+
+/**
+ * Creates a sphere with ripples on the grid [-1,1]^3, so the surface has many active cells in all directions. Used by
+ * the benchmark and by the work-group size autotuner (see MarchingCubesImpl::autotuneWorkGroupSizes).
+ * @param geometry The geometry of the grid (the iso surface at 0.7 lies inside [-1,1]^3).
+ * @return The scalar values in the layout of Cartesian grids with implicit geometry.
+ */
+std::vector<float> createBenchmarkScalarField(const CartesianGridGeometry &geometry);
+
+/**
+ * Compares the generic compute kernels with the kernels specialized for the grid shape (see
+ * MarchingCubesImpl::prepareKernelSpecialization) on synthetic grids of increasing size, for triangle soups and
+ * indexed meshes. Prints the mean time per extraction (including the upload of the grid and the download of the mesh)
+ * of both variants and the speedup. Run with "--benchmark".
+ * @param mcImpl The initialized marching cubes implementation (the OpenCL backend is required).
+ */
+void runKernelSpecializationBenchmark(MarchingCubesImpl &mcImpl);
+
+#endif //MARCHINGCUBESSERVER_KERNELBENCHMARK_HPP
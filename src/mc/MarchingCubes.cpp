@@ -27,44 +27,212 @@
  */
 
 #include <thread>
+#include <chrono>
+#include <exception>
 #include <mutex>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <omp.h>
 
+#include "../CindyScriptOpenCL.hpp"
+#include "../CindyScriptOptimizer.hpp"
+#include "FlyingEdges.hpp"
+#include "MarchingCubesCpu.hpp"
 #include "MarchingCubes.hpp"
 
 const int _OPENCL_PLAT_ID_ = 0;
 
+/// The source files of the compute program.
+const std::vector<std::string> COMPUTE_PROGRAM_FILES = { "cl/MarchingCubes.cl", "cl/Scan.cl", "cl/HistoPyramid.cl" };
+/// The number of elements of a HistoPyramid level that are reduced to one element of the level above (see
+/// HistoPyramid.cl).
+const uint32_t HISTOPYRAMID_FAN_IN = 8;
+/// TRAVERSAL_AUTO uses a HistoPyramid for grids with at least this many cells (256^3).
+const size_t HISTOPYRAMID_MIN_NUM_CELLS = size_t(1) << 24;
+/// The size in bytes of the slabs grids on the host are uploaded in (see marchingCubesPipelined).
+const size_t PIPELINE_SLAB_SIZE = size_t(32) << 20;
+/// An estimate of the device memory needed per grid point of a brick, including the intermediate buffers and a
+/// generous share of the generated mesh (see getBrickNumCells).
+const size_t BRICK_BYTES_PER_POINT = 64;
+/// Grids with fewer cells are processed on a single device (see marchingCubesMultiDevice).
+const size_t MULTI_DEVICE_MIN_NUM_CELLS = size_t(1) << 22;
+/// The maximum number of grid shapes kept in MarchingCubesImpl::kernelSpecializations.
+const size_t MAX_KERNEL_SPECIALIZATIONS = 16;
+
 /**
- * Initializes OpenCL, creates a default device and a command queue.
+ * Initializes OpenCL and creates the command queues of all devices of the platform (or only of the first device, see
+ * setUseAllDevices). If no OpenCL platform is available (and the OpenCL backend wasn't enforced), the native CPU
+ * backend is used instead.
  */
 void MarchingCubesImpl::init()
 {
-    CLInterface::get()->initialize(CLContextInfo(_OPENCL_PLAT_ID_));
+    if (backend != BACKEND_CPU) {
+        if (CLInterface::get()->initialize(CLContextInfo(_OPENCL_PLAT_ID_, useAllDevices))) {
+            backend = BACKEND_OPENCL;
+        } else if (backend == BACKEND_OPENCL) {
+            std::cerr << "Fatal Error: Couldn't initialize OpenCL." << std::endl;
+            exit(1);
+        } else {
+            std::cout << "Falling back to the native CPU backend." << std::endl;
+            backend = BACKEND_CPU;
+        }
+    }
+    if (backend == BACKEND_CPU) {
+        std::cout << "Using the native CPU backend with " << omp_get_max_threads() << " threads." << std::endl;
+        return;
+    }
+
     CLInterface::get()->printInfo();
 
     context = CLInterface::get()->getContext();
     devices = CLInterface::get()->getDevices();
-    computeProgram = CLInterface::get()->loadProgramFromSourceFiles({
-        "cl/MarchingCubes.cl"
-    });
+    CLInterface::get()->setBinaryCacheDirectory(programCacheDirectory);
+    computeProgram = CLInterface::get()->loadProgramFromSourceFiles(COMPUTE_PROGRAM_FILES);
+
+    for (const cl::Device &clDevice : devices) {
+        initComputeDevice(clDevice);
+    }
+    if (computeDevices.size() > 1) {
+        std::cout << "Splitting large grids across " << computeDevices.size() << " devices." << std::endl;
+    }
+}
+
+/**
+ * Creates the queues, kernels and buffer pool of a device of the context and queries its limits.
+ * @param clDevice The OpenCL device.
+ */
+void MarchingCubesImpl::initComputeDevice(const cl::Device &clDevice)
+{
+    std::unique_ptr<ComputeDevice> device(new ComputeDevice);
+    device->device = clDevice;
 
 #ifndef _PROFILING_CL_
-    queue = cl::CommandQueue(context, devices[0]);
+    device->queue = cl::CommandQueue(context, clDevice);
+    device->uploadQueue = cl::CommandQueue(context, clDevice);
+    device->downloadQueue = cl::CommandQueue(context, clDevice);
 #else
-    queue = cl::CommandQueue(context, devices[0], CL_QUEUE_PROFILING_ENABLE);
+    device->queue = cl::CommandQueue(context, clDevice, CL_QUEUE_PROFILING_ENABLE);
+    device->uploadQueue = cl::CommandQueue(context, clDevice, CL_QUEUE_PROFILING_ENABLE);
+    device->downloadQueue = cl::CommandQueue(context, clDevice, CL_QUEUE_PROFILING_ENABLE);
 #endif
+    device->kernels.reset(new ComputeKernels(computeProgram));
+
+    // Devices sharing the memory with the host (e.g. CPUs and integrated GPUs) can read input data in place.
+    cl_bool hostUnifiedMemoryCl = CL_FALSE;
+    clDevice.getInfo(CL_DEVICE_HOST_UNIFIED_MEMORY, &hostUnifiedMemoryCl);
+    device->hostUnifiedMemory = hostUnifiedMemoryCl == CL_TRUE;
+
+    // Intermediate buffers are reused across requests. By default, the pool keeps up to a quarter of the device memory.
+    cl_ulong globalMemSize = 0, maxMemAllocSize = 0;
+    clDevice.getInfo(CL_DEVICE_GLOBAL_MEM_SIZE, &globalMemSize);
+    clDevice.getInfo(CL_DEVICE_MAX_MEM_ALLOC_SIZE, &maxMemAllocSize);
+    device->bufferPool.initialize(context, maxPooledBytes != 0 ? maxPooledBytes : size_t(globalMemSize / 4),
+            size_t(maxMemAllocSize));
+
+    // Grids not fitting into the memory budget (half of the device memory by default) are processed in bricks. A
+    // single buffer must additionally not exceed the maximum allocation size.
+    size_t budget = memoryBudget != 0 ? memoryBudget : size_t(globalMemSize / 2);
+    device->maxBrickNumPoints = std::min(budget / BRICK_BYTES_PER_POINT,
+            size_t(maxMemAllocSize / sizeof(glm::vec4)));
+    std::cout << "Grids with more than " << device->maxBrickNumPoints << " points are processed in bricks on "
+            << clDevice.getInfo<CL_DEVICE_NAME>() << "." << std::endl;
 
-    size_t maxWorkGroupSize;
-    devices[0].getInfo(CL_DEVICE_MAX_WORK_GROUP_SIZE, &maxWorkGroupSize);
+    // Until the throughput of the device was measured, the work is split by its peak compute rate.
+    cl_uint computeUnits = 1, clockFrequency = 1;
+    clDevice.getInfo(CL_DEVICE_MAX_COMPUTE_UNITS, &computeUnits);
+    clDevice.getInfo(CL_DEVICE_MAX_CLOCK_FREQUENCY, &clockFrequency);
+    device->estimatedThroughput = double(std::max(computeUnits, 1u)) * double(std::max(clockFrequency, 1u));
 
-    // Set local work size.
-    LOCAL_WORK_SIZE = cl::NDRange(64, 4, 1);
-    assert(LOCAL_WORK_SIZE[0] * LOCAL_WORK_SIZE[1] * LOCAL_WORK_SIZE[2] <= maxWorkGroupSize);
+    // Loading the grid points of a work group into local memory first pays off on GPUs with dedicated local memory.
+    // CPU runtimes emulate local memory in global memory, where the additional barrier only costs time.
+    cl_device_type deviceType = CL_DEVICE_TYPE_DEFAULT;
+    cl_device_local_mem_type localMemType = CL_GLOBAL;
+    clDevice.getInfo(CL_DEVICE_TYPE, &deviceType);
+    clDevice.getInfo(CL_DEVICE_LOCAL_MEM_TYPE, &localMemType);
+    device->useGridTiling = gridTiling == TILING_ON || (gridTiling == TILING_AUTO
+            && (deviceType & CL_DEVICE_TYPE_GPU) != 0 && localMemType == CL_LOCAL);
+    if (device->useGridTiling) {
+        std::cout << "Using local-memory tiling on " << clDevice.getInfo<CL_DEVICE_NAME>() << "." << std::endl;
+    }
+
+    initWorkGroupSizes(*device);
+    computeDevices.push_back(std::move(device));
 }
 
 void MarchingCubesImpl::quit()
 {
+    for (std::unique_ptr<ComputeDevice> &device : computeDevices) {
+        device->bufferPool.clear();
+        device->specializedKernels.clear();
+        device->kernels.reset();
+    }
+    computeDevices.clear();
+    kernelSpecializations.clear();
+}
+
+/**
+ * Counts a request with the shape of the passed grid and builds the compute program specialized for the shape once
+ * it was requested specializationMinRequests times. The specialized programs are compiled with the number of grid
+ * points in x and y direction as compile-time constants (see SPECIALIZE_GRID_SIZE in MarchingCubes.cl), which allows
+ * the compiler to strength-reduce the index computations. As compiling takes a while, grid shapes requested only once
+ * use the generic kernels. The specialized binaries are stored in the program binary cache like the generic ones.
+ * At most MAX_KERNEL_SPECIALIZATIONS shapes are kept; the least recently requested one is evicted first.
+ * @param geometry The geometry of the grid of the request.
+ */
+void MarchingCubesImpl::prepareKernelSpecialization(const CartesianGridGeometry &geometry)
+{
+    if (specializationMinRequests == 0) {
+        return;
+    }
+    const std::pair<uint32_t, uint32_t> shape(geometry.nx, geometry.ny);
+    auto it = kernelSpecializations.find(shape);
+    if (it == kernelSpecializations.end()) {
+        if (kernelSpecializations.size() >= MAX_KERNEL_SPECIALIZATIONS) {
+            auto leastRecentlyUsed = kernelSpecializations.begin();
+            for (auto entry = kernelSpecializations.begin(); entry != kernelSpecializations.end(); entry++) {
+                if (entry->second.lastRequest < leastRecentlyUsed->second.lastRequest) {
+                    leastRecentlyUsed = entry;
+                }
+            }
+            for (std::unique_ptr<ComputeDevice> &device : computeDevices) {
+                device->specializedKernels.erase(leastRecentlyUsed->first);
+            }
+            kernelSpecializations.erase(leastRecentlyUsed);
+        }
+        it = kernelSpecializations.insert(std::make_pair(shape, KernelSpecialization())).first;
+    }
+
+    KernelSpecialization &specialization = it->second;
+    specialization.numRequests++;
+    specialization.lastRequest = ++requestCounter;
+    if (specialization.built || specialization.numRequests < specializationMinRequests) {
+        return;
+    }
+
+    std::string buildOptions = "-D GRID_NX=" + std::to_string(geometry.nx) + " -D GRID_NY="
+            + std::to_string(geometry.ny);
+    specialization.program = CLInterface::get()->loadProgramFromSourceFiles(COMPUTE_PROGRAM_FILES, buildOptions);
+    for (std::unique_ptr<ComputeDevice> &device : computeDevices) {
+        device->specializedKernels[shape].reset(new ComputeKernels(specialization.program));
+        device->specializedKernels[shape]->fitWorkGroupSizes(device->device, device->PASS_LOCAL_WORK_SIZES);
+    }
+    specialization.built = true;
+}
+
+/**
+ * Returns the kernels for a grid on a device, i.e. the kernels specialized for the shape of the grid if they were
+ * built (see prepareKernelSpecialization) and specialization is enabled, and the generic kernels otherwise.
+ * @param device The device to use.
+ * @param geometry The geometry of the grid (or of a slab or brick of it).
+ */
+ComputeKernels &MarchingCubesImpl::getKernels(ComputeDevice &device, const CartesianGridGeometry &geometry)
+{
+    if (specializationMinRequests == 0) {
+        return *device.kernels;
+    }
+    auto it = device.specializedKernels.find(std::make_pair(geometry.nx, geometry.ny));
+    return it != device.specializedKernels.end() ? *it->second : *device.kernels;
 }
 
 /**
@@ -103,69 +271,961 @@ void MarchingCubesImpl::quit()
 
 static std::mutex mcMutex;
 
+void MarchingCubesImpl::autotune()
+{
+    if (backend != BACKEND_OPENCL) {
+        std::cerr << "Autotuning needs the OpenCL backend." << std::endl;
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mcMutex);
+    for (std::unique_ptr<ComputeDevice> &device : computeDevices) {
+        autotuneWorkGroupSizes(*device);
+    }
+}
+
+void MarchingCubesImpl::finishRequest()
+{
+    std::lock_guard<std::mutex> lock(mcMutex);
+    for (std::unique_ptr<ComputeDevice> &device : computeDevices) {
+        device->bufferPool.trim();
+    }
+}
+
+/**
+ * Converts a mesh created by flying edges (which is always indexed) to the requested output format.
+ */
+static TriangleMesh convertFlyingEdgesMesh(TriangleMesh mesh, bool indexedOutput)
+{
+    if (mesh.vertices.empty()) {
+        std::cout << "Mesh empty." << std::endl;
+    }
+    if (!indexedOutput) {
+        mesh.convertToTriangleSoup();
+    }
+    return mesh;
+}
+
+/**
+ * Creates a read-only buffer for input data on the host. If the device shares the memory with the host, the data is
+ * used in place (CL_MEM_USE_HOST_PTR). Otherwise, it is uploaded to a buffer from the pool.
+ * The data needs to stay valid until all commands using the buffer have finished.
+ * @param device The device to use.
+ * @param data The input data.
+ * @param size The size of the input data in bytes.
+ * @return The buffer.
+ */
+PooledBuffer MarchingCubesImpl::createInputBuffer(ComputeDevice &device, const void *data, size_t size)
+{
+    if (device.hostUnifiedMemory) {
+        return PooledBuffer(NULL, cl::Buffer(
+                context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, size, const_cast<void*>(data)));
+    }
+    PooledBuffer buffer = device.bufferPool.acquire(size);
+    device.queue.enqueueWriteBuffer(buffer, CL_TRUE, 0, size, data);
+    return buffer;
+}
+
 /**
  * Uses the marching cubes algorithm to compute the iso surface of a scalar field approximated by a Cartesian grid.
- * @param nx The number of grid cells in x, y and z direction.
+ * @param nx The number of grid points in x direction.
+ * @param ny The number of grid points in y direction.
+ * @param nz The number of grid points in z direction.
  * @param isoLevel The iso level of the iso surface to construct.
- * @param cartesianGrid The cartesian grid (i.e. a set of regularly arranged points mapped to scalar values).
- * @return The triangle vertex points of the iso surface.
+ * @param cartesianGrid The cartesian grid (i.e. a set of regularly arranged points mapped to scalar values, nx*ny*nz
+ * entries).
+ * @param indexedOutput Whether to create an indexed mesh instead of a triangle soup.
+ * @param engine The algorithm to use.
+ * @return The triangle mesh of the iso surface.
  */
-std::vector<glm::vec3> MarchingCubesImpl::marchingCubes(uint32_t nx, float isoLevel,
-        const std::vector<CartesianGridCorner> &cartesianGrid)
+TriangleMesh MarchingCubesImpl::marchingCubes(uint32_t nx, uint32_t ny, uint32_t nz, float isoLevel,
+        const CartesianGridCorner *cartesianGrid, bool indexedOutput, ExtractionEngine engine)
 {
+    if (useFlyingEdges(engine, indexedOutput)) {
+        return convertFlyingEdgesMesh(flyingEdges(nx, ny, nz, isoLevel, cartesianGrid), indexedOutput);
+    }
+    if (backend == BACKEND_CPU) {
+        return marchingCubesCpu(nx, ny, nz, isoLevel, cartesianGrid);
+    }
+
     // Use a lock, as the OpenCL queue isn't multi-threaded and we don't need to handle multiple requests at once.
     std::lock_guard<std::mutex> lock(mcMutex);
 
-    // Used for setting buffers to zero.
-    uint32_t zeroUint = 0u;
+    CartesianGridGeometry geometry(glm::vec3(0.0f), 0.0f, 0.0f, 0.0f, nx, ny, nz);
+    prepareKernelSpecialization(geometry);
+    return marchingCubesHostGrid(geometry, isoLevel, cartesianGrid, false, indexedOutput);
+}
+
+/**
+ * Uses the marching cubes algorithm to compute the iso surface of a scalar field approximated by a Cartesian grid with
+ * implicit geometry (i.e. only the scalar values are stored and transferred to the device).
+ * @param geometry The geometry of the Cartesian grid.
+ * @param isoLevel The iso level of the iso surface to construct.
+ * @param scalarField The scalar values at the grid points (geometry.getNumPoints() values).
+ * @param indexedOutput Whether to create an indexed mesh instead of a triangle soup.
+ * @param engine The algorithm to use.
+ * @return The triangle mesh of the iso surface.
+ */
+TriangleMesh MarchingCubesImpl::marchingCubesImplicit(const CartesianGridGeometry &geometry, float isoLevel,
+        const float *scalarField, bool indexedOutput, ExtractionEngine engine)
+{
+    if (useFlyingEdges(engine, indexedOutput)) {
+        return convertFlyingEdgesMesh(flyingEdges(geometry, isoLevel, scalarField), indexedOutput);
+    }
+    if (backend == BACKEND_CPU) {
+        return marchingCubesCpu(geometry, isoLevel, scalarField);
+    }
+
+    std::lock_guard<std::mutex> lock(mcMutex);
+    prepareKernelSpecialization(geometry);
+    return marchingCubesHostGrid(geometry, isoLevel, scalarField, true, indexedOutput);
+}
+
+/**
+ * Runs the marching cubes algorithm on a Cartesian grid on the host. Large grids are split across all devices (see
+ * marchingCubesMultiDevice). On a single device, they are uploaded in a pipeline (see marchingCubesPipelined) or, if
+ * they don't fit into the memory budget, processed in bricks (see marchingCubesBricked).
+ * @param geometry The geometry of the grid (only the size is used for grids with explicit geometry).
+ * @param isoLevel The iso level of the iso surface to construct.
+ * @param cartesianGrid The grid on the host (see marchingCubesBuffer for the layout).
+ * @param implicitGeometry Whether the grid has implicit geometry, i.e. only stores the scalar values.
+ * @param indexedOutput Whether to create an indexed mesh instead of a triangle soup.
+ * @return The triangle mesh of the iso surface.
+ */
+TriangleMesh MarchingCubesImpl::marchingCubesHostGrid(const CartesianGridGeometry &geometry, float isoLevel,
+        const void *cartesianGrid, bool implicitGeometry, bool indexedOutput)
+{
+    if (useMultipleDevices(geometry)) {
+        return marchingCubesMultiDevice(geometry, isoLevel, cartesianGrid, implicitGeometry, NULL, indexedOutput);
+    }
+
+    ComputeDevice &device = *computeDevices.front();
+    const size_t pointSize = implicitGeometry ? sizeof(float) : sizeof(CartesianGridCorner);
+    uint32_t slabNumCells = getPipelineSlabNumCells(device, geometry, pointSize, indexedOutput);
+    if (slabNumCells != 0) {
+        return marchingCubesPipelined(device, geometry, isoLevel, cartesianGrid, implicitGeometry, slabNumCells);
+    }
+    uint32_t brickNumCells = getBrickNumCells(device, geometry);
+    if (brickNumCells != 0) {
+        return marchingCubesBricked(device, geometry, isoLevel, cartesianGrid, implicitGeometry, NULL, indexedOutput,
+                brickNumCells, 0, geometry.nz - 1, NULL);
+    }
+    PooledBuffer cartesianGridBuffer = createInputBuffer(device, cartesianGrid, pointSize * geometry.getNumPoints());
+    return marchingCubesBuffer(device, geometry, isoLevel, cartesianGridBuffer, implicitGeometry, indexedOutput);
+}
+
+/**
+ * Returns the kernel sampling the passed scalar field function. The OpenCL C code is generated from the CindyScript
+ * program and built on first use. The program and its kernel are stored in the cached scalar field for subsequent
+ * requests.
+ * @param scalarField The compiled CindyScript scalar field function.
+ * @param kernel The kernel sampling the scalar field.
+ * @return False if the generated program couldn't be built.
+ */
+bool MarchingCubesImpl::getScalarFieldKernel(CompiledScalarField &scalarField, cl::Kernel &kernel)
+{
+    if (scalarField.clProgramFailed) {
+        return false;
+    }
+    if (!scalarField.clProgramBuilt) {
+        try {
+            std::string source = translateProgramToOpenCLCdy(scalarField.program);
+            scalarField.clProgram = CLInterface::get()->loadProgramFromSourceString(source);
+            scalarField.clKernel = cl::Kernel(scalarField.clProgram, CDY_SCALAR_FIELD_KERNEL_NAME);
+            scalarField.clProgramBuilt = true;
+        } catch (cl::Error &error) {
+            scalarField.clProgramFailed = true;
+            return false;
+        }
+    }
+    kernel = scalarField.clKernel;
+    return true;
+}
+
+/**
+ * Uses the marching cubes algorithm to compute the iso surface of a scalar field given as a CindyScript function.
+ * The scalar field is sampled directly on the device, i.e. the Cartesian grid is neither constructed on the host nor
+ * transferred to the device.
+ * @param geometry The geometry of the Cartesian grid.
+ * @param isoLevel The iso level of the iso surface to construct.
+ * @param scalarField The scalar field function (see ScalarFieldCache).
+ * @param variables The values of the free variables in the function.
+ * @param indexedOutput Whether to create an indexed mesh instead of a triangle soup.
+ * @param engine The algorithm to use.
+ * @return The triangle mesh of the iso surface.
+ */
+TriangleMesh MarchingCubesImpl::marchingCubesScalarField(const CartesianGridGeometry &geometry,
+        float isoLevel, CompiledScalarField &scalarField, const std::map<std::string, float> &variables,
+        bool indexedOutput, ExtractionEngine engine)
+{
+    // The CPU implementations sample the scalar field on the host.
+    if (useFlyingEdges(engine, indexedOutput) || backend == BACKEND_CPU) {
+        std::vector<float> hostScalarField = constructCartesianGridScalarField(
+                geometry, isoLevel, scalarField.program, variables);
+        if (useFlyingEdges(engine, indexedOutput)) {
+            return convertFlyingEdgesMesh(flyingEdges(geometry, isoLevel, &hostScalarField.front()), indexedOutput);
+        }
+        return marchingCubesCpu(geometry, isoLevel, &hostScalarField.front());
+    }
+
+    std::lock_guard<std::mutex> lock(mcMutex);
+    prepareKernelSpecialization(geometry);
+    const CdyProgram &program = scalarField.program;
+
+    ScalarFieldSampler sampler;
+    if (!getScalarFieldKernel(scalarField, sampler.kernel)) {
+        std::cerr << "Couldn't build the scalar field kernel. Falling back to sampling on the host." << std::endl;
+        std::vector<float> hostScalarField = constructCartesianGridScalarField(geometry, isoLevel, program, variables);
+        return marchingCubesHostGrid(geometry, isoLevel, &hostScalarField.front(), true, indexedOutput);
+    }
+
+    // The values of the variable register slots of the program.
+    std::vector<float> registers;
+    program.initializeRegisters(registers, variables);
+    sampler.variablesBuffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+            sizeof(float) * program.getNumVariables(), (void *)&registers.front());
+
+    // Blocks that can't contain the iso surface are culled on the host using interval arithmetic. The program is
+    // specialized for the variable values first, as this gives tighter intervals.
+    CdyProgram specializedProgram = program;
+    optimizeProgramCdy(specializedProgram, &variables);
+    glm::uvec3 numBlocks(0);
+    std::vector<float> blockValues = computeCulledBlocks(
+            geometry, isoLevel, specializedProgram, variables, numBlocks);
+    if (blockValues.empty()) {
+        numBlocks = glm::uvec3(0);
+        blockValues.push_back(0.0f); // OpenCL buffers must not be empty.
+    }
+    sampler.blockValuesBuffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+            sizeof(float) * blockValues.size(), (void *)&blockValues.front());
+    sampler.numBlocks = numBlocks;
+    sampler.program = scalarField.clProgram;
 
-    // The buffers containing the Cartesian grid data and the vertex counter.
-    cl::Buffer cartesianGridBuffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-            sizeof(CartesianGridCorner) * nx*nx*nx, (void *)&cartesianGrid.front());
-    cl::Buffer vertexCounterBuffer = cl::Buffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
-            sizeof(uint32_t), (void *)&zeroUint);
+    if (useMultipleDevices(geometry)) {
+        return marchingCubesMultiDevice(geometry, isoLevel, NULL, true, &sampler, indexedOutput);
+    }
+
+    // Grids not fitting into the memory budget are sampled brick by brick and never exist as a whole.
+    ComputeDevice &device = *computeDevices.front();
+    uint32_t brickNumCells = getBrickNumCells(device, geometry);
+    if (brickNumCells != 0) {
+        return marchingCubesBricked(device, geometry, isoLevel, NULL, true, &sampler, indexedOutput, brickNumCells,
+                0, geometry.nz - 1, NULL);
+    }
+    PooledBuffer scalarFieldBuffer = device.bufferPool.acquire(sizeof(float) * geometry.getNumPoints());
+    sampleScalarField(device, sampler, geometry, 0, scalarFieldBuffer);
+    return marchingCubesBuffer(device, geometry, isoLevel, scalarFieldBuffer, true, indexedOutput);
+}
+
+/**
+ * Samples a scalar field function on (a brick of) a Cartesian grid on the device.
+ * @param device The device to use.
+ * @param sampler The kernel and its arguments (see marchingCubesScalarField).
+ * @param geometry The geometry of the brick, where the origin is the one of the whole grid.
+ * @param offsetZ The index of the first grid point layer of the brick in the whole grid.
+ * @param scalarFieldBuffer The buffer to store the scalar values in.
+ */
+void MarchingCubesImpl::sampleScalarField(ComputeDevice &device, ScalarFieldSampler &sampler,
+        const CartesianGridGeometry &geometry, uint32_t offsetZ, cl::Buffer &scalarFieldBuffer)
+{
+    const glm::vec3 &origin = geometry.origin;
+    const uint32_t nx = geometry.nx, ny = geometry.ny, nz = geometry.nz;
+    // The sampler is compiled from user code, so it may support smaller work groups than the marching cubes kernels.
+    const cl::NDRange localWorkSize = ComputeKernels::fitWorkGroupSize(device.LOCAL_WORK_SIZE,
+            ComputeKernels::getKernelWorkGroupSize(sampler.kernel, device.device,
+            device.device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>()));
+    cl::EnqueueArgs eargs(device.queue, cl::NullRange,
+            CLInterface::get()->rangePadding3D(nx, ny, nz, localWorkSize), localWorkSize);
+    auto sampleScalarFieldFunctor = cl::KernelFunctor<cl::Buffer, cl::Buffer, float, float, float, float, float, float,
+            unsigned int, unsigned int, unsigned int, cl::Buffer, unsigned int, unsigned int, unsigned int,
+            unsigned int>(sampler.kernel);
+    sampleScalarFieldFunctor(eargs, scalarFieldBuffer, sampler.variablesBuffer, origin.x, origin.y, origin.z,
+            geometry.dx, geometry.dy, geometry.dz, nx, ny, nz, sampler.blockValuesBuffer,
+            sampler.numBlocks.x, sampler.numBlocks.y, sampler.numBlocks.z, offsetZ);
+}
+
+/**
+ * Runs the marching cubes kernels on a Cartesian grid stored on the device.
+ * @param device The device to use.
+ * @param geometry The geometry of the grid (only the size is used for grids with explicit geometry).
+ * @param isoLevel The iso level of the iso surface to construct.
+ * @param cartesianGridBuffer The Cartesian grid (i.e. the grid points and the scalar values in a float4 array, or only
+ * the scalar values in a float array for grids with implicit geometry).
+ * @param implicitGeometry Whether the grid has implicit geometry, i.e. the buffer doesn't store the grid points.
+ * @param indexedOutput Whether to create an indexed mesh instead of a triangle soup.
+ * @return The triangle mesh of the iso surface.
+ */
+TriangleMesh MarchingCubesImpl::marchingCubesBuffer(ComputeDevice &device, const CartesianGridGeometry &geometry,
+        float isoLevel, cl::Buffer &cartesianGridBuffer, bool implicitGeometry, bool indexedOutput)
+{
+    if (indexedOutput) {
+        return marchingCubesBufferIndexed(device, geometry, isoLevel, cartesianGridBuffer, implicitGeometry, 0, NULL);
+    }
+
+    const size_t numCells = size_t(geometry.nx - 1) * size_t(geometry.ny - 1) * size_t(geometry.nz - 1);
+    PooledBuffer vertexBuffer;
+    uint32_t numVertices = generateTriangles(device, geometry, isoLevel, cartesianGridBuffer, implicitGeometry,
+            useHistoPyramid(numCells), 0, vertexBuffer);
+
+    TriangleMesh mesh(false);
+    if (numVertices == 0) {
+        std::cout << "Mesh empty." << std::endl;
+        return mesh;
+    }
+    mesh.vertices = readVertices(device, vertexBuffer, numVertices);
+    return mesh;
+}
+
+/**
+ * Returns whether the second pass uses a HistoPyramid (see ActiveCellTraversal).
+ * @param numCells The number of cells of the grid.
+ */
+bool MarchingCubesImpl::useHistoPyramid(size_t numCells)
+{
+    return activeCellTraversal == TRAVERSAL_HISTOPYRAMID
+            || (activeCellTraversal == TRAVERSAL_AUTO && numCells >= HISTOPYRAMID_MIN_NUM_CELLS);
+}
+
+/**
+ * Runs both passes of the marching cubes algorithm on a Cartesian grid stored on the device. The triangles are
+ * generated in the order of the cells.
+ * @param device The device to use.
+ * @param geometry The geometry of the grid (only the size is used for grids with explicit geometry).
+ * @param isoLevel The iso level of the iso surface to construct.
+ * @param cartesianGridBuffer The Cartesian grid (see marchingCubesBuffer).
+ * @param implicitGeometry Whether the grid has implicit geometry.
+ * @param histoPyramid Whether to traverse the active cells using a HistoPyramid instead of a compacted list.
+ * @param offsetZ The index of the first grid point layer of the buffer in the whole grid (see marchingCubesBricked).
+ * @param vertexBuffer The buffer storing the generated triangle vertices (only created if there are any).
+ * @return The number of generated triangle vertices.
+ */
+uint32_t MarchingCubesImpl::generateTriangles(ComputeDevice &device, const CartesianGridGeometry &geometry,
+        float isoLevel, cl::Buffer &cartesianGridBuffer, bool implicitGeometry, bool histoPyramid, uint32_t offsetZ,
+        PooledBuffer &vertexBuffer)
+{
+    ComputeKernels &kernels = getKernels(device, geometry);
+    const uint32_t nx = geometry.nx, ny = geometry.ny, nz = geometry.nz;
+    const uint32_t numCells = (nx-1) * (ny-1) * (nz-1);
+
+    // Per cell: Whether the cell is active and the number of triangle vertices it generates.
+    PooledBuffer cellCountsBuffer = device.bufferPool.acquire(sizeof(glm::uvec2) * numCells);
+    // Per cell: The marching cubes case, so the second pass only needs to load the corners of the crossing edges.
+    PooledBuffer cubeIndicesBuffer = device.bufferPool.acquire(sizeof(uint8_t) * numCells);
 
     // The enqueue args specify the local and global work size. The global work size is paddes so that it is a multiple
     // of the local work size.
-    cl::EnqueueArgs eargs(queue, cl::NullRange, CLInterface::get()->rangePadding3D(nx-1, nx-1, nx-1, LOCAL_WORK_SIZE),
-            LOCAL_WORK_SIZE);
+    const cl::NDRange &localWorkSize = kernels.localWorkSizes[PASS_CLASSIFY_CELLS];
+    cl::EnqueueArgs eargs(device.queue, cl::NullRange,
+            CLInterface::get()->rangePadding3D(nx-1, ny-1, nz-1, localWorkSize), localWorkSize);
 
-    // The kernel used for computing the number of vertices that get generated in a first pass.
-    auto computeNumVertices = cl::KernelFunctor<cl::Buffer, cl::Buffer, unsigned int, float>(
-            cl::Kernel(computeProgram, "computeNumVertices"));
-    computeNumVertices(eargs, cartesianGridBuffer, vertexCounterBuffer, nx, isoLevel);
+    // In a first pass, compute the number of vertices every cell generates.
+    classifyCells(device, kernels, eargs, cartesianGridBuffer, implicitGeometry, cellCountsBuffer, cubeIndicesBuffer,
+            geometry, isoLevel);
 
-    // Read the number of vertices that get created.
-    uint32_t numVertices = 0;
-    queue.enqueueReadBuffer(vertexCounterBuffer, CL_FALSE, 0, sizeof(uint32_t), (void *)&numVertices);
-    queue.finish();
+    // In a second pass, generate the triangles of the active cells.
+    if (histoPyramid) {
+        return generateTrianglesHistoPyramid(device, geometry, isoLevel, cartesianGridBuffer, implicitGeometry,
+                offsetZ, cellCountsBuffer, cubeIndicesBuffer, vertexBuffer);
+    }
+    return generateTrianglesPrefixSum(device, geometry, isoLevel, cartesianGridBuffer, implicitGeometry,
+            offsetZ, cellCountsBuffer, cubeIndicesBuffer, vertexBuffer);
+}
 
-    // Reset the counter to zero for the next pass (where we will reuse it).
-    queue.enqueueWriteBuffer(vertexCounterBuffer, CL_FALSE, 0, sizeof(uint32_t), (void *)&zeroUint);
-    queue.finish();
+/**
+ * Returns the number of cell layers per slab if a grid on the host is processed in a pipeline (see
+ * marchingCubesPipelined), or 0 if the grid is uploaded at once.
+ * @param device The device to use.
+ * @param geometry The geometry of the grid.
+ * @param pointSize The size of the data of one grid point in bytes.
+ * @param indexedOutput Whether to create an indexed mesh.
+ */
+uint32_t MarchingCubesImpl::getPipelineSlabNumCells(ComputeDevice &device, const CartesianGridGeometry &geometry,
+        size_t pointSize, bool indexedOutput)
+{
+    // Devices sharing the memory with the host read the grid in place. Indexed meshes are created at once, as the
+    // vertices on the boundaries of the slabs would otherwise be generated twice.
+    if (device.hostUnifiedMemory || indexedOutput || geometry.nz < 3) {
+        return 0;
+    }
+    size_t planeNumPoints = size_t(geometry.nx) * size_t(geometry.ny);
+    size_t budgetNumCells = std::max(device.maxBrickNumPoints / planeNumPoints, size_t(2)) - 1;
+    size_t slabNumCells = std::max(std::min(PIPELINE_SLAB_SIZE / (pointSize * planeNumPoints), budgetNumCells),
+            size_t(1));
+    return slabNumCells < geometry.nz - 1 ? uint32_t(slabNumCells) : 0;
+}
 
-    if (numVertices == 0) {
+/**
+ * Returns the number of cell layers per brick if a grid doesn't fit into the memory budget (see marchingCubesBricked),
+ * or 0 if the grid is processed at once.
+ * @param device The device to use.
+ * @param geometry The geometry of the grid.
+ */
+uint32_t MarchingCubesImpl::getBrickNumCells(ComputeDevice &device, const CartesianGridGeometry &geometry)
+{
+    if (geometry.getNumPoints() <= device.maxBrickNumPoints || geometry.nz < 3) {
+        return 0;
+    }
+    // A brick has one more grid point layer than cell layers, and at least one cell layer.
+    size_t planeNumPoints = size_t(geometry.nx) * size_t(geometry.ny);
+    return uint32_t(std::max(device.maxBrickNumPoints / planeNumPoints, size_t(2)) - 1);
+}
+
+/**
+ * Matches the vertices on the first layer of a brick with the vertices on the last layer of the previous brick by their
+ * owning grid point and edge direction. The positions aren't compared, as devices may compute the same vertex a few
+ * ulps apart (e.g. due to the division in vertexInterpIso or contracted multiply-adds), and distinct vertices may have
+ * the same position. The vertices of a layer are ordered by their owning grid point and then by the direction of
+ * their edge (see generateIndexedMesh), so the edge masks of the layer give the index of every vertex. Only the edges
+ * in x and y direction lie on the layer; the vertices on edges in z direction belong to one brick only.
+ * @param lastLayerEdgeMasks The edge masks of the last layer of the previous brick.
+ * @param firstLastLayerVertex The index of the first vertex on the last layer of the previous brick in the mesh.
+ * @param seams The seams of the brick.
+ * @return For every vertex on the first layer of the brick: The index of the same vertex in the mesh, or
+ * TriangleMesh::NOT_SHARED (see TriangleMesh::appendWelded).
+ */
+static std::vector<uint32_t> matchSeamVertices(const std::vector<uint8_t> &lastLayerEdgeMasks,
+        uint32_t firstLastLayerVertex, const BrickSeams &seams)
+{
+    std::vector<uint32_t> sharedVertices(seams.numFirstLayerVertices, TriangleMesh::NOT_SHARED);
+    if (lastLayerEdgeMasks.size() != seams.firstLayerEdgeMasks.size()) {
+        return sharedVertices;
+    }
+    uint32_t previousVertex = firstLastLayerVertex, vertex = 0;
+    for (size_t i = 0; i < lastLayerEdgeMasks.size(); i++) {
+        const uint8_t previousEdgeMask = lastLayerEdgeMasks[i], edgeMask = seams.firstLayerEdgeMasks[i];
+        for (uint32_t direction = 0; direction < 3; direction++) {
+            const bool previousCrossing = (previousEdgeMask & (1u << direction)) != 0;
+            const bool crossing = (edgeMask & (1u << direction)) != 0;
+            if (crossing && previousCrossing && direction < 2 && vertex < sharedVertices.size()) {
+                sharedVertices[vertex] = previousVertex;
+            }
+            previousVertex += previousCrossing ? 1 : 0;
+            vertex += crossing ? 1 : 0;
+        }
+    }
+    return sharedVertices;
+}
+
+/**
+ * Appends the indexed mesh of a brick to the mesh of the previous bricks and merges the vertices on the shared layer
+ * (see matchSeamVertices).
+ * @param mesh The mesh of the previous bricks.
+ * @param brickMesh The mesh of the brick.
+ * @param brickSeams The seams of the brick. The edge masks of its last layer are moved to lastLayerEdgeMasks.
+ * @param firstBrick Whether the brick is the first one, i.e. doesn't share a layer with a previous brick.
+ * @param firstSharedVertex The first vertex of the mesh on the last layer of the previous brick (updated).
+ * @param lastLayerEdgeMasks The edge masks of the last layer of the previous brick (updated).
+ */
+static void appendBrickMesh(TriangleMesh &mesh, const TriangleMesh &brickMesh, BrickSeams &brickSeams,
+        bool firstBrick, size_t &firstSharedVertex, std::vector<uint8_t> &lastLayerEdgeMasks)
+{
+    mesh.appendWelded(brickMesh, firstBrick ? std::vector<uint32_t>() : matchSeamVertices(
+            lastLayerEdgeMasks, uint32_t(firstSharedVertex), brickSeams));
+    firstSharedVertex = mesh.vertices.size() - (brickMesh.vertices.size() - brickSeams.firstLastLayerVertex);
+    lastLayerEdgeMasks.swap(brickSeams.lastLayerEdgeMasks);
+}
+
+/**
+ * Uses the marching cubes algorithm to compute the iso surface of a Cartesian grid not fitting into the memory budget.
+ * The grid is split into bricks of cell layers in z direction, where adjacent bricks share one layer of grid points
+ * (a ghost layer). Every brick is uploaded or sampled and extracted on its own. Scalar field functions are sampled
+ * brick by brick on the device, and grids streamed by the client arrive brick by brick (see extractStreamedBrick), so
+ * neither exists as a whole.
+ * The implicit geometry kernels reconstruct the grid point positions from the index in the whole grid, so both bricks
+ * compute the same vertices on their shared layer and the seams don't have cracks. For indexed meshes, the vertices on
+ * a shared layer are created by both bricks and merged by their owning grid point and edge when stitching the bricks
+ * (see matchSeamVertices).
+ * @param device The device to use.
+ * @param geometry The geometry of the grid (only the size is used for grids with explicit geometry).
+ * @param isoLevel The iso level of the iso surface to construct.
+ * @param cartesianGrid The grid point layers [zBegin, zEnd] on the host (see marchingCubesBuffer for the layout), or
+ * NULL if sampler is used.
+ * @param implicitGeometry Whether the grid has implicit geometry, i.e. only stores the scalar values.
+ * @param sampler If not NULL, the bricks are sampled from a scalar field function on the device.
+ * @param indexedOutput Whether to create an indexed mesh instead of a triangle soup.
+ * @param brickNumCells The number of cell layers per brick (see getBrickNumCells).
+ * @param zBegin The index of the first cell layer to process.
+ * @param zEnd The index after the last cell layer to process.
+ * @param seams If not NULL, the vertices of the indexed mesh on the first and last grid point layer of the range are
+ * stored in it, and empty meshes aren't reported (as the range is only a part of the grid).
+ * @return The triangle mesh of the iso surface.
+ */
+TriangleMesh MarchingCubesImpl::marchingCubesBricked(ComputeDevice &device, const CartesianGridGeometry &geometry,
+        float isoLevel, const void *cartesianGrid, bool implicitGeometry, ScalarFieldSampler *sampler,
+        bool indexedOutput, uint32_t brickNumCells, uint32_t zBegin, uint32_t zEnd, BrickSeams *seams)
+{
+    const size_t pointSize = implicitGeometry ? sizeof(float) : sizeof(CartesianGridCorner);
+    const size_t planeSize = pointSize * geometry.nx * geometry.ny;
+    const uint32_t numCellLayers = geometry.nz - 1;
+    const uint32_t numBricks = (zEnd - zBegin - 1) / brickNumCells + 1;
+    const bool histoPyramid = useHistoPyramid(
+            size_t(geometry.nx - 1) * size_t(geometry.ny - 1) * size_t(numCellLayers));
+
+    TriangleMesh mesh(indexedOutput);
+    size_t firstSharedVertex = 0; // The first vertex of the mesh on the last layer of the previous brick
+    std::vector<uint8_t> lastLayerEdgeMasks; // The edge masks of the last layer of the previous brick
+    for (uint32_t k = 0; k < numBricks; k++) {
+        const uint32_t z0 = zBegin + k * brickNumCells;
+        CartesianGridGeometry brickGeometry = geometry;
+        brickGeometry.nz = std::min(brickNumCells, zEnd - z0) + 1;
+
+        PooledBuffer brickBuffer;
+        if (sampler != NULL) {
+            brickBuffer = device.bufferPool.acquire(sizeof(float) * brickGeometry.getNumPoints());
+            sampleScalarField(device, *sampler, brickGeometry, z0, brickBuffer);
+        } else {
+            brickBuffer = createInputBuffer(device, (const uint8_t*)cartesianGrid + planeSize * (z0 - zBegin),
+                    planeSize * brickGeometry.nz);
+        }
+
+        if (indexedOutput) {
+            BrickSeams brickSeams;
+            TriangleMesh brickMesh = marchingCubesBufferIndexed(
+                    device, brickGeometry, isoLevel, brickBuffer, implicitGeometry, z0, &brickSeams);
+            appendBrickMesh(mesh, brickMesh, brickSeams, k == 0, firstSharedVertex, lastLayerEdgeMasks);
+            if (k == 0 && seams != NULL) {
+                seams->numFirstLayerVertices = brickSeams.numFirstLayerVertices;
+                seams->firstLayerEdgeMasks.swap(brickSeams.firstLayerEdgeMasks);
+            }
+        } else {
+            PooledBuffer vertexBuffer;
+            uint32_t numVertices = generateTriangles(
+                    device, brickGeometry, isoLevel, brickBuffer, implicitGeometry, histoPyramid, z0, vertexBuffer);
+            if (numVertices > 0) {
+                std::vector<glm::vec3> brickVertices = readVertices(device, vertexBuffer, numVertices);
+                mesh.vertices.insert(mesh.vertices.end(), brickVertices.begin(), brickVertices.end());
+            }
+        }
+    }
+
+    if (seams != NULL) {
+        seams->firstLastLayerVertex = uint32_t(firstSharedVertex);
+        seams->lastLayerEdgeMasks.swap(lastLayerEdgeMasks);
+    } else if (mesh.vertices.empty()) {
         std::cout << "Mesh empty." << std::endl;
-        return {};
     }
+    return mesh;
+}
 
-    // Create a vertex buffer large enough for storing all vertices that get generated by the MC algorithm.
-    cl::Buffer vertexBuffer = cl::Buffer(context, CL_MEM_WRITE_ONLY, sizeof(glm::vec4) * numVertices);
+/**
+ * Extracts the iso surface of the next brick of a grid streamed by the client (see BINARY_REQUEST_FLAG_STREAMED).
+ * Consecutive bricks share one grid point layer (the ghost layer) like the bricks of marchingCubesBricked, which
+ * processes every streamed brick (and splits it further if it doesn't fit into the memory budget). The indexed meshes
+ * of consecutive bricks are stitched by their shared vertices like in marchingCubesBricked. Streamed bricks are
+ * always processed on the first device, as the next brick only arrives after the current one was extracted.
+ * @param extraction The state of the extraction.
+ * @param zBegin The first grid point layer of the brick (0 or the last layer of the previous brick).
+ * @param numLayers The number of grid point layers of the brick (at least 2).
+ * @param brickGrid The grid points of the brick on the host (see marchingCubesBuffer for the layout).
+ * @return False if the brick doesn't continue the previous one or the OpenCL backend isn't used.
+ */
+bool MarchingCubesImpl::extractStreamedBrick(StreamedExtraction &extraction, uint32_t zBegin, uint32_t numLayers,
+        const void *brickGrid)
+{
+    const CartesianGridGeometry &geometry = extraction.geometry;
+    if (backend != BACKEND_OPENCL) {
+        std::cerr << "Streamed grids need the OpenCL backend." << std::endl;
+        return false;
+    }
+    if (zBegin != extraction.nextZ || numLayers < 2 || numLayers > geometry.nz - zBegin) {
+        std::cerr << "Invalid brick [" << zBegin << ", " << size_t(zBegin) + numLayers << ") of a streamed grid "
+                << "(expected a brick starting at layer " << extraction.nextZ << ")." << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mcMutex);
+    if (zBegin == 0) {
+        prepareKernelSpecialization(geometry);
+    }
+    ComputeDevice &device = *computeDevices.front();
+    CartesianGridGeometry brickGeometry = geometry;
+    brickGeometry.nz = numLayers;
+    uint32_t brickNumCells = getBrickNumCells(device, brickGeometry);
+    if (brickNumCells == 0) {
+        brickNumCells = numLayers - 1;
+    }
+    const uint32_t zEnd = zBegin + numLayers - 1;
+    BrickSeams brickSeams;
+    TriangleMesh brickMesh = marchingCubesBricked(device, geometry, extraction.isoLevel, brickGrid,
+            extraction.implicitGeometry, NULL, extraction.mesh.indexed, brickNumCells, zBegin, zEnd, &brickSeams);
+    if (extraction.mesh.indexed) {
+        appendBrickMesh(extraction.mesh, brickMesh, brickSeams, zBegin == 0, extraction.firstSharedVertex,
+                extraction.lastLayerEdgeMasks);
+    } else {
+        extraction.mesh.vertices.insert(extraction.mesh.vertices.end(), brickMesh.vertices.begin(),
+                brickMesh.vertices.end());
+    }
+    extraction.nextZ = zEnd;
+    return true;
+}
 
-    // Finally, launch the marching cubes algorithm.
-    auto marchingCubes = cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer, unsigned int, float>(
-            cl::Kernel(computeProgram, "marchingCubes"));
-    marchingCubes(eargs, cartesianGridBuffer, vertexBuffer, vertexCounterBuffer, nx, isoLevel);
+/**
+ * Returns whether a grid is split across all devices of the context (see marchingCubesMultiDevice). Small grids are
+ * processed on the first device, as the split only pays off if the kernels dominate the setup costs.
+ * @param geometry The geometry of the grid.
+ */
+bool MarchingCubesImpl::useMultipleDevices(const CartesianGridGeometry &geometry)
+{
+    const size_t numCells = size_t(geometry.nx - 1) * size_t(geometry.ny - 1) * size_t(geometry.nz - 1);
+    return computeDevices.size() > 1 && geometry.nz - 1 >= computeDevices.size()
+            && numCells >= MULTI_DEVICE_MIN_NUM_CELLS;
+}
 
-    // Now, read the triangle vertices from the buffer on the GPU. On the GPU, float3 arrays get padded to float4
-    // arrays. Thus, we directly use float4 arrays in OpenCL for the vertices and convert them to vec3 arrays for use
-    // in our application.
+/**
+ * Uses the marching cubes algorithm to compute the iso surface of a large Cartesian grid on all devices of the context.
+ * The cell layers are split into one contiguous range in z direction per device, where adjacent ranges share one layer
+ * of grid points like bricks (see marchingCubesBricked). The ranges are proportional to the throughput of the devices
+ * measured in past requests (or estimated from their compute units and clock frequencies before the first request).
+ * Each device processes its range on its own queues in a separate thread. The meshes of the ranges are merged in z
+ * order, so the triangles are ordered like on a single device.
+ * @param geometry The geometry of the grid (only the size is used for grids with explicit geometry).
+ * @param isoLevel The iso level of the iso surface to construct.
+ * @param cartesianGrid The grid on the host (see marchingCubesBuffer for the layout), or NULL if sampler is used.
+ * @param implicitGeometry Whether the grid has implicit geometry, i.e. only stores the scalar values.
+ * @param sampler If not NULL, the grid is sampled from a scalar field function on the devices.
+ * @param indexedOutput Whether to create an indexed mesh instead of a triangle soup.
+ * @return The triangle mesh of the iso surface.
+ */
+TriangleMesh MarchingCubesImpl::marchingCubesMultiDevice(const CartesianGridGeometry &geometry, float isoLevel,
+        const void *cartesianGrid, bool implicitGeometry, ScalarFieldSampler *sampler, bool indexedOutput)
+{
+    const size_t numDevices = computeDevices.size();
+    const uint32_t numCellLayers = geometry.nz - 1;
+
+    // The estimates are only used until all devices were measured, as they aren't comparable to measured throughputs.
+    bool measured = true;
+    for (std::unique_ptr<ComputeDevice> &device : computeDevices) {
+        measured = measured && device->throughput > 0.0;
+    }
+    std::vector<double> weights(numDevices);
+    double weightSum = 0.0;
+    for (size_t i = 0; i < numDevices; i++) {
+        weights.at(i) = measured ? computeDevices.at(i)->throughput : computeDevices.at(i)->estimatedThroughput;
+        weightSum += weights.at(i);
+    }
+
+    // Every device gets at least one cell layer, the last one gets the remaining layers.
+    std::vector<DeviceRange> ranges(numDevices);
+    double cumulativeWeight = 0.0;
+    uint32_t z = 0;
+    for (size_t i = 0; i < numDevices; i++) {
+        cumulativeWeight += weights.at(i);
+        uint32_t zEnd = uint32_t(double(numCellLayers) * cumulativeWeight / weightSum + 0.5);
+        zEnd = std::max(zEnd, z + 1);
+        zEnd = std::min(zEnd, numCellLayers - uint32_t(numDevices - i - 1));
+        if (i == numDevices - 1) {
+            zEnd = numCellLayers;
+        }
+        ranges.at(i).zBegin = z;
+        ranges.at(i).zEnd = zEnd;
+        if (sampler != NULL) {
+            ranges.at(i).hasSampler = true;
+            ranges.at(i).sampler = *sampler;
+            if (i != 0) {
+                // Kernel objects must not be used by multiple threads at once.
+                ranges.at(i).sampler.kernel = cl::Kernel(sampler->program, CDY_SCALAR_FIELD_KERNEL_NAME);
+            }
+        }
+        z = zEnd;
+    }
+
+    // The first device is driven by this thread.
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < numDevices; i++) {
+        threads.push_back(std::thread(&MarchingCubesImpl::extractDeviceRange, this, std::ref(*computeDevices.at(i)),
+                std::cref(geometry), isoLevel, cartesianGrid, implicitGeometry, indexedOutput,
+                std::ref(ranges.at(i))));
+    }
+    extractDeviceRange(*computeDevices.front(), geometry, isoLevel, cartesianGrid, implicitGeometry, indexedOutput,
+            ranges.front());
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    for (DeviceRange &range : ranges) {
+        if (range.error) {
+            std::rethrow_exception(range.error);
+        }
+    }
+
+    TriangleMesh mesh(indexedOutput);
+    size_t firstSharedVertex = 0; // The first vertex of the mesh on the last layer of the previous range
+    std::vector<uint8_t> lastLayerEdgeMasks; // The edge masks of the last layer of the previous range
+    for (size_t i = 0; i < numDevices; i++) {
+        DeviceRange &range = ranges.at(i);
+        if (indexedOutput) {
+            appendBrickMesh(mesh, range.mesh, range.seams, i == 0, firstSharedVertex, lastLayerEdgeMasks);
+        } else {
+            mesh.vertices.insert(mesh.vertices.end(), range.mesh.vertices.begin(), range.mesh.vertices.end());
+        }
+        range.mesh = TriangleMesh();
+    }
+
+    if (mesh.vertices.empty()) {
+        std::cout << "Mesh empty." << std::endl;
+    }
+    return mesh;
+}
+
+/**
+ * Extracts the iso surface of a range of cell layers on one device (see marchingCubesMultiDevice). The range is
+ * processed like bricks, and the measured throughput of the device is updated afterwards.
+ * Exceptions are stored in the range, as this function runs in its own thread.
+ * @param device The device to use.
+ * @param geometry The geometry of the whole grid.
+ * @param isoLevel The iso level of the iso surface to construct.
+ * @param cartesianGrid The whole grid on the host, or NULL if range.sampler is used.
+ * @param implicitGeometry Whether the grid has implicit geometry, i.e. only stores the scalar values.
+ * @param indexedOutput Whether to create an indexed mesh instead of a triangle soup.
+ * @param range The range to process, which receives the mesh and its seams.
+ */
+void MarchingCubesImpl::extractDeviceRange(ComputeDevice &device, const CartesianGridGeometry &geometry,
+        float isoLevel, const void *cartesianGrid, bool implicitGeometry, bool indexedOutput, DeviceRange &range)
+{
+    try {
+        auto startTime = std::chrono::steady_clock::now();
+
+        CartesianGridGeometry rangeGeometry = geometry;
+        rangeGeometry.nz = range.zEnd - range.zBegin + 1;
+        uint32_t brickNumCells = getBrickNumCells(device, rangeGeometry);
+        if (brickNumCells == 0) {
+            brickNumCells = range.zEnd - range.zBegin;
+        }
+        const size_t pointSize = implicitGeometry ? sizeof(float) : sizeof(CartesianGridCorner);
+        const uint8_t *rangeGrid = cartesianGrid == NULL ? NULL : (const uint8_t*)cartesianGrid
+                + pointSize * geometry.nx * geometry.ny * range.zBegin;
+        range.mesh = marchingCubesBricked(device, geometry, isoLevel, rangeGrid, implicitGeometry,
+                range.hasSampler ? &range.sampler : NULL, indexedOutput, brickNumCells, range.zBegin, range.zEnd,
+                &range.seams);
+
+        // The throughput is smoothed over the requests, as single measurements are noisy.
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        double numCells = double(geometry.nx - 1) * double(geometry.ny - 1) * double(range.zEnd - range.zBegin);
+        double throughput = numCells / std::max(seconds, 1e-6);
+        device.throughput = device.throughput > 0.0 ? 0.5 * device.throughput + 0.5 * throughput : throughput;
+    } catch (...) {
+        range.error = std::current_exception();
+    }
+}
+
+/// The state of a slab processed by MarchingCubesImpl::marchingCubesPipelined.
+struct PipelineSlab {
+    PipelineSlab() : z0(0), numCellLayers(0), numVertices(0) {}
+    uint32_t z0;                     ///< The index of the first grid point layer
+    uint32_t numCellLayers;
+    cl::Event uploadEvent;           ///< Signaled when the grid points of the slab are on the device
+    cl::Event computeEvent;          ///< Signaled when all kernels of the slab have finished
+    cl::Event downloadEvent;         ///< Signaled when the vertices of the slab are on the host
+    PooledBuffer vertexBuffer;
+    std::vector<glm::vec4> vertices;
+    uint32_t numVertices;
+};
+
+/**
+ * Uses the marching cubes algorithm to compute the iso surface of a large Cartesian grid on the host. The grid is
+ * split into slabs of cell layers in z direction, where adjacent slabs share one layer of grid points. The slabs flow
+ * through three in-order queues synchronized by events, so that slab k+1 is uploaded and the vertices of slab k-1 are
+ * downloaded while slab k is processed. The triangles are generated in the same order as by marchingCubesBuffer.
+ * @param device The device to use.
+ * @param geometry The geometry of the grid (only the size is used for grids with explicit geometry).
+ * @param isoLevel The iso level of the iso surface to construct.
+ * @param cartesianGrid The grid on the host (see marchingCubesBuffer for the layout).
+ * @param implicitGeometry Whether the grid has implicit geometry, i.e. only stores the scalar values.
+ * @param slabNumCells The number of cell layers per slab (see getPipelineSlabNumCells).
+ * @return The triangle soup of the iso surface.
+ */
+TriangleMesh MarchingCubesImpl::marchingCubesPipelined(ComputeDevice &device, const CartesianGridGeometry &geometry,
+        float isoLevel, const void *cartesianGrid, bool implicitGeometry, uint32_t slabNumCells)
+{
+    const size_t pointSize = implicitGeometry ? sizeof(float) : sizeof(CartesianGridCorner);
+    const size_t planeSize = pointSize * geometry.nx * geometry.ny;
+    const uint32_t numCellLayers = geometry.nz - 1;
+    const uint32_t numSlabs = (numCellLayers - 1) / slabNumCells + 1;
+    // The traversal is selected for the whole grid, as the slabs are smaller than HISTOPYRAMID_MIN_NUM_CELLS.
+    const bool histoPyramid = useHistoPyramid(
+            size_t(geometry.nx - 1) * size_t(geometry.ny - 1) * size_t(numCellLayers));
+
+    std::vector<PipelineSlab> slabs(numSlabs);
+    for (uint32_t k = 0; k < numSlabs; k++) {
+        slabs[k].z0 = k * slabNumCells;
+        slabs[k].numCellLayers = std::min(slabNumCells, numCellLayers - slabs[k].z0);
+    }
+
+    // Slab k is uploaded to stagingBuffers[k % 2]. The buffers are held until all slabs are processed, as buffers
+    // released to the pool may immediately be reused on the compute queue.
+    PooledBuffer stagingBuffers[2];
+    for (int i = 0; i < 2; i++) {
+        stagingBuffers[i] = device.bufferPool.acquire(planeSize * (slabNumCells + 1));
+    }
+
+    TriangleMesh mesh(false);
+    for (uint32_t step = 0; step < numSlabs + 2; step++) {
+        // Upload slab "step" as soon as the kernels of the slab previously using the staging buffer have finished.
+        if (step < numSlabs) {
+            PipelineSlab &slab = slabs[step];
+            std::vector<cl::Event> waitEvents;
+            if (step >= 2) {
+                waitEvents.push_back(slabs[step-2].computeEvent);
+            }
+            device.uploadQueue.enqueueWriteBuffer(stagingBuffers[step % 2], CL_FALSE, 0,
+                    planeSize * (slab.numCellLayers + 1), (const uint8_t*)cartesianGrid + planeSize * slab.z0,
+                    &waitEvents, &slab.uploadEvent);
+            device.uploadQueue.flush();
+        }
+
+        // Process slab step-1. Reading the number of vertices blocks until its first pass has finished.
+        if (step >= 1 && step <= numSlabs) {
+            PipelineSlab &slab = slabs[step-1];
+            CartesianGridGeometry slabGeometry = geometry;
+            slabGeometry.nz = slab.numCellLayers + 1;
+
+            std::vector<cl::Event> uploadEvents(1, slab.uploadEvent);
+            device.queue.enqueueBarrierWithWaitList(&uploadEvents);
+            slab.numVertices = generateTriangles(device, slabGeometry, isoLevel, stagingBuffers[(step-1) % 2],
+                    implicitGeometry, histoPyramid, slab.z0, slab.vertexBuffer);
+            device.queue.enqueueMarkerWithWaitList(NULL, &slab.computeEvent);
+            device.queue.flush();
+
+            if (slab.numVertices > 0) {
+                slab.vertices.resize(slab.numVertices);
+                std::vector<cl::Event> computeEvents(1, slab.computeEvent);
+                device.downloadQueue.enqueueReadBuffer(slab.vertexBuffer, CL_FALSE, 0,
+                        sizeof(glm::vec4) * slab.numVertices, (void *)&slab.vertices.front(),
+                        &computeEvents, &slab.downloadEvent);
+                device.downloadQueue.flush();
+            }
+        }
+
+        // Append the vertices of slab step-2 to the mesh.
+        if (step >= 2) {
+            PipelineSlab &slab = slabs[step-2];
+            if (slab.numVertices > 0) {
+                slab.downloadEvent.wait();
+                size_t offset = mesh.vertices.size();
+                mesh.vertices.resize(offset + slab.numVertices);
+                #pragma omp parallel for
+                for (uint32_t i = 0; i < slab.numVertices; i++) {
+                    const glm::vec4 &vertex = slab.vertices[i];
+                    mesh.vertices[offset + i] = glm::vec3(vertex.x, vertex.y, vertex.z);
+                }
+                std::vector<glm::vec4>().swap(slab.vertices);
+            }
+            slab.vertexBuffer.release();
+        }
+    }
+    device.queue.finish();
+
+    if (mesh.vertices.empty()) {
+        std::cout << "Mesh empty." << std::endl;
+    }
+    return mesh;
+}
+
+/**
+ * Runs the marching cubes kernels with indexed output on a Cartesian grid stored on the device (see the description
+ * of the indexed output in MarchingCubes.cl). Every vertex is only generated once and shared by the adjacent
+ * triangles.
+ * @param device The device to use.
+ * @param geometry The geometry of the grid (only the size is used for grids with explicit geometry).
+ * @param isoLevel The iso level of the iso surface to construct.
+ * @param cartesianGridBuffer The Cartesian grid (see marchingCubesBuffer).
+ * @param implicitGeometry Whether the grid has implicit geometry, i.e. the buffer doesn't store the grid points.
+ * @param offsetZ The index of the first grid point layer of the buffer in the whole grid (see marchingCubesBricked).
+ * @param seams If not NULL, the vertices on the first and last grid point layer are stored here.
+ * @return The indexed triangle mesh of the iso surface.
+ */
+TriangleMesh MarchingCubesImpl::marchingCubesBufferIndexed(ComputeDevice &device, const CartesianGridGeometry &geometry,
+        float isoLevel, cl::Buffer &cartesianGridBuffer, bool implicitGeometry, uint32_t offsetZ, BrickSeams *seams)
+{
+    ComputeKernels &kernels = getKernels(device, geometry);
+    const uint32_t nx = geometry.nx, ny = geometry.ny, nz = geometry.nz;
+    const uint32_t numPoints = geometry.getNumPoints();
+
+    // Per grid point: The number of vertices on its owned edges and the number of indices of the cell at the point (and
+    // after the prefix sum the respective offsets). Additionally, the owned edges crossing the iso surface.
+    PooledBuffer pointOffsetsBuffer = device.bufferPool.acquire(sizeof(glm::uvec2) * numPoints);
+    PooledBuffer edgeMasksBuffer = device.bufferPool.acquire(sizeof(uint8_t) * numPoints);
+    // The marching cubes case of the cell at every grid point, so the second pass doesn't need to load the corners.
+    PooledBuffer cubeIndicesBuffer = device.bufferPool.acquire(sizeof(uint8_t) * numPoints);
+    const cl::NDRange &classifyLocalWorkSize = kernels.localWorkSizes[PASS_CLASSIFY_POINTS];
+    cl::EnqueueArgs eargsClassify(device.queue, cl::NullRange,
+            CLInterface::get()->rangePadding3D(nx, ny, nz, classifyLocalWorkSize), classifyLocalWorkSize);
+
+    classifyPointsIndexed(device, kernels, eargsClassify, cartesianGridBuffer, implicitGeometry, pointOffsetsBuffer,
+            edgeMasksBuffer, cubeIndicesBuffer, geometry, isoLevel);
+
+    glm::uvec2 totalCounts = exclusiveScan(device, pointOffsetsBuffer, numPoints);
+    const uint32_t numVertices = totalCounts.x;
+    const uint32_t numIndices = totalCounts.y;
+
+    // The vertices are ordered by their owning grid point, so the vertices on the first and last layer are contiguous.
+    if (seams != NULL) {
+        glm::uvec2 offsets[2] = { glm::uvec2(numVertices), glm::uvec2(numVertices) };
+        const size_t layerSize = size_t(nx) * size_t(ny);
+        if (nz > 1) {
+            device.queue.enqueueReadBuffer(pointOffsetsBuffer, CL_FALSE, sizeof(glm::uvec2) * layerSize,
+                    sizeof(glm::uvec2), (void *)&offsets[0]);
+            device.queue.enqueueReadBuffer(pointOffsetsBuffer, CL_TRUE, sizeof(glm::uvec2) * layerSize * (nz-1),
+                    sizeof(glm::uvec2), (void *)&offsets[1]);
+        }
+        seams->numFirstLayerVertices = offsets[0].x;
+        seams->firstLastLayerVertex = offsets[1].x;
+
+        // The edge masks identify the vertices on the layers when stitching adjacent bricks (see matchSeamVertices).
+        seams->firstLayerEdgeMasks.resize(layerSize);
+        seams->lastLayerEdgeMasks.resize(layerSize);
+        device.queue.enqueueReadBuffer(edgeMasksBuffer, CL_FALSE, 0, layerSize,
+                (void *)&seams->firstLayerEdgeMasks.front());
+        device.queue.enqueueReadBuffer(edgeMasksBuffer, CL_TRUE, layerSize * (nz-1), layerSize,
+                (void *)&seams->lastLayerEdgeMasks.front());
+    }
+
+    TriangleMesh mesh(true);
+    if (numIndices == 0) {
+        if (seams == NULL) {
+            std::cout << "Mesh empty." << std::endl;
+        }
+        return mesh;
+    }
+
+    PooledBuffer vertexBuffer = device.bufferPool.acquire(sizeof(glm::vec4) * numVertices);
+    PooledBuffer indexBuffer = device.bufferPool.acquire(sizeof(uint32_t) * numIndices);
+    const cl::NDRange &generateLocalWorkSize = kernels.localWorkSizes[PASS_GENERATE_INDEXED_MESH];
+    cl::EnqueueArgs eargs(device.queue, cl::NullRange,
+            CLInterface::get()->rangePadding3D(nx, ny, nz, generateLocalWorkSize), generateLocalWorkSize);
+    const glm::vec3 &origin = geometry.origin;
+    if (implicitGeometry) {
+        kernels.generateIndexedMeshImplicit(eargs, cartesianGridBuffer, pointOffsetsBuffer, edgeMasksBuffer,
+                cubeIndicesBuffer, vertexBuffer, indexBuffer, nx, ny, nz, isoLevel, origin.x, origin.y, origin.z,
+                geometry.dx, geometry.dy, geometry.dz, offsetZ);
+    } else {
+        kernels.generateIndexedMesh(eargs, cartesianGridBuffer, pointOffsetsBuffer, edgeMasksBuffer,
+                cubeIndicesBuffer, vertexBuffer, indexBuffer, nx, ny, nz, isoLevel);
+    }
+
+    mesh.indices.resize(numIndices);
+    device.queue.enqueueReadBuffer(indexBuffer, CL_FALSE, 0, sizeof(uint32_t) * numIndices,
+            (void *)&mesh.indices.front());
+    mesh.vertices = readVertices(device, vertexBuffer, numVertices);
+    return mesh;
+}
+
+/**
+ * Reads the triangle vertices from the buffer on the GPU. On the GPU, float3 arrays get padded to float4 arrays. Thus,
+ * we directly use float4 arrays in OpenCL for the vertices and convert them to vec3 arrays for use in our application.
+ * @param device The device to use.
+ * @param vertexBuffer The vertex buffer on the device.
+ * @param numVertices The number of vertices in the buffer.
+ * @return The vertices.
+ */
+std::vector<glm::vec3> MarchingCubesImpl::readVertices(ComputeDevice &device, cl::Buffer &vertexBuffer,
+        uint32_t numVertices)
+{
     std::vector<glm::vec4> triangleVerticesVec4;
     triangleVerticesVec4.resize(numVertices);
     std::vector<glm::vec3> triangleVertices;
     triangleVertices.resize(numVertices);
-    queue.enqueueReadBuffer(vertexBuffer, CL_FALSE, 0, sizeof(glm::vec4)*numVertices, (void *)&triangleVerticesVec4.front());
-    queue.finish();
+    device.queue.enqueueReadBuffer(vertexBuffer, CL_FALSE, 0, sizeof(glm::vec4)*numVertices,
+            (void *)&triangleVerticesVec4.front());
+    device.queue.finish();
     #pragma omp parallel for
     for (uint32_t i = 0; i < numVertices; i++) {
         glm::vec4 vec4Obj = triangleVerticesVec4.at(i);
@@ -173,4 +1233,227 @@ std::vector<glm::vec3> MarchingCubesImpl::marchingCubes(uint32_t nx, float isoLe
     }
 
     return triangleVertices;
-}
\ No newline at end of file
+}
+
+/**
+ * Generates the triangles of the active cells. The list of active cells is compacted using a prefix sum, and every
+ * active cell is polygonized by one work item.
+ * @param device The device to use.
+ * @param geometry The geometry of the grid.
+ * @param isoLevel The iso level of the iso surface to construct.
+ * @param cartesianGridBuffer The Cartesian grid (see marchingCubesBuffer).
+ * @param implicitGeometry Whether the grid has implicit geometry.
+ * @param offsetZ The index of the first grid point layer of the buffer in the whole grid.
+ * @param cellOffsetsBuffer The cell counts computed by classifyCells. They are replaced by their prefix sum.
+ * @param cubeIndicesBuffer The marching cubes cases computed by classifyCells.
+ * @param vertexBuffer The buffer storing the generated triangle vertices (only created if there are any).
+ * @return The number of generated triangle vertices.
+ */
+uint32_t MarchingCubesImpl::generateTrianglesPrefixSum(ComputeDevice &device, const CartesianGridGeometry &geometry,
+        float isoLevel, cl::Buffer &cartesianGridBuffer, bool implicitGeometry, uint32_t offsetZ,
+        cl::Buffer &cellOffsetsBuffer, cl::Buffer &cubeIndicesBuffer, PooledBuffer &vertexBuffer)
+{
+    ComputeKernels &kernels = getKernels(device, geometry);
+    const uint32_t nx = geometry.nx, ny = geometry.ny, nz = geometry.nz;
+    const uint32_t numCells = (nx-1) * (ny-1) * (nz-1);
+
+    // The prefix sum yields the index of every active cell and the offset of its vertices in the vertex buffer.
+    glm::uvec2 totalCounts = exclusiveScan(device, cellOffsetsBuffer, numCells);
+    const uint32_t numActiveCells = totalCounts.x;
+    const uint32_t numVertices = totalCounts.y;
+    if (numVertices == 0) {
+        return 0;
+    }
+
+    // Compact the list of active cells, so that the second pass doesn't need to iterate over the empty cells.
+    PooledBuffer activeCellsBuffer = device.bufferPool.acquire(sizeof(uint32_t) * numActiveCells);
+    const cl::NDRange &localSize = kernels.localWorkSizes[PASS_GENERATE_TRIANGLES];
+    kernels.compactActiveCells(cl::EnqueueArgs(device.queue,
+            CLInterface::get()->rangePadding1D(numCells, localSize[0]), localSize),
+            cellOffsetsBuffer, activeCellsBuffer, numCells, numActiveCells);
+
+    // Create a vertex buffer large enough for storing all vertices that get generated by the MC algorithm.
+    vertexBuffer = device.bufferPool.acquire(sizeof(glm::vec4) * numVertices);
+
+    // Finally, launch the marching cubes algorithm for the active cells.
+    cl::EnqueueArgs eargsActiveCells(device.queue,
+            CLInterface::get()->rangePadding1D(numActiveCells, localSize[0]), localSize);
+    const glm::vec3 &origin = geometry.origin;
+    if (implicitGeometry) {
+        kernels.generateTrianglesImplicit(eargsActiveCells, cartesianGridBuffer, activeCellsBuffer,
+                cellOffsetsBuffer, cubeIndicesBuffer, vertexBuffer, numActiveCells, nx, ny, nz, isoLevel,
+                origin.x, origin.y, origin.z, geometry.dx, geometry.dy, geometry.dz, offsetZ);
+    } else {
+        kernels.generateTriangles(eargsActiveCells, cartesianGridBuffer, activeCellsBuffer, cellOffsetsBuffer,
+                cubeIndicesBuffer, vertexBuffer, numActiveCells, nx, ny, nz, isoLevel);
+    }
+    return numVertices;
+}
+
+/**
+ * Generates the triangles of the active cells using a HistoPyramid (see HistoPyramid.cl). Every triangle is generated
+ * by one work item, which finds its cell by traversing the pyramid. Thus, the cost of this pass only depends on the
+ * size of the iso surface.
+ * @param device The device to use.
+ * @param geometry The geometry of the grid.
+ * @param isoLevel The iso level of the iso surface to construct.
+ * @param cartesianGridBuffer The Cartesian grid (see marchingCubesBuffer).
+ * @param implicitGeometry Whether the grid has implicit geometry.
+ * @param offsetZ The index of the first grid point layer of the buffer in the whole grid.
+ * @param cellCountsBuffer The cell counts computed by classifyCells.
+ * @param cubeIndicesBuffer The marching cubes cases computed by classifyCells.
+ * @param vertexBuffer The buffer storing the generated triangle vertices (only created if there are any).
+ * @return The number of generated triangle vertices.
+ */
+uint32_t MarchingCubesImpl::generateTrianglesHistoPyramid(ComputeDevice &device, const CartesianGridGeometry &geometry,
+        float isoLevel, cl::Buffer &cartesianGridBuffer, bool implicitGeometry, uint32_t offsetZ,
+        cl::Buffer &cellCountsBuffer, cl::Buffer &cubeIndicesBuffer, PooledBuffer &vertexBuffer)
+{
+    ComputeKernels &kernels = getKernels(device, geometry);
+    const uint32_t nx = geometry.nx, ny = geometry.ny, nz = geometry.nz;
+    const uint32_t numCells = (nx-1) * (ny-1) * (nz-1);
+
+    // The offset and size of every level above the cells in the pyramid buffer. The top level has one element.
+    std::vector<glm::uvec2> levels;
+    uint32_t levelSize = numCells;
+    uint32_t pyramidSize = 0;
+    do {
+        levelSize = (levelSize - 1) / HISTOPYRAMID_FAN_IN + 1;
+        levels.push_back(glm::uvec2(pyramidSize, levelSize));
+        pyramidSize += levelSize;
+    } while (levelSize > 1);
+    const uint32_t numLevels = levels.size();
+
+    PooledBuffer pyramidBuffer = device.bufferPool.acquire(sizeof(uint32_t) * pyramidSize);
+    cl::Buffer levelsBuffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+            sizeof(glm::uvec2) * numLevels, (void *)&levels.front());
+
+    // Build the pyramid bottom-up.
+    const cl::NDRange &localSize = kernels.localWorkSizes[PASS_GENERATE_TRIANGLES];
+    kernels.buildHistoPyramidBase(cl::EnqueueArgs(device.queue,
+            CLInterface::get()->rangePadding1D(levels[0].y, localSize[0]), localSize),
+            cellCountsBuffer, pyramidBuffer, numCells, levels[0].y);
+    for (uint32_t i = 1; i < numLevels; i++) {
+        kernels.buildHistoPyramidLevel(cl::EnqueueArgs(device.queue,
+                CLInterface::get()->rangePadding1D(levels[i].y, localSize[0]), localSize),
+                pyramidBuffer, levels[i-1].x, levels[i-1].y, levels[i].x, levels[i].y);
+    }
+
+    // The top level stores the number of triangles of the iso surface.
+    uint32_t numTriangles = 0;
+    device.queue.enqueueReadBuffer(pyramidBuffer, CL_TRUE, sizeof(uint32_t) * levels.back().x, sizeof(uint32_t),
+            (void *)&numTriangles);
+    const uint32_t numVertices = 3 * numTriangles;
+    if (numVertices == 0) {
+        return 0;
+    }
+
+    // Launch one work item per triangle.
+    vertexBuffer = device.bufferPool.acquire(sizeof(glm::vec4) * numVertices);
+    cl::EnqueueArgs eargsTriangles(device.queue,
+            CLInterface::get()->rangePadding1D(numTriangles, localSize[0]), localSize);
+    const glm::vec3 &origin = geometry.origin;
+    if (implicitGeometry) {
+        kernels.generateTrianglesHistoPyramidImplicit(eargsTriangles, cartesianGridBuffer, cellCountsBuffer,
+                cubeIndicesBuffer, pyramidBuffer, levelsBuffer, vertexBuffer, numLevels, numTriangles, nx, ny, nz,
+                isoLevel, origin.x, origin.y, origin.z, geometry.dx, geometry.dy, geometry.dz, offsetZ);
+    } else {
+        kernels.generateTrianglesHistoPyramid(eargsTriangles, cartesianGridBuffer, cellCountsBuffer,
+                cubeIndicesBuffer, pyramidBuffer, levelsBuffer, vertexBuffer, numLevels, numTriangles, nx, ny, nz,
+                isoLevel);
+    }
+    return numVertices;
+}
+
+/**
+ * Computes the exclusive prefix sum of an array of uint2 elements on the device (in place) using the kernels in
+ * Scan.cl. Arrays larger than one block are scanned recursively.
+ * @param device The device to use.
+ * @param dataBuffer The elements to scan.
+ * @param n The number of elements.
+ * @return The sum of all elements.
+ */
+glm::uvec2 MarchingCubesImpl::exclusiveScan(ComputeDevice &device, cl::Buffer &dataBuffer, uint32_t n)
+{
+    const cl::NDRange &localSize = device.kernels->localWorkSizes[PASS_SCAN];
+    const uint32_t blockSize = 2 * uint32_t(localSize[0]);
+    const uint32_t numBlocks = (n - 1) / blockSize + 1;
+    PooledBuffer blockSumsBuffer = device.bufferPool.acquire(sizeof(glm::uvec2) * numBlocks);
+
+    device.kernels->scanBlocks(cl::EnqueueArgs(device.queue, cl::NDRange(numBlocks * localSize[0]), localSize),
+            dataBuffer, blockSumsBuffer, n,
+            cl::Local(sizeof(glm::uvec2) * blockSize));
+
+    glm::uvec2 totalSum;
+    if (numBlocks == 1) {
+        device.queue.enqueueReadBuffer(blockSumsBuffer, CL_TRUE, 0, sizeof(glm::uvec2), (void *)&totalSum);
+    } else {
+        totalSum = exclusiveScan(device, blockSumsBuffer, numBlocks);
+        device.kernels->addBlockOffsets(cl::EnqueueArgs(device.queue, cl::NDRange(numBlocks * blockSize),
+                localSize), dataBuffer, blockSumsBuffer, n, blockSize);
+    }
+    return totalSum;
+}
+
+/**
+ * Returns the local memory of the tiled kernels for the passed work group size (see loadTile in MarchingCubes.cl).
+ */
+static cl::LocalSpaceArg getGridTile(const cl::NDRange &localWorkSize)
+{
+    return cl::Local(sizeof(float) * (localWorkSize[0] + 1) * (localWorkSize[1] + 1) * (localWorkSize[2] + 1));
+}
+
+/**
+ * Runs the first pass of marching cubes with triangle soup output, i.e. classifyCells or its tiled variant.
+ * @param device The device to use.
+ * @param kernels The kernels to use (see getKernels).
+ * @param eargs The enqueue args with the local work size of the pass in kernels.
+ * @param cartesianGridBuffer The Cartesian grid (see marchingCubesBuffer).
+ * @param implicitGeometry Whether the grid has implicit geometry.
+ * @param cellCountsBuffer Per cell: Whether the cell is active and the number of triangle vertices it generates.
+ * @param cubeIndicesBuffer Per cell: The marching cubes case.
+ * @param geometry The geometry of the grid.
+ * @param isoLevel The iso level of the iso surface to construct.
+ */
+void MarchingCubesImpl::classifyCells(ComputeDevice &device, ComputeKernels &kernels, const cl::EnqueueArgs &eargs,
+        cl::Buffer &cartesianGridBuffer, bool implicitGeometry, cl::Buffer &cellCountsBuffer,
+        cl::Buffer &cubeIndicesBuffer, const CartesianGridGeometry &geometry, float isoLevel)
+{
+    const uint32_t nx = geometry.nx, ny = geometry.ny, nz = geometry.nz;
+    if (device.useGridTiling) {
+        kernels.getClassifyCellsTiled(implicitGeometry)(eargs, cartesianGridBuffer, cellCountsBuffer,
+                cubeIndicesBuffer, nx, ny, nz, isoLevel, getGridTile(kernels.localWorkSizes[PASS_CLASSIFY_CELLS]));
+    } else {
+        kernels.getClassifyCells(implicitGeometry)(eargs, cartesianGridBuffer, cellCountsBuffer, cubeIndicesBuffer,
+                nx, ny, nz, isoLevel);
+    }
+}
+
+/**
+ * Runs the first pass of marching cubes with indexed output, i.e. classifyPointsIndexed or its tiled variant.
+ * @param device The device to use.
+ * @param kernels The kernels to use (see getKernels).
+ * @param eargs The enqueue args with the local work size of the pass in kernels.
+ * @param cartesianGridBuffer The Cartesian grid (see marchingCubesBuffer).
+ * @param implicitGeometry Whether the grid has implicit geometry.
+ * @param pointCountsBuffer Per grid point: The number of vertices on its owned edges and the number of indices.
+ * @param edgeMasksBuffer Per grid point: The owned edges crossing the iso surface.
+ * @param cubeIndicesBuffer Per grid point: The marching cubes case of the cell at the grid point.
+ * @param geometry The geometry of the grid.
+ * @param isoLevel The iso level of the iso surface to construct.
+ */
+void MarchingCubesImpl::classifyPointsIndexed(ComputeDevice &device, ComputeKernels &kernels,
+        const cl::EnqueueArgs &eargs, cl::Buffer &cartesianGridBuffer, bool implicitGeometry,
+        cl::Buffer &pointCountsBuffer, cl::Buffer &edgeMasksBuffer, cl::Buffer &cubeIndicesBuffer,
+        const CartesianGridGeometry &geometry, float isoLevel)
+{
+    const uint32_t nx = geometry.nx, ny = geometry.ny, nz = geometry.nz;
+    if (device.useGridTiling) {
+        kernels.getClassifyPointsIndexedTiled(implicitGeometry)(eargs, cartesianGridBuffer, pointCountsBuffer,
+                edgeMasksBuffer, cubeIndicesBuffer, nx, ny, nz, isoLevel,
+                getGridTile(kernels.localWorkSizes[PASS_CLASSIFY_POINTS]));
+    } else {
+        kernels.getClassifyPointsIndexed(implicitGeometry)(eargs, cartesianGridBuffer, pointCountsBuffer,
+                edgeMasksBuffer, cubeIndicesBuffer, nx, ny, nz, isoLevel);
+    }
+}
@@ -30,23 +30,298 @@
 #define NETCDFIMPORTER_MARCHINGCUBES_HPP
 
 #include <vector>
+#include <map>
+#include <memory>
+#include <string>
+#include <exception>
 #include <glm/glm.hpp>
 #include "CLInterface.hpp"
+#include "ComputeKernels.hpp"
+#include "DeviceBufferPool.hpp"
 #include "CartesianGrid.hpp"
+#include "ScalarFieldCache.hpp"
+#include "TriangleMesh.hpp"
+
+/**
+ * How the second pass of the marching cubes algorithm finds the cells intersecting the iso surface.
+ * - TRAVERSAL_PREFIX_SUM: Compacts the list of active cells using a prefix sum and launches one work item per cell.
+ * - TRAVERSAL_HISTOPYRAMID: Builds a HistoPyramid of the triangle counts and launches one work item per triangle.
+ * - TRAVERSAL_AUTO: Uses the HistoPyramid for large grids (where the surface usually is very sparse).
+ */
+enum ActiveCellTraversal {
+    TRAVERSAL_AUTO, TRAVERSAL_PREFIX_SUM, TRAVERSAL_HISTOPYRAMID
+};
+
+/**
+ * The algorithm used for extracting an iso surface.
+ * - ENGINE_DEFAULT: The engine selected at startup (see MarchingCubesImpl::setDefaultEngine).
+ * - ENGINE_MARCHING_CUBES: Cell-parallel marching cubes on the OpenCL device.
+ * - ENGINE_FLYING_EDGES: Flying edges on the CPU (see FlyingEdges.hpp).
+ */
+enum ExtractionEngine {
+    ENGINE_DEFAULT, ENGINE_MARCHING_CUBES, ENGINE_FLYING_EDGES
+};
+
+/**
+ * The backend running the marching cubes algorithm.
+ * - BACKEND_AUTO: OpenCL if a platform with a device is available, the native CPU backend otherwise.
+ * - BACKEND_OPENCL: OpenCL (the server exits if OpenCL isn't available).
+ * - BACKEND_CPU: The native CPU backend (see MarchingCubesCpu.hpp), which doesn't need an OpenCL runtime.
+ */
+enum ComputeBackend {
+    BACKEND_AUTO, BACKEND_OPENCL, BACKEND_CPU
+};
+
+/**
+ * When the work-group sizes of the kernels are tuned for a device (see MarchingCubesImpl::autotuneWorkGroupSizes).
+ * - AUTOTUNE_OFF: Always uses the default sizes.
+ * - AUTOTUNE_CACHED: Uses the sizes tuned in a previous run if they are stored in the cache, the defaults otherwise.
+ * - AUTOTUNE_STARTUP: Tunes the sizes at startup if they aren't stored in the cache yet.
+ * - AUTOTUNE_FORCE: Tunes the sizes at every startup.
+ */
+enum WorkGroupAutotuning {
+    AUTOTUNE_OFF, AUTOTUNE_CACHED, AUTOTUNE_STARTUP, AUTOTUNE_FORCE
+};
+
+/**
+ * Whether the classification kernels load the grid points of a work group into local memory first (see
+ * classifyCellsTiled in MarchingCubes.cl).
+ * - TILING_AUTO: Tiling is used on GPUs with dedicated local memory (CPU runtimes emulate it in global memory).
+ * - TILING_ON: Tiling is used on all devices.
+ * - TILING_OFF: The kernels read the grid points from global memory.
+ */
+enum GridTiling {
+    TILING_AUTO, TILING_ON, TILING_OFF
+};
+
+/**
+ * The vertices of an indexed mesh of a brick (see MarchingCubesImpl::marchingCubesBricked) on the grid point layers
+ * shared with the adjacent bricks. The vertices are ordered by their owning grid point and then by the direction of
+ * their edge, so both ranges are contiguous, and the edge masks of a layer identify every vertex on it.
+ */
+struct BrickSeams {
+    BrickSeams() : numFirstLayerVertices(0), firstLastLayerVertex(0) {}
+    uint32_t numFirstLayerVertices; ///< The vertices [0, numFirstLayerVertices) are on the first layer
+    uint32_t firstLastLayerVertex;  ///< The vertices from firstLastLayerVertex on are on the last layer
+    std::vector<uint8_t> firstLayerEdgeMasks; ///< The owned edges crossing the iso surface of the first layer
+    std::vector<uint8_t> lastLayerEdgeMasks;  ///< The owned edges crossing the iso surface of the last layer
+};
+
+/**
+ * The iso surface of a grid streamed by the client in bricks of grid point layers (see
+ * MarchingCubesImpl::extractStreamedBrick). Only the current brick and the mesh are kept in memory, so the grid may
+ * be larger than the host and the device memory.
+ */
+struct StreamedExtraction {
+    StreamedExtraction() : isoLevel(0.0f), implicitGeometry(true), nextZ(0), firstSharedVertex(0) {}
+    StreamedExtraction(const CartesianGridGeometry &geometry, float isoLevel, bool implicitGeometry,
+            bool indexedOutput) : geometry(geometry), isoLevel(isoLevel), implicitGeometry(implicitGeometry),
+            mesh(indexedOutput), nextZ(0), firstSharedVertex(0) {}
+    /// Whether all bricks were extracted.
+    inline bool isFinished() const { return nextZ + 1 >= geometry.nz; }
+
+    CartesianGridGeometry geometry; ///< The geometry of the whole grid
+    float isoLevel;
+    bool implicitGeometry;
+    TriangleMesh mesh;              ///< The mesh of the bricks extracted so far
+    uint32_t nextZ;                 ///< The grid point layer the next brick starts with
+    size_t firstSharedVertex;       ///< The first vertex of the mesh on the last layer of the previous brick
+    std::vector<uint8_t> lastLayerEdgeMasks; ///< The edge masks of the last layer of the previous brick
+};
+
+/// A CindyScript scalar field sampled on the device (see MarchingCubesImpl::sampleScalarField).
+struct ScalarFieldSampler {
+    cl::Program program;          ///< For creating the kernel on other devices
+    cl::Kernel kernel;
+    cl::Buffer variablesBuffer;   ///< The values of the variable register slots
+    cl::Buffer blockValuesBuffer; ///< The culled blocks of the whole grid
+    glm::uvec3 numBlocks;
+};
+
+/// The cell layers [zBegin, zEnd) of a grid processed by one device (see MarchingCubesImpl::marchingCubesMultiDevice).
+struct DeviceRange {
+    DeviceRange() : zBegin(0), zEnd(0), hasSampler(false) {}
+    uint32_t zBegin, zEnd;
+    bool hasSampler;            ///< Whether the scalar field is sampled on the device using sampler
+    ScalarFieldSampler sampler; ///< With the kernel created for the device processing the range
+    TriangleMesh mesh;
+    BrickSeams seams;
+    std::exception_ptr error;   ///< Set if the extraction failed
+};
+
+/**
+ * The state of one OpenCL device of the context. Each device has its own queues, kernels and buffer pool, so the
+ * devices can process parts of a grid concurrently (see MarchingCubesImpl::marchingCubesMultiDevice).
+ */
+struct ComputeDevice {
+    ComputeDevice() : useGridTiling(false), hostUnifiedMemory(false), maxBrickNumPoints(0),
+            throughput(0.0), estimatedThroughput(0.0) {}
+    cl::Device device;
+    cl::CommandQueue queue;         //!< For sending commands asynchronously to context
+    cl::CommandQueue uploadQueue;   //!< Uploads of slabs in marchingCubesPipelined
+    cl::CommandQueue downloadQueue; //!< Downloads of slab vertices in marchingCubesPipelined
+    std::unique_ptr<ComputeKernels> kernels; //!< The kernels used with queue (created once in init)
+    DeviceBufferPool bufferPool;    //!< Intermediate buffers reused across requests
+    cl::NDRange LOCAL_WORK_SIZE;    //!< Default work group size of the 3D kernels, used by scalar field samplers
+    /// Work group sizes of the kernel passes (see initWorkGroupSizes), fitted to every set of kernels
+    cl::NDRange PASS_LOCAL_WORK_SIZES[NUM_KERNEL_PASSES];
+    bool useGridTiling;             //!< Whether the tiled classification kernels are used (see GridTiling)
+    bool hostUnifiedMemory;         //!< Whether the device can directly access host memory
+    size_t maxBrickNumPoints;       //!< Grids with more points are processed in bricks
+    /// Kernels specialized for the grid shapes (nx, ny) of MarchingCubesImpl::kernelSpecializations
+    std::map<std::pair<uint32_t, uint32_t>, std::unique_ptr<ComputeKernels>> specializedKernels;
+    double throughput;              //!< Measured cells per second of past requests (0 if not yet measured)
+    double estimatedThroughput;     //!< Compute units times clock frequency, used until throughput is measured
+};
+
+/// A compute program specialized for a grid shape (see MarchingCubesImpl::prepareKernelSpecialization).
+struct KernelSpecialization {
+    KernelSpecialization() : numRequests(0), lastRequest(0), built(false) {}
+    cl::Program program;
+    uint32_t numRequests;  ///< The number of requests with the grid shape
+    uint64_t lastRequest;  ///< For evicting the least recently used specialization
+    bool built;
+};
 
 class MarchingCubesImpl {
 public:
+    MarchingCubesImpl() : activeCellTraversal(TRAVERSAL_AUTO), defaultEngine(ENGINE_MARCHING_CUBES),
+            backend(BACKEND_AUTO), maxPooledBytes(0), memoryBudget(0), useAllDevices(true),
+            programCacheDirectory("cache"), specializationMinRequests(2), requestCounter(0),
+            autotuning(AUTOTUNE_CACHED), gridTiling(TILING_AUTO) {}
     void init();
     void quit();
-    std::vector<glm::vec3> marchingCubes(uint32_t nx, float isoLevel,
-            const std::vector<CartesianGridCorner> &cartesianGrid);
+    TriangleMesh marchingCubes(uint32_t nx, uint32_t ny, uint32_t nz, float isoLevel,
+            const CartesianGridCorner *cartesianGrid, bool indexedOutput = false,
+            ExtractionEngine engine = ENGINE_DEFAULT);
+    TriangleMesh marchingCubesImplicit(const CartesianGridGeometry &geometry, float isoLevel,
+            const float *scalarField, bool indexedOutput = false, ExtractionEngine engine = ENGINE_DEFAULT);
+    TriangleMesh marchingCubesScalarField(const CartesianGridGeometry &geometry, float isoLevel,
+            CompiledScalarField &scalarField, const std::map<std::string, float> &variables,
+            bool indexedOutput = false, ExtractionEngine engine = ENGINE_DEFAULT);
+    /**
+     * Needs to be called once after all extractions of a request (e.g. one per iso value). Frees the pooled device
+     * buffers that weren't used by recent requests (see DeviceBufferPool::trim).
+     */
+    void finishRequest();
+    /**
+     * Extracts the iso surface of the next brick of a streamed grid and appends it to the mesh of the extraction.
+     * @param extraction The state of the extraction.
+     * @param zBegin The first grid point layer of the brick (0 or the last layer of the previous brick).
+     * @param numLayers The number of grid point layers of the brick (at least 2).
+     * @param brickGrid The grid points of the brick (see marchingCubesBuffer for the layout).
+     * @return False if the brick doesn't continue the previous one or the OpenCL backend isn't used.
+     */
+    bool extractStreamedBrick(StreamedExtraction &extraction, uint32_t zBegin, uint32_t numLayers,
+            const void *brickGrid);
+
+    /// Compiled scalar field functions of JSON requests
+    inline ScalarFieldCache &getScalarFieldCache() { return scalarFieldCache; }
+    inline void setActiveCellTraversal(ActiveCellTraversal traversal) { activeCellTraversal = traversal; }
+    /// The engine used for requests not selecting one (ENGINE_MARCHING_CUBES by default)
+    inline void setDefaultEngine(ExtractionEngine engine) { defaultEngine = engine; }
+    /// Needs to be called before init (BACKEND_AUTO by default)
+    inline void setBackend(ComputeBackend computeBackend) { backend = computeBackend; }
+    /// BACKEND_OPENCL or BACKEND_CPU after init
+    inline ComputeBackend getBackend() const { return backend; }
+    /// Needs to be called before init (a quarter of the device memory by default)
+    inline void setBufferPoolLimit(size_t maxBytes) { maxPooledBytes = maxBytes; }
+    /// Needs to be called before init (half of the device memory by default). Larger grids are processed in bricks.
+    inline void setMemoryBudget(size_t maxBytes) { memoryBudget = maxBytes; }
+    /// Needs to be called before init (true by default). Otherwise, only the first device of the platform is used.
+    inline void setUseAllDevices(bool allDevices) { useAllDevices = allDevices; }
+    /// Needs to be called before init ("cache" by default, an empty string disables the program binary cache)
+    inline void setProgramCacheDirectory(const std::string &directory) { programCacheDirectory = directory; }
+    /**
+     * Kernels specialized for a grid shape are built from the passed number of requests with the shape on (2 by
+     * default, 0 disables specialization). See prepareKernelSpecialization.
+     */
+    inline void setKernelSpecialization(uint32_t minRequests) { specializationMinRequests = minRequests; }
+    /// Needs to be called before init (AUTOTUNE_CACHED by default)
+    inline void setWorkGroupAutotuning(WorkGroupAutotuning mode) { autotuning = mode; }
+    /// Needs to be called before init (TILING_AUTO by default)
+    inline void setGridTiling(GridTiling tiling) { gridTiling = tiling; }
+    /// Tunes the work-group sizes of all devices now and stores them in the cache (e.g. after a driver update).
+    void autotune();
 
 private:
+    /// Flying edges is used if selected or for indexed meshes on the CPU backend.
+    inline bool useFlyingEdges(ExtractionEngine engine, bool indexedOutput) {
+        return (engine == ENGINE_DEFAULT ? defaultEngine : engine) == ENGINE_FLYING_EDGES
+                || (backend == BACKEND_CPU && indexedOutput);
+    }
+    void initComputeDevice(const cl::Device &clDevice);
+    void prepareKernelSpecialization(const CartesianGridGeometry &geometry);
+    void initWorkGroupSizes(ComputeDevice &device);
+    void applyWorkGroupSizes(ComputeDevice &device);
+    void autotuneWorkGroupSizes(ComputeDevice &device);
+    bool loadWorkGroupSizes(ComputeDevice &device);
+    void storeWorkGroupSizes(ComputeDevice &device);
+    double timeKernelPass(ComputeDevice &device, KernelPass pass, const cl::NDRange &localWorkSize,
+            cl::Buffer &scalarFieldBuffer, const CartesianGridGeometry &geometry);
+    ComputeKernels &getKernels(ComputeDevice &device, const CartesianGridGeometry &geometry);
+    TriangleMesh marchingCubesBuffer(ComputeDevice &device, const CartesianGridGeometry &geometry, float isoLevel,
+            cl::Buffer &cartesianGridBuffer, bool implicitGeometry, bool indexedOutput);
+    TriangleMesh marchingCubesBufferIndexed(ComputeDevice &device, const CartesianGridGeometry &geometry,
+            float isoLevel, cl::Buffer &cartesianGridBuffer, bool implicitGeometry, uint32_t offsetZ,
+            BrickSeams *seams);
+    TriangleMesh marchingCubesHostGrid(const CartesianGridGeometry &geometry, float isoLevel,
+            const void *cartesianGrid, bool implicitGeometry, bool indexedOutput);
+    TriangleMesh marchingCubesBricked(ComputeDevice &device, const CartesianGridGeometry &geometry, float isoLevel,
+            const void *cartesianGrid, bool implicitGeometry, ScalarFieldSampler *sampler, bool indexedOutput,
+            uint32_t brickNumCells, uint32_t zBegin, uint32_t zEnd, BrickSeams *seams);
+    uint32_t getBrickNumCells(ComputeDevice &device, const CartesianGridGeometry &geometry);
+    bool useMultipleDevices(const CartesianGridGeometry &geometry);
+    TriangleMesh marchingCubesMultiDevice(const CartesianGridGeometry &geometry, float isoLevel,
+            const void *cartesianGrid, bool implicitGeometry, ScalarFieldSampler *sampler, bool indexedOutput);
+    void extractDeviceRange(ComputeDevice &device, const CartesianGridGeometry &geometry, float isoLevel,
+            const void *cartesianGrid, bool implicitGeometry, bool indexedOutput, DeviceRange &range);
+    void sampleScalarField(ComputeDevice &device, ScalarFieldSampler &sampler, const CartesianGridGeometry &geometry,
+            uint32_t offsetZ, cl::Buffer &scalarFieldBuffer);
+    TriangleMesh marchingCubesPipelined(ComputeDevice &device, const CartesianGridGeometry &geometry, float isoLevel,
+            const void *cartesianGrid, bool implicitGeometry, uint32_t slabNumCells);
+    uint32_t getPipelineSlabNumCells(ComputeDevice &device, const CartesianGridGeometry &geometry, size_t pointSize,
+            bool indexedOutput);
+    bool useHistoPyramid(size_t numCells);
+    uint32_t generateTriangles(ComputeDevice &device, const CartesianGridGeometry &geometry, float isoLevel,
+            cl::Buffer &cartesianGridBuffer, bool implicitGeometry, bool histoPyramid, uint32_t offsetZ,
+            PooledBuffer &vertexBuffer);
+    std::vector<glm::vec3> readVertices(ComputeDevice &device, cl::Buffer &vertexBuffer, uint32_t numVertices);
+    uint32_t generateTrianglesPrefixSum(ComputeDevice &device, const CartesianGridGeometry &geometry, float isoLevel,
+            cl::Buffer &cartesianGridBuffer, bool implicitGeometry, uint32_t offsetZ, cl::Buffer &cellOffsetsBuffer,
+            cl::Buffer &cubeIndicesBuffer, PooledBuffer &vertexBuffer);
+    uint32_t generateTrianglesHistoPyramid(ComputeDevice &device, const CartesianGridGeometry &geometry,
+            float isoLevel, cl::Buffer &cartesianGridBuffer, bool implicitGeometry, uint32_t offsetZ,
+            cl::Buffer &cellCountsBuffer, cl::Buffer &cubeIndicesBuffer, PooledBuffer &vertexBuffer);
+    bool getScalarFieldKernel(CompiledScalarField &scalarField, cl::Kernel &kernel);
+    PooledBuffer createInputBuffer(ComputeDevice &device, const void *data, size_t size);
+    glm::uvec2 exclusiveScan(ComputeDevice &device, cl::Buffer &dataBuffer, uint32_t n);
+    void classifyCells(ComputeDevice &device, ComputeKernels &kernels, const cl::EnqueueArgs &eargs,
+            cl::Buffer &cartesianGridBuffer, bool implicitGeometry, cl::Buffer &cellCountsBuffer,
+            cl::Buffer &cubeIndicesBuffer, const CartesianGridGeometry &geometry, float isoLevel);
+    void classifyPointsIndexed(ComputeDevice &device, ComputeKernels &kernels, const cl::EnqueueArgs &eargs,
+            cl::Buffer &cartesianGridBuffer, bool implicitGeometry, cl::Buffer &pointCountsBuffer,
+            cl::Buffer &edgeMasksBuffer, cl::Buffer &cubeIndicesBuffer, const CartesianGridGeometry &geometry,
+            float isoLevel);
+
+    ScalarFieldCache scalarFieldCache;
     cl::Context context;
     std::vector<cl::Device> devices;
     cl::Program computeProgram; //!< Contains all compute kernels
-    cl::CommandQueue queue;     //!< For sending commands asynchronously to context
-    cl::NDRange LOCAL_WORK_SIZE;
+    std::vector<std::unique_ptr<ComputeDevice>> computeDevices; //!< The first one handles requests on a single device
+    ActiveCellTraversal activeCellTraversal;
+    ExtractionEngine defaultEngine;
+    ComputeBackend backend;     //!< BACKEND_OPENCL or BACKEND_CPU after init
+    size_t maxPooledBytes;
+    size_t memoryBudget;
+    bool useAllDevices;
+    std::string programCacheDirectory; //!< See ProgramBinaryCache
+    /// Compute programs specialized for grid shapes (nx, ny)
+    std::map<std::pair<uint32_t, uint32_t>, KernelSpecialization> kernelSpecializations;
+    uint32_t specializationMinRequests;
+    uint64_t requestCounter;
+    WorkGroupAutotuning autotuning;
+    GridTiling gridTiling;
 };
 
 #endif //NETCDFIMPORTER_MARCHINGCUBES_HPP
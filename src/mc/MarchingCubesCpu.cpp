@@ -0,0 +1,144 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <omp.h>
+#include "MarchingCubesTables.hpp"
+#include "GridAccess.hpp"
+#include "MarchingCubesCpu.hpp"
+
+namespace {
+
+/**
+ * Computes for every grid point of a plane (z = const) whether its scalar value is below the iso level.
+ */
+template<class GridAccess>
+inline void classifyPlane(const GridAccess &grid, size_t planeOffset, size_t planeSize, float isoLevel,
+        uint8_t *classes) {
+    #pragma omp simd
+    for (size_t i = 0; i < planeSize; i++) {
+        classes[i] = grid.getValue(planeOffset + i) < isoLevel ? 1 : 0;
+    }
+}
+
+/**
+ * Appends the triangles of a grid cell to the output arena.
+ */
+template<class GridAccess>
+inline void polygonizeCell(const GridAccess &grid, int cubeIndex, uint32_t x, uint32_t y, uint32_t z,
+        uint32_t nx, uint32_t ny, float isoLevel, std::vector<glm::vec3> &arena) {
+    // The order of the corners, see: http://paulbourke.net/geometry/polygonise/
+    static const uint32_t cornerOffsets[8][3] = {
+        {0, 0, 0}, {1, 0, 0}, {1, 0, 1}, {0, 0, 1}, {0, 1, 0}, {1, 1, 0}, {1, 1, 1}, {0, 1, 1}
+    };
+    glm::vec3 positions[8];
+    float values[8];
+    for (int i = 0; i < 8; i++) {
+        uint32_t cx = x + cornerOffsets[i][0], cy = y + cornerOffsets[i][1], cz = z + cornerOffsets[i][2];
+        size_t index = cx + cy * size_t(nx) + cz * size_t(nx) * ny;
+        positions[i] = grid.getPosition(index, cx, cy, cz);
+        values[i] = grid.getValue(index);
+    }
+    for (int i = 0; triTable[cubeIndex][i] != -1; i++) {
+        int c0 = edgeCorners[triTable[cubeIndex][i]][0];
+        int c1 = edgeCorners[triTable[cubeIndex][i]][1];
+        arena.push_back(vertexInterpIso(isoLevel, positions[c0], positions[c1], values[c0], values[c1]));
+    }
+}
+
+template<class GridAccess>
+TriangleMesh marchingCubesCpuImpl(const GridAccess &grid, uint32_t nx, uint32_t ny, uint32_t nz, float isoLevel) {
+    const uint32_t numSlabs = nz - 1;
+    const size_t planeSize = size_t(nx) * ny;
+    std::vector<std::vector<glm::vec3>> arenas(omp_get_max_threads());
+
+    #pragma omp parallel
+    {
+        // Every thread processes a contiguous range of slabs, so that concatenating the arenas preserves the order.
+        const uint32_t numThreads = omp_get_num_threads();
+        const uint32_t threadIndex = omp_get_thread_num();
+        const uint32_t zBegin = uint32_t(uint64_t(numSlabs) * threadIndex / numThreads);
+        const uint32_t zEnd = uint32_t(uint64_t(numSlabs) * (threadIndex + 1) / numThreads);
+        std::vector<glm::vec3> &arena = arenas.at(threadIndex);
+
+        if (zBegin < zEnd) {
+            // The classification of the grid points of the planes z and z+1.
+            std::vector<uint8_t> classesLower(planeSize), classesUpper(planeSize);
+            std::vector<uint8_t> cubeIndices(nx - 1);
+            classifyPlane(grid, zBegin * planeSize, planeSize, isoLevel, &classesLower.front());
+
+            for (uint32_t z = zBegin; z < zEnd; z++) {
+                classifyPlane(grid, (z + 1) * planeSize, planeSize, isoLevel, &classesUpper.front());
+                for (uint32_t y = 0; y < ny - 1; y++) {
+                    // The rows (y,z), (y+1,z), (y,z+1) and (y+1,z+1).
+                    const uint8_t *c0 = &classesLower[y * size_t(nx)], *c1 = c0 + nx;
+                    const uint8_t *c2 = &classesUpper[y * size_t(nx)], *c3 = c2 + nx;
+                    uint8_t *rowCubeIndices = &cubeIndices.front();
+                    #pragma omp simd
+                    for (uint32_t x = 0; x < nx - 1; x++) {
+                        rowCubeIndices[x] = uint8_t(c0[x] | c0[x+1] << 1 | c2[x+1] << 2 | c2[x] << 3
+                                | c1[x] << 4 | c1[x+1] << 5 | c3[x+1] << 6 | c3[x] << 7);
+                    }
+                    for (uint32_t x = 0; x < nx - 1; x++) {
+                        int cubeIndex = rowCubeIndices[x];
+                        if (cubeIndex != 0 && cubeIndex != 255) {
+                            polygonizeCell(grid, cubeIndex, x, y, z, nx, ny, isoLevel, arena);
+                        }
+                    }
+                }
+                classesLower.swap(classesUpper);
+            }
+        }
+    }
+
+    // Concatenate the arenas at the offsets given by the prefix sum over their sizes.
+    std::vector<size_t> arenaOffsets(arenas.size() + 1, 0);
+    for (size_t i = 0; i < arenas.size(); i++) {
+        arenaOffsets[i + 1] = arenaOffsets[i] + arenas[i].size();
+    }
+    TriangleMesh mesh(false);
+    mesh.vertices.resize(arenaOffsets.back());
+    #pragma omp parallel for
+    for (size_t i = 0; i < arenas.size(); i++) {
+        std::copy(arenas[i].begin(), arenas[i].end(), mesh.vertices.begin() + arenaOffsets[i]);
+    }
+    return mesh;
+}
+
+}
+
+TriangleMesh marchingCubesCpu(const CartesianGridGeometry &geometry, float isoLevel, const float *scalarField) {
+    return marchingCubesCpuImpl(ImplicitGridAccess(geometry, scalarField), geometry.nx, geometry.ny, geometry.nz,
+            isoLevel);
+}
+
+TriangleMesh marchingCubesCpu(uint32_t nx, uint32_t ny, uint32_t nz, float isoLevel,
+        const CartesianGridCorner *cartesianGrid) {
+    return marchingCubesCpuImpl(ExplicitGridAccess(cartesianGrid), nx, ny, nz, isoLevel);
+}
@@ -0,0 +1,62 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MARCHINGCUBESSERVER_MARCHINGCUBESCPU_HPP
+#define MARCHINGCUBESSERVER_MARCHINGCUBESCPU_HPP
+
+#include "CartesianGrid.hpp"
+#include "TriangleMesh.hpp"
+
+/**
+ * Native implementation of the marching cubes algorithm for systems without an OpenCL runtime. The grid is split into
+ * one range of slabs of cells in z direction per thread. Every thread classifies the grid points of its slabs
+ * (vectorized across x), computes the cube indices of a row of cells at once (also vectorized) and appends the
+ * triangles of the active cells to its own output arena. Finally, the arenas are concatenated using a prefix sum over
+ * their sizes. The triangles are stored in the same order as by the OpenCL implementation.
+ */
+
+/**
+ * Extracts the iso surface of a Cartesian grid with implicit geometry.
+ * @param geometry The geometry of the Cartesian grid.
+ * @param isoLevel The iso level of the iso surface to construct.
+ * @param scalarField The scalar values at the grid points (geometry.getNumPoints() values).
+ * @return The triangle soup of the iso surface.
+ */
+TriangleMesh marchingCubesCpu(const CartesianGridGeometry &geometry, float isoLevel, const float *scalarField);
+
+/**
+ * Extracts the iso surface of a Cartesian grid with explicit geometry.
+ * @param nx, ny, nz The number of grid points in x, y and z direction.
+ * @param isoLevel The iso level of the iso surface to construct.
+ * @param cartesianGrid The Cartesian grid (nx*ny*nz entries).
+ * @return The triangle soup of the iso surface.
+ */
+TriangleMesh marchingCubesCpu(uint32_t nx, uint32_t ny, uint32_t nz, float isoLevel,
+        const CartesianGridCorner *cartesianGrid);
+
+#endif //MARCHINGCUBESSERVER_MARCHINGCUBESCPU_HPP
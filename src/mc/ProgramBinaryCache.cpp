@@ -0,0 +1,117 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <boost/filesystem.hpp>
+#include "ProgramBinaryCache.hpp"
+
+/// Written at the start of every entry to detect files not written by this class.
+const uint32_t ENTRY_MAGIC = 0x4243504du;
+
+std::string ProgramBinaryCache::hash(const std::string &data)
+{
+    uint64_t value = 14695981039346656037ull;
+    for (unsigned char c : data) {
+        value ^= c;
+        value *= 1099511628211ull;
+    }
+    char hexString[17];
+    snprintf(hexString, sizeof(hexString), "%016llx", (unsigned long long)value);
+    return hexString;
+}
+
+std::string ProgramBinaryCache::getEntryPath(const std::string &slot)
+{
+    return (boost::filesystem::path(directory) / (hash(slot) + ".bin")).string();
+}
+
+bool ProgramBinaryCache::load(const std::string &slot, const std::string &key, std::vector<unsigned char> &binary)
+{
+    std::ifstream file(getEntryPath(slot), std::ifstream::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    // Entry layout: magic, key length, key, binary length, binary.
+    uint32_t magic = 0;
+    uint64_t keyLength = 0;
+    file.read((char*)&magic, sizeof(magic));
+    file.read((char*)&keyLength, sizeof(keyLength));
+    if (!file.good() || magic != ENTRY_MAGIC || keyLength != key.size()) {
+        return false;
+    }
+    std::string storedKey(keyLength, '\0');
+    file.read(&storedKey.front(), keyLength);
+    if (!file.good() || storedKey != key) {
+        return false;
+    }
+
+    uint64_t binaryLength = 0;
+    file.read((char*)&binaryLength, sizeof(binaryLength));
+    if (!file.good() || binaryLength == 0 || binaryLength > (uint64_t(1) << 32)) {
+        return false;
+    }
+    binary.resize(binaryLength);
+    file.read((char*)&binary.front(), binaryLength);
+    return file.good();
+}
+
+void ProgramBinaryCache::store(const std::string &slot, const std::string &key,
+        const std::vector<unsigned char> &binary)
+{
+    if (binary.empty()) {
+        return;
+    }
+    try {
+        boost::filesystem::create_directories(directory);
+        std::string entryPath = getEntryPath(slot);
+        boost::filesystem::path temporaryPath = entryPath + boost::filesystem::unique_path(".%%%%%%%%.tmp").string();
+
+        std::ofstream file(temporaryPath.string(), std::ofstream::binary);
+        uint64_t keyLength = key.size(), binaryLength = binary.size();
+        file.write((const char*)&ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+        file.write((const char*)&keyLength, sizeof(keyLength));
+        file.write(key.data(), keyLength);
+        file.write((const char*)&binaryLength, sizeof(binaryLength));
+        file.write((const char*)&binary.front(), binaryLength);
+        file.close();
+        if (!file.good()) {
+            std::cerr << "Warning: Couldn't write the program binary cache entry " << temporaryPath.string() << "."
+                    << std::endl;
+            boost::filesystem::remove(temporaryPath);
+            return;
+        }
+
+        // Renaming is atomic, so readers either see the old or the new entry.
+        boost::filesystem::rename(temporaryPath, entryPath);
+    } catch (boost::filesystem::filesystem_error &error) {
+        std::cerr << "Warning: Couldn't write to the program binary cache: " << error.what() << std::endl;
+    }
+}
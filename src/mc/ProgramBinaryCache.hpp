@@ -0,0 +1,73 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MARCHINGCUBESSERVER_PROGRAMBINARYCACHE_HPP
+#define MARCHINGCUBESSERVER_PROGRAMBINARYCACHE_HPP
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+/**
+ * A directory of compiled OpenCL program binaries persisting across runs of the server, so the compute programs don't
+ * need to be compiled from source on every start.
+ * Every entry is stored in a file named after the hash of its slot, i.e. everything identifying the binary except for
+ * the source code (platform name and version, device name, driver version, build options and the program files). The
+ * file additionally stores the full key including the hash of the source code. Entries whose key doesn't match are
+ * stale and overwritten. Entries are written to a temporary file first and then renamed, so concurrently starting
+ * servers never read partially written files.
+ */
+class ProgramBinaryCache {
+public:
+    /// @param cacheDirectory The directory of the cache (created on demand). An empty string disables the cache.
+    inline void setDirectory(const std::string &cacheDirectory) { directory = cacheDirectory; }
+    inline bool isEnabled() const { return !directory.empty(); }
+
+    /**
+     * Loads the binary of an entry.
+     * @param slot Identifies the device and program (see the class description).
+     * @param key The full key of the binary, which needs to match the stored key.
+     * @param binary The loaded binary.
+     * @return False if there is no valid entry for the key.
+     */
+    bool load(const std::string &slot, const std::string &key, std::vector<unsigned char> &binary);
+    /**
+     * Stores the binary of an entry (replacing a stale entry of the same slot). Errors are only reported, as the cache
+     * is an optimization.
+     */
+    void store(const std::string &slot, const std::string &key, const std::vector<unsigned char> &binary);
+
+    /// The 64-bit FNV-1a hash of the passed data as a hexadecimal string.
+    static std::string hash(const std::string &data);
+
+private:
+    std::string getEntryPath(const std::string &slot);
+    std::string directory;
+};
+
+#endif //MARCHINGCUBESSERVER_PROGRAMBINARYCACHE_HPP
@@ -0,0 +1,64 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include "../CindyScriptOptimizer.hpp"
+#include "CartesianGrid.hpp"
+#include "ScalarFieldCache.hpp"
+
+ScalarFieldCache::ScalarFieldCache(size_t maxSize) : cache(maxSize)
+{
+}
+
+std::shared_ptr<CompiledScalarField> ScalarFieldCache::lookup(Json::Value &scalarFunctionCdy)
+{
+    std::string key = canonicalizeExpressionCdy(scalarFunctionCdy["body"]);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<CompiledScalarField> *cachedScalarField = cache.find(key);
+    if (cachedScalarField) {
+        return *cachedScalarField;
+    }
+
+    std::shared_ptr<CompiledScalarField> scalarField = std::make_shared<CompiledScalarField>();
+    scalarField->isValid = compileScalarFieldCdy(scalarFunctionCdy, scalarField->program);
+    if (scalarField->isValid) {
+        // Only optimize the structure, as the values of the free variables may differ between requests.
+        optimizeProgramCdy(scalarField->program);
+    }
+    cache.insert(key, scalarField);
+    return scalarField;
+}
+
+void ScalarFieldCache::printStatistics()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::cout << "Scalar field cache: " << cache.size() << "/" << cache.getMaxSize() << " entries, "
+            << cache.getNumHits() << " hits, " << cache.getNumMisses() << " misses, "
+            << cache.getNumEvictions() << " evictions" << std::endl;
+}
@@ -0,0 +1,79 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MARCHINGCUBESSERVER_SCALARFIELDCACHE_HPP
+#define MARCHINGCUBESSERVER_SCALARFIELDCACHE_HPP
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <json/json.h>
+#include "../CindyScriptCompiler.hpp"
+#include "../LruCache.hpp"
+#include "CLInterface.hpp"
+
+/**
+ * A CindyScript scalar field function compiled for the evaluation on the host and on the device.
+ */
+struct CompiledScalarField {
+    /// False if the function couldn't be compiled to bytecode (i.e. it needs to be evaluated using the source tree).
+    bool isValid = false;
+    CdyProgram program;
+    /// The OpenCL program sampling the scalar field. It is built on first use by MarchingCubesImpl.
+    cl::Program clProgram;
+    cl::Kernel clKernel;
+    bool clProgramBuilt = false;
+    bool clProgramFailed = false;
+};
+
+/**
+ * Caches compiled scalar field functions across requests. The key is the canonical representation of the source tree
+ * (see canonicalizeExpressionCdy), which doesn't contain the values of the free variables. Thus, clients resending the
+ * same function with different variables (e.g. while dragging a slider) skip the bytecode compilation, the OpenCL C
+ * code generation and the OpenCL program build.
+ */
+class ScalarFieldCache {
+public:
+    /// @param maxSize The maximum number of cached functions (the least recently used one is evicted first).
+    explicit ScalarFieldCache(size_t maxSize = 64);
+
+    /**
+     * Returns the compiled version of a scalar field function. The function is compiled if it is not in the cache.
+     * @param scalarFunctionCdy The parsed source tree of the CindyScript function.
+     */
+    std::shared_ptr<CompiledScalarField> lookup(Json::Value &scalarFunctionCdy);
+
+    /// Prints the number of cache hits, misses and evictions on the command line.
+    void printStatistics();
+
+private:
+    std::mutex mutex;
+    LruCache<std::string, std::shared_ptr<CompiledScalarField>> cache;
+};
+
+#endif //MARCHINGCUBESSERVER_SCALARFIELDCACHE_HPP
@@ -0,0 +1,78 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cassert>
+#include "TriangleMesh.hpp"
+
+const uint32_t TriangleMesh::NOT_SHARED;
+
+void TriangleMesh::append(const TriangleMesh &mesh) {
+    assert(indexed == mesh.indexed);
+    const uint32_t indexOffset = uint32_t(vertices.size());
+    vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+    indices.reserve(indices.size() + mesh.indices.size());
+    for (uint32_t index : mesh.indices) {
+        indices.push_back(index + indexOffset);
+    }
+}
+
+void TriangleMesh::appendWelded(const TriangleMesh &mesh, const std::vector<uint32_t> &sharedVertices) {
+    assert(indexed && mesh.indexed);
+
+    // The new index of every vertex of the passed mesh.
+    std::vector<uint32_t> vertexIndices(mesh.vertices.size());
+    vertices.reserve(vertices.size() + mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        if (i < sharedVertices.size() && sharedVertices[i] != NOT_SHARED) {
+            assert(sharedVertices[i] < vertices.size());
+            vertexIndices[i] = sharedVertices[i];
+            continue;
+        }
+        vertexIndices[i] = uint32_t(vertices.size());
+        vertices.push_back(mesh.vertices[i]);
+    }
+
+    indices.reserve(indices.size() + mesh.indices.size());
+    for (uint32_t index : mesh.indices) {
+        indices.push_back(vertexIndices[index]);
+    }
+}
+
+void TriangleMesh::convertToTriangleSoup() {
+    if (!indexed) {
+        return;
+    }
+    std::vector<glm::vec3> triangleVertices(indices.size());
+    #pragma omp parallel for
+    for (size_t i = 0; i < indices.size(); i++) {
+        triangleVertices[i] = vertices[indices[i]];
+    }
+    vertices.swap(triangleVertices);
+    indices.clear();
+    indexed = false;
+}
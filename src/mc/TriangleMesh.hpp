@@ -0,0 +1,73 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MARCHINGCUBESSERVER_TRIANGLEMESH_HPP
+#define MARCHINGCUBESSERVER_TRIANGLEMESH_HPP
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+/**
+ * A triangle mesh created by the marching cubes algorithm. Triangle soups only store vertices, where every three
+ * consecutive vertices form a triangle. Indexed meshes share the vertices between the triangles, and every three
+ * consecutive indices reference the vertices of a triangle.
+ */
+struct TriangleMesh {
+    TriangleMesh() : indexed(false) {}
+    explicit TriangleMesh(bool indexed) : indexed(indexed) {}
+
+    std::vector<glm::vec3> vertices;
+    std::vector<uint32_t> indices;
+    bool indexed;
+
+    inline size_t getNumTriangles() const { return (indexed ? indices.size() : vertices.size()) / 3; }
+
+    /**
+     * Appends the triangles of another mesh to this mesh (e.g. for meshes of multiple iso values).
+     * @param mesh The mesh to append. It needs to use the same representation (indexed or not) as this mesh.
+     */
+    void append(const TriangleMesh &mesh);
+
+    /// Marks vertices not shared with this mesh in the argument of appendWelded.
+    static const uint32_t NOT_SHARED = 0xFFFFFFFFu;
+
+    /**
+     * Appends the triangles of an indexed mesh sharing vertices with this mesh (e.g. the mesh of an adjacent brick of a
+     * grid). Shared vertices are only stored once.
+     * @param mesh The indexed mesh to append.
+     * @param sharedVertices For the first sharedVertices.size() vertices of the passed mesh: The index of the same
+     * vertex in this mesh, or NOT_SHARED.
+     */
+    void appendWelded(const TriangleMesh &mesh, const std::vector<uint32_t> &sharedVertices);
+
+    /// Converts an indexed mesh to a triangle soup (for clients not supporting indexed meshes).
+    void convertToTriangleSoup();
+};
+
+#endif //MARCHINGCUBESSERVER_TRIANGLEMESH_HPP
@@ -0,0 +1,369 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Copyright (c) 2019, Christoph Neuhauser
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <iostream>
+#include <chrono>
+#include <limits>
+#include <cstring>
+#include "MarchingCubes.hpp"
+#include "KernelBenchmark.hpp"
+
+/*
+ * Work-group size autotuning: The best work-group sizes differ a lot between OpenCL runtimes (e.g. POCL, Intel NEO and
+ * discrete GPUs) and between the kernels. The tuner times candidate sizes for every kernel pass (see KernelPass) on a
+ * synthetic scalar field, varying only the size of the tuned pass. The winners are stored per device in the cache
+ * directory (see ProgramBinaryCache) and fitted to the limits of every set of kernels, including the kernels
+ * specialized for grid shapes (see ComputeKernels::fitWorkGroupSizes).
+ */
+
+/// Bump when the kernels or the candidates change in a way that invalidates stored results.
+const char *const WORK_GROUP_SIZES_VERSION = "2";
+/// The number of timed runs per candidate (after one untimed warm-up run).
+const int AUTOTUNE_NUM_RUNS = 3;
+
+/// Returns whether the kernels of a pass are enqueued with a 1D range.
+static inline bool isPass1D(KernelPass pass)
+{
+    return pass == PASS_GENERATE_TRIANGLES || pass == PASS_SCAN;
+}
+
+/**
+ * Returns the preferred multiple of the work-group size of a kernel, or 0 if it is unknown (e.g. on OpenCL 1.0
+ * runtimes or if the runtime reports 1).
+ */
+static size_t getPreferredWorkGroupSizeMultiple(cl::Kernel kernel, const cl::Device &device)
+{
+    try {
+        size_t multiple = kernel.getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(device);
+        return multiple > 1 ? multiple : 0;
+    } catch (cl::Error &error) {
+        return 0;
+    }
+}
+
+/**
+ * Returns the kernel of a pass whose preferred work-group size multiple is used to filter the candidates.
+ */
+static cl::Kernel getRepresentativeKernel(ComputeKernels &kernels, KernelPass pass)
+{
+    switch (pass) {
+    case PASS_CLASSIFY_CELLS:
+        return kernels.classifyCellsImplicit.getKernel();
+    case PASS_CLASSIFY_POINTS:
+        return kernels.classifyPointsIndexedImplicit.getKernel();
+    case PASS_GENERATE_INDEXED_MESH:
+        return kernels.generateIndexedMeshImplicit.getKernel();
+    case PASS_GENERATE_TRIANGLES:
+        return kernels.generateTrianglesImplicit.getKernel();
+    default:
+        return kernels.scanBlocks.getKernel();
+    }
+}
+
+/**
+ * Returns whether a work-group size of a pass is supported by a device and the generic kernels of the pass. The 1D
+ * passes need power-of-two sizes.
+ */
+static bool isValidLocalWorkSize(ComputeDevice &device, KernelPass pass, const cl::NDRange &localWorkSize)
+{
+    if (isPass1D(pass)) {
+        size_t size = localWorkSize[0];
+        return localWorkSize.dimensions() == 1 && size != 0 && (size & (size - 1)) == 0
+                && size <= device.kernels->getMaxWorkGroupSize(device.device, pass);
+    }
+    if (localWorkSize.dimensions() != 3) {
+        return false;
+    }
+    std::vector<size_t> maxWorkItemSizes = device.device.getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>();
+    for (size_t i = 0; i < 3 && i < maxWorkItemSizes.size(); i++) {
+        if (localWorkSize[int(i)] == 0 || localWorkSize[int(i)] > maxWorkItemSizes.at(i)) {
+            return false;
+        }
+    }
+    return localWorkSize[0] * localWorkSize[1] * localWorkSize[2]
+            <= device.kernels->getMaxWorkGroupSize(device.device, pass);
+}
+
+/**
+ * Returns the default work-group size of a pass, i.e. (64, 4, 1) for the 3D passes and 256 for the 1D passes, halved
+ * until it is supported by the device and the kernels of the pass.
+ */
+static cl::NDRange getDefaultLocalWorkSize(ComputeDevice &device, KernelPass pass)
+{
+    if (isPass1D(pass)) {
+        size_t size = 256;
+        while (size > 1 && !isValidLocalWorkSize(device, pass, cl::NDRange(size))) {
+            size /= 2;
+        }
+        return cl::NDRange(size);
+    }
+    size_t x = 64, y = 4;
+    while (x > 1 && !isValidLocalWorkSize(device, pass, cl::NDRange(x, y, 1))) {
+        x /= 2;
+    }
+    while (y > 1 && !isValidLocalWorkSize(device, pass, cl::NDRange(x, y, 1))) {
+        y /= 2;
+    }
+    return cl::NDRange(x, y, 1);
+}
+
+/**
+ * Returns a work-group size as a string for the console output, e.g. "(64, 4, 1)" or "256".
+ */
+static std::string localWorkSizeToString(const cl::NDRange &localWorkSize)
+{
+    if (localWorkSize.dimensions() == 1) {
+        return std::to_string(localWorkSize[0]);
+    }
+    return "(" + std::to_string(localWorkSize[0]) + ", " + std::to_string(localWorkSize[1]) + ", "
+            + std::to_string(localWorkSize[2]) + ")";
+}
+
+/**
+ * Returns the work-group sizes of all passes of a device as a string for the console output.
+ */
+static std::string workGroupSizesToString(ComputeDevice &device)
+{
+    const char *passNames[NUM_KERNEL_PASSES] = {
+        "classify cells", "classify points", "generate indexed mesh", "generate triangles", "scan"
+    };
+    std::string text;
+    for (int pass = 0; pass < NUM_KERNEL_PASSES; pass++) {
+        text += std::string(pass == 0 ? "" : ", ") + passNames[pass] + " "
+                + localWorkSizeToString(device.PASS_LOCAL_WORK_SIZES[pass]);
+    }
+    return text;
+}
+
+/**
+ * Sets the work-group sizes of a device. The defaults (see getDefaultLocalWorkSize) are used by the scalar field
+ * samplers and by the passes unless autotuning is enabled, in which case the sizes of the passes are replaced by the
+ * sizes stored in the cache or tuned now.
+ * @param device The device to use.
+ */
+void MarchingCubesImpl::initWorkGroupSizes(ComputeDevice &device)
+{
+    device.LOCAL_WORK_SIZE = getDefaultLocalWorkSize(device, PASS_CLASSIFY_CELLS);
+    for (int pass = 0; pass < NUM_KERNEL_PASSES; pass++) {
+        device.PASS_LOCAL_WORK_SIZES[pass] = getDefaultLocalWorkSize(device, KernelPass(pass));
+    }
+    applyWorkGroupSizes(device);
+
+    if (autotuning == AUTOTUNE_OFF) {
+        return;
+    }
+    if (autotuning != AUTOTUNE_FORCE && loadWorkGroupSizes(device)) {
+        std::cout << "Using the tuned work-group sizes: " << workGroupSizesToString(device) << "." << std::endl;
+        return;
+    }
+    if (autotuning == AUTOTUNE_STARTUP || autotuning == AUTOTUNE_FORCE) {
+        autotuneWorkGroupSizes(device);
+    }
+}
+
+/**
+ * Fits the work-group sizes of the passes of a device to the generic kernels and to all specialized kernels.
+ * @param device The device to use.
+ */
+void MarchingCubesImpl::applyWorkGroupSizes(ComputeDevice &device)
+{
+    device.kernels->fitWorkGroupSizes(device.device, device.PASS_LOCAL_WORK_SIZES);
+    for (auto &specializedKernels : device.specializedKernels) {
+        specializedKernels.second->fitWorkGroupSizes(device.device, device.PASS_LOCAL_WORK_SIZES);
+    }
+}
+
+/**
+ * Returns the slot of the work-group sizes of a device in the cache.
+ */
+static std::string getWorkGroupSizesSlot(ComputeDevice &device)
+{
+    cl::Platform &platform = CLInterface::get()->getPlatform();
+    return std::string("Work-group sizes\n") + platform.getInfo<CL_PLATFORM_NAME>() + "\n"
+            + platform.getInfo<CL_PLATFORM_VERSION>() + "\n" + device.device.getInfo<CL_DEVICE_NAME>() + "\n"
+            + device.device.getInfo<CL_DRIVER_VERSION>();
+}
+
+/**
+ * Loads the work-group sizes of a device tuned in a previous run from the cache. Every pass stores three sizes; the
+ * 1D passes store 0 in y and z.
+ * @param device The device to use.
+ * @return False if no valid sizes are stored.
+ */
+bool MarchingCubesImpl::loadWorkGroupSizes(ComputeDevice &device)
+{
+    ProgramBinaryCache cache;
+    cache.setDirectory(programCacheDirectory);
+    const std::string slot = getWorkGroupSizesSlot(device);
+    std::vector<unsigned char> data;
+    uint32_t sizes[NUM_KERNEL_PASSES][3];
+    if (!cache.isEnabled() || !cache.load(slot, slot + "\n" + WORK_GROUP_SIZES_VERSION, data)
+            || data.size() != sizeof(sizes)) {
+        return false;
+    }
+    memcpy(sizes, &data.front(), sizeof(sizes));
+
+    // The limits may have changed, e.g. with a different build of the kernels.
+    cl::NDRange localWorkSizes[NUM_KERNEL_PASSES];
+    for (int pass = 0; pass < NUM_KERNEL_PASSES; pass++) {
+        localWorkSizes[pass] = isPass1D(KernelPass(pass)) ? cl::NDRange(sizes[pass][0])
+                : cl::NDRange(sizes[pass][0], sizes[pass][1], sizes[pass][2]);
+        if (!isValidLocalWorkSize(device, KernelPass(pass), localWorkSizes[pass])) {
+            return false;
+        }
+    }
+    for (int pass = 0; pass < NUM_KERNEL_PASSES; pass++) {
+        device.PASS_LOCAL_WORK_SIZES[pass] = localWorkSizes[pass];
+    }
+    applyWorkGroupSizes(device);
+    return true;
+}
+
+/**
+ * Stores the work-group sizes of a device in the cache.
+ * @param device The device to use.
+ */
+void MarchingCubesImpl::storeWorkGroupSizes(ComputeDevice &device)
+{
+    ProgramBinaryCache cache;
+    cache.setDirectory(programCacheDirectory);
+    if (!cache.isEnabled()) {
+        std::cout << "The tuned work-group sizes aren't stored, as the cache is disabled." << std::endl;
+        return;
+    }
+    const std::string slot = getWorkGroupSizesSlot(device);
+    uint32_t sizes[NUM_KERNEL_PASSES][3];
+    for (int pass = 0; pass < NUM_KERNEL_PASSES; pass++) {
+        const cl::NDRange &localWorkSize = device.PASS_LOCAL_WORK_SIZES[pass];
+        const bool is1D = isPass1D(KernelPass(pass));
+        sizes[pass][0] = uint32_t(localWorkSize[0]);
+        sizes[pass][1] = is1D ? 0 : uint32_t(localWorkSize[1]);
+        sizes[pass][2] = is1D ? 0 : uint32_t(localWorkSize[2]);
+    }
+    std::vector<unsigned char> data(sizeof(sizes));
+    memcpy(&data.front(), sizes, sizeof(sizes));
+    cache.store(slot, slot + "\n" + WORK_GROUP_SIZES_VERSION, data);
+}
+
+/**
+ * Returns the mean time in seconds of extracting the iso surface of the synthetic scalar field with the passed
+ * work-group size for one pass, or infinity if the kernels can't be enqueued with it. The passes of triangle soups are
+ * timed with triangle soup output and the other passes with indexed output, so that the time includes the tuned pass.
+ * The work-group size of the pass is set to the passed one.
+ */
+double MarchingCubesImpl::timeKernelPass(ComputeDevice &device, KernelPass pass, const cl::NDRange &localWorkSize,
+        cl::Buffer &scalarFieldBuffer, const CartesianGridGeometry &geometry)
+{
+    const float isoLevel = 0.7f;
+    const bool indexedOutput = pass != PASS_CLASSIFY_CELLS && pass != PASS_GENERATE_TRIANGLES;
+    device.PASS_LOCAL_WORK_SIZES[pass] = localWorkSize;
+    applyWorkGroupSizes(device);
+    try {
+        std::chrono::steady_clock::time_point startTime;
+        for (int i = -1; i < AUTOTUNE_NUM_RUNS; i++) {
+            if (i == 0) {
+                startTime = std::chrono::steady_clock::now();
+            }
+            // Blocks until the mesh is read
+            marchingCubesBuffer(device, geometry, isoLevel, scalarFieldBuffer, true, indexedOutput);
+        }
+        std::chrono::duration<double> time = std::chrono::steady_clock::now() - startTime;
+        return time.count() / AUTOTUNE_NUM_RUNS;
+    } catch (cl::Error &error) {
+        device.queue.finish();
+        return std::numeric_limits<double>::infinity();
+    }
+}
+
+/**
+ * Times candidate work-group sizes of every pass on a synthetic scalar field (see createBenchmarkScalarField) and uses
+ * the fastest ones for the device. Candidates exceeding the limits of the device or the generic kernels of the pass
+ * are skipped. If the kernels of a pass report a preferred work-group size multiple, only multiples of it are tried;
+ * otherwise, all candidates are tried. The current sizes are always candidates, so tuning never picks slower sizes
+ * than the defaults.
+ * @param device The device to use.
+ */
+void MarchingCubesImpl::autotuneWorkGroupSizes(ComputeDevice &device)
+{
+    std::cout << "Tuning the work-group sizes for " << device.device.getInfo<CL_DEVICE_NAME>() << "..." << std::endl;
+
+    const uint32_t n = 128;
+    const float spacing = 2.0f / float(n - 1);
+    CartesianGridGeometry geometry(glm::vec3(-1.0f), spacing, spacing, spacing, n, n, n / 2);
+    std::vector<float> scalarField = createBenchmarkScalarField(geometry);
+    cl::Buffer scalarFieldBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+            sizeof(float) * geometry.getNumPoints(), (void *)&scalarField.front());
+
+    const size_t sizesX[] = { 8, 16, 32, 64, 128 }, sizesY[] = { 1, 2, 4, 8, 16 }, sizesZ[] = { 1, 2 };
+    for (int passIndex = 0; passIndex < NUM_KERNEL_PASSES; passIndex++) {
+        const KernelPass pass = KernelPass(passIndex);
+        const size_t preferredMultiple = getPreferredWorkGroupSizeMultiple(
+                getRepresentativeKernel(*device.kernels, pass), device.device);
+        std::vector<cl::NDRange> candidates, preferredCandidates;
+        if (isPass1D(pass)) {
+            for (size_t size = 32; size <= 1024; size *= 2) {
+                if (isValidLocalWorkSize(device, pass, cl::NDRange(size))) {
+                    candidates.push_back(cl::NDRange(size));
+                }
+            }
+        } else {
+            for (size_t x : sizesX) {
+                for (size_t y : sizesY) {
+                    for (size_t z : sizesZ) {
+                        cl::NDRange localWorkSize(x, y, z);
+                        if (x * y * z < 32 || !isValidLocalWorkSize(device, pass, localWorkSize)) {
+                            continue;
+                        }
+                        candidates.push_back(localWorkSize);
+                        if (preferredMultiple != 0 && (x * y * z) % preferredMultiple == 0) {
+                            preferredCandidates.push_back(localWorkSize);
+                        }
+                    }
+                }
+            }
+            if (!preferredCandidates.empty()) {
+                candidates = preferredCandidates;
+            }
+        }
+        candidates.push_back(device.PASS_LOCAL_WORK_SIZES[pass]);
+
+        cl::NDRange bestLocalWorkSize = device.PASS_LOCAL_WORK_SIZES[pass];
+        double bestTime = std::numeric_limits<double>::infinity();
+        for (cl::NDRange &localWorkSize : candidates) {
+            double time = timeKernelPass(device, pass, localWorkSize, scalarFieldBuffer, geometry);
+            if (time < bestTime) {
+                bestTime = time;
+                bestLocalWorkSize = localWorkSize;
+            }
+        }
+        device.PASS_LOCAL_WORK_SIZES[pass] = bestLocalWorkSize;
+        applyWorkGroupSizes(device);
+    }
+
+    std::cout << "Tuned work-group sizes: " << workGroupSizesToString(device) << "." << std::endl;
+    storeWorkGroupSizes(device);
+}